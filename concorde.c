@@ -7,6 +7,26 @@
           value is surrounded by '&' characters)
 
           This allows for easy extraction of the two values.
+
+    October 16, 2026
+        - Moved the part of main() which solves an instance into solve(), which
+          takes its options in a concorde_opts structure (instead of the
+          file-static variables set by parseargs()) and returns its results in
+          a concorde_result structure.
+
+        - Added concorde_solve(), which solves an instance given as an array of
+          coordinates, so other programs can call Concorde directly (see
+          concorde_solve.h). Every option solve() uses is in concorde_opts, and
+          main() only reads the instance and calls solve() with it (so it
+          still solves instances with any norm). Compile with
+          CONCORDE_NO_MAIN defined to leave out main().
+
+        - Added the -j option, which makes Concorde write a one-line (JSON)
+          record of its results to a file descriptor when it finishes: the
+          running time, the number of bb nodes, the bounds, the size of the
+          root LP and the times of its phases. Programs running Concorde can
+          read this instead of searching its output for the '?' and '&'
+          characters (which are still printed).
 */
 
 /****************************************************************************/
@@ -50,68 +70,45 @@
 #include "heldkarp.h"
 #include "bigguy.h"
 #include "macrorus.h"
+#include "concorde_solve.h"
 
 #define CC_JUST_SUBTOUR (1)
 #define CC_JUST_BLOSSOM (2)
 #define CC_JUST_SUBTOUR_AND_BLOSSOM (3)
 #define CC_JUST_FAST_CUTS (4)
 
-static int norm = CC_EUCLIDEAN;
+#ifndef CONCORDE_NO_MAIN
+
+/* The options given on the command line which only main () uses (to choose
+   how the instance is read, and whether to be a grunt). The options which
+   affect how the instance is solved are put in a concorde_opts structure
+   by parseargs (). */
+
 static char *datfname        = (char *) NULL;
-static char *edgegenfname    = (char *) NULL;
 static char *problname       = (char *) NULL;
-static char *probfname       = (char *) NULL;
-static char *edgefname       = (char *) NULL;
-static char *fullfname       = (char *) NULL;
-static char *tourfname       = (char *) NULL;
 static char *masterfname     = (char *) NULL;
-static char *poolfname       = (char *) NULL;
-#ifdef CCtsp_USE_DOMINO_CUTS
-static char *dominopoolfname = (char *) NULL;
-#endif
-static char *restartfname    = (char *) NULL;
-static char *xfname          = (char *) NULL;
-static char *outfname        = (char *) NULL;
-static char *filecutname     = (char *) NULL;
-static int seed                 = 0;
 static int nnodes_want          = 0;
 static int binary_in            = 0;
 static int tsplib_in            = 1;
 static int gridsize             = 0;
-static int just_cuts            = 0;
-static int dontcutroot          = 0;
-static int usetighten           = 0;
-static int usedominos           = 0;
-static int maxchunksize         = 16;
-static int multiple_chunker     = 0;
-static int valid_edges          = 0;
-static int dfs_branching        = 0;
-static int bfs_branching        = 1;
-static int simple_branching     = 0;
-static int usebranchcliques     = 1;
-static int tentative_branch_num = 0;
-static int complete_price       = 0;
-static int want_rcnearest       = 0;
-static int output_tour_as_edges = 0;
-static int run_silently         = 1;
-static int be_nethost           = 0;
 static int unlink_files         = 0;
-static double initial_ub = CCtsp_LP_MAXDOUBLE;
-static unsigned short hostport = CCtsp_HOST_PORT;
+static int result_fd            = -1;
 static char *grunthostname = (char *) NULL;
-static char *cutbossname   = (char *) NULL;
-static char *dombossname   = (char *) NULL;
-static int eliminate_edges = -1;   /* Set to 1 to force elim, 0 to not elim */
-static int eliminate_sparse = 0;   /* Set to 1 to elim from full edge list  */
-                                   /* if the full edge list is valid        */
-static int longedge_branching = 1; /* Set to 0 to turn off           */
-static int save_proof = 0;         /* Set to 1 to save the proof     */
-static int standalone_branch = 0;  /* Set to 1 to do a manual branch */
+
+static void
+    write_result (int fd, int rval, double trt,
+        const concorde_result *result),
+    usage (char *f);
+
+static int
+    parseargs (int ac, char **av, concorde_opts *opts);
+
+#endif /* CONCORDE_NO_MAIN */
 
 
 static void
     adjust_upbound (double *bound, int ncount, CCdatagroup *dat),
-    usage (char *f);
+    root_lp_stats (CCtsp_lp *lp, concorde_result *result);
 
 static int
     handle_just_cuts (CCtsp_lp *lp, int the_cuts, CCrandstate *rstate,
@@ -123,13 +120,127 @@ static int
         CCrandstate *rstate),
     build_fulledges (int *p_excount, int **p_exlist, int **p_exlen,
         int ncount, int *ptour, char *in_fullfname),
-    parseargs (int ac, char **av),
     find_tour (int ncount, CCdatagroup *dat, int *perm, double *ub,
             int trials, int silent, CCrandstate *rstate),
     getedges (CCdatagroup *dat, CCedgegengroup *plan, int ncount, int *ecount,
             int **elist, int **elen, int silent, CCrandstate *rstate),
-    dump_rc (CCtsp_lp *lp, int count, char *pname, int usesparse);
+    dump_rc (CCtsp_lp *lp, int count, char *pname, int usesparse),
+    solve (int ncount, CCdatagroup *dat, int *ptour, char *probname,
+        char *problname, const concorde_opts *opts, CCrandstate *rstate,
+        concorde_result *result, double *branchzeit);
+
+
+void concorde_default_opts (concorde_opts *opts)
+{
+    opts->name                 = (char *) NULL;
+    opts->seed                 = 0;
+    opts->norm                 = CC_EUCLIDEAN;
+    opts->ptour                = (int *) NULL;
+    opts->bfs_branching        = 1;
+    opts->dfs_branching        = 0;
+    opts->simple_branching     = 0;
+    opts->usebranchcliques     = 1;
+    opts->longedge_branching   = 1;
+    opts->tentative_branch_num = 0;
+    opts->eliminate_edges      = -1;
+    opts->eliminate_sparse     = 0;
+    opts->maxchunksize         = 16;
+    opts->multiple_chunker     = 0;
+    opts->usetighten           = 0;
+    opts->usedominos           = 0;
+    opts->dontcutroot          = 0;
+    opts->complete_price       = 0;
+    opts->just_cuts            = 0;
+    opts->initial_ub           = CCtsp_LP_MAXDOUBLE;
+    opts->tourfname            = (char *) NULL;
+    opts->edgefname            = (char *) NULL;
+    opts->edgegenfname         = (char *) NULL;
+    opts->fullfname            = (char *) NULL;
+    opts->valid_edges          = 0;
+    opts->filecutname          = (char *) NULL;
+    opts->poolfname            = (char *) NULL;
+    opts->dominopoolfname      = (char *) NULL;
+    opts->probfname            = (char *) NULL;
+    opts->restartfname         = (char *) NULL;
+    opts->outfname             = (char *) NULL;
+    opts->output_tour_as_edges = 0;
+    opts->xfname               = (char *) NULL;
+    opts->want_rcnearest       = 0;
+    opts->cutbossname          = (char *) NULL;
+    opts->dombossname          = (char *) NULL;
+    opts->hostport             = 0;
+    opts->save_proof           = 0;
+    opts->standalone_branch    = 0;
+    opts->silent               = 1;
+}
+
+int concorde_solve (int ncount, const double *x, const double *y,
+        const concorde_opts *opts, concorde_result *result)
+{
+    int rval = 0;
+    int i;
+    char *probname = (char *) NULL;
+    int *ptour = (int *) NULL;
+    double branchzeit = 0.0;
+    concorde_opts defaults;
+    CCdatagroup dat;
+    CCrandstate rstate;
+
+    if (opts == (concorde_opts *) NULL) {
+        concorde_default_opts (&defaults);
+        opts = &defaults;
+    }
+
+    memset (result, 0, sizeof (concorde_result));
+    CCutil_init_datagroup (&dat);
+
+    /* Only the x and y coordinates of the cities are given, so the norm
+       mustn't need anything else (a matrix, z coordinates etc.). */
 
+    if (x == (double *) NULL || y == (double *) NULL ||
+        (opts->norm & CC_NORM_SIZE_BITS) != CC_D2_NORM_SIZE ||
+        (opts->norm & CC_NORM_BITS) == CC_JUNK_NORM_TYPE) {
+        fprintf (stderr, "concorde_solve needs x-y coordinates and a norm "
+                         "which only uses them\n");
+        rval = 1; goto CLEANUP;
+    }
+
+    CCutil_sprand (opts->seed, &rstate);
+
+    probname = CCtsp_problabel (opts->name ? opts->name : "unnamed");
+    CCcheck_NULL (probname, "CCtsp_problabel failed");
+
+    rval = CCutil_dat_setnorm (&dat, opts->norm);
+    CCcheck_rval (rval, "CCutil_dat_setnorm failed");
+
+    dat.x = CC_SAFE_MALLOC (ncount, double);
+    CCcheck_NULL (dat.x, "out of memory for x");
+    dat.y = CC_SAFE_MALLOC (ncount, double);
+    CCcheck_NULL (dat.y, "out of memory for y");
+    for (i = 0; i < ncount; i++) {
+        dat.x[i] = x[i];
+        dat.y[i] = y[i];
+    }
+
+    /* solve () frees the permutation tour, so it is given a copy */
+
+    if (opts->ptour) {
+        ptour = CC_SAFE_MALLOC (ncount, int);
+        CCcheck_NULL (ptour, "out of memory for ptour");
+        for (i = 0; i < ncount; i++) ptour[i] = opts->ptour[i];
+    }
+
+    rval = solve (ncount, &dat, ptour, probname,
+                  opts->name ? opts->name : probname, opts, &rstate, result,
+                  &branchzeit);
+
+CLEANUP:
+    CC_IFFREE (probname, char);
+    CCutil_freedatagroup (&dat);
+    return rval;
+}
+
+#ifndef CONCORDE_NO_MAIN
 
 int main(int ac, char **av)
 {
@@ -137,50 +248,37 @@ int main(int ac, char **av)
 
     int rval = 0;
     char *probname = (char *) NULL;
-    int i, ncount, silent, allow_dups, use_gridsize;
+    int ncount, allow_dups, use_gridsize;
     CCdatagroup dat;
-    CCtsp_lp *lp = (CCtsp_lp *) NULL;
-    CCtsp_cutselect sel, tentativesel;
-    CCtsp_lpcuts *pool = (CCtsp_lpcuts *) NULL;
-    CCtsp_lpcuts *dominopool = (CCtsp_lpcuts *) NULL;
     int *ptour = (int *) NULL;
-    int ecount = 0;
-    int *elist = (int *) NULL;
-    int *elen = (int *) NULL;
-    int excount = 0;
-    int *exlist = (int *) NULL;
-    int *exlen = (int *) NULL;
-    int *besttour = (int *) NULL;
-    int is_infeasible = 0;
-    int bbcount = 0;
-    double szeit;
-    double upbound = 0.0;
-    double branchzeit = 0.0;
+    double szeit, branchzeit = 0.0;
+    concorde_opts opts;
+    concorde_result result;
     CCrandstate rstate;
     char buf[1024];
 
+    memset (&result, 0, sizeof (concorde_result));
     CCutil_init_datagroup (&dat);
+    concorde_default_opts (&opts);
 
     rval = CCutil_print_command (ac, av);
     CCcheck_rval (rval, "CCutil_print_command failed");
 
     szeit = CCutil_zeit ();
-    seed = (int) CCutil_real_zeit ();
+    opts.seed = (int) CCutil_real_zeit ();
 
-    rval = parseargs (ac, av);
+    rval = parseargs (ac, av, &opts);
     if (rval) goto CLEANUP;
 
     CCutil_printlabel ();
     CCutil_signal_init ();
-    CCutil_sprand (seed, &rstate);
-    printf ("Using random seed %d\n", seed); fflush (stdout);
-
-    silent = run_silently;
+    CCutil_sprand (opts.seed, &rstate);
+    printf ("Using random seed %d\n", opts.seed); fflush (stdout);
 
     if (grunthostname) {
 #ifdef CC_NETREADY
-        rval = CCtsp_grunt (grunthostname, hostport, poolfname, cutbossname,
-                            problname, silent, &rstate);
+        rval = CCtsp_grunt (grunthostname, CCtsp_HOST_PORT, opts.poolfname,
+                            opts.cutbossname, problname, opts.silent, &rstate);
         if (rval) {
             fprintf (stderr, "CCtsp_grunt failed\n");
         }
@@ -191,29 +289,6 @@ int main(int ac, char **av)
 #endif /* CC_NETREADY */
     }
 
-
-    if (!be_nethost) {
-        hostport = 0;
-    }
-
-    CCtsp_init_cutselect (&sel);
-    CCtsp_init_tentative_cutselect (&tentativesel);
-    CCtsp_cutselect_tighten (&sel, usetighten);
-    CCtsp_cutselect_tighten (&tentativesel, usetighten);
-    CCtsp_cutselect_chunksize (&sel, maxchunksize);
-    CCtsp_cutselect_dominos (&sel, usedominos);
-    if (filecutname) CCtsp_cutselect_filecuts (&sel, filecutname);
-#ifdef CC_NETREADY
-    if (cutbossname != (char *) NULL) {
-        CCtsp_cutselect_remotepool (&sel, cutbossname);
-        CCtsp_cutselect_remotepool (&tentativesel, cutbossname);
-    }
-    if (dombossname != (char *) NULL) {
-        CCtsp_cutselect_domboss (&sel, dombossname);
-        CCtsp_cutselect_domboss (&tentativesel, dombossname);
-    }
-#endif /* CC_NETREADY */
-
     if (problname)        probname = CCtsp_problabel (problname);
     else if (datfname)    probname = CCtsp_problabel (datfname);
     else if (masterfname) probname = CCtsp_problabel (masterfname);
@@ -222,9 +297,7 @@ int main(int ac, char **av)
         fprintf (stderr, "CCtsp_problabel failed\n");
         rval = 1; goto CLEANUP;
     }
-    if (problname == (char *) NULL) {
-        problname = probname;
-    }
+    opts.name = problname ? problname : probname;
 
     if (masterfname) {
         rval = CCutil_getmaster (masterfname, &ncount, &dat, &ptour);
@@ -250,10 +323,147 @@ int main(int ac, char **av)
                 use_gridsize = nnodes_want;
                 allow_dups = 0;
             }
-            rval = CCutil_getdata (datfname, binary_in, norm, &ncount, &dat,
-                                   use_gridsize, allow_dups, &rstate);
+            rval = CCutil_getdata (datfname, binary_in, opts.norm, &ncount,
+                                   &dat, use_gridsize, allow_dups, &rstate);
             CCcheck_rval (rval, "CCutil_getdata failed");
         }
+    }
+
+    /* The instance is solved as it was read (concorde_solve () only takes
+       x-y coordinates, but the norm of a TSPlib or master file can need a
+       matrix etc.). solve () frees ptour. */
+
+    opts.norm = dat.norm;
+
+    rval = solve (ncount, &dat, ptour, probname, opts.name, &opts,
+                  &rstate, &result, &branchzeit);
+    ptour = (int *) NULL;
+    if (rval) goto CLEANUP;
+
+	trt = CCutil_zeit () - szeit;
+    printf ("Total Running Time: %.2f (seconds) ?%f?", trt, trt);
+
+    if (result.branching_time != 0.0) {
+        printf ("  Branching Time: %.2f (seconds)", result.branching_time);
+    }
+    printf ("\n"); fflush (stdout);
+
+CLEANUP:
+
+	if (result_fd >= 0) {
+		write_result (result_fd, rval, trt, &result);
+	}
+
+    if (unlink_files && probname) {
+        if (!opts.silent) {
+            printf ("Delete the temporary files: pul sav mas\n");
+            fflush (stdout);
+        }
+
+        sprintf (buf, "%s.pul", probname);
+        rval = unlink (buf);
+        if (rval && !opts.silent) {
+            printf ("CCutil_sdelete_file failed for %s\n", buf);
+        }
+
+        sprintf (buf, "O%s.pul", probname);
+        rval = unlink (buf);
+        if (rval && !opts.silent) {
+            printf ("CCutil_sdelete_file failed for %s\n", buf);
+        }
+
+        sprintf (buf, "%s.sav", probname);
+        rval = unlink (buf);
+        if (rval && !opts.silent) {
+            printf ("CCutil_sdelete_file failed for %s\n", buf);
+        }
+
+        sprintf (buf, "O%s.sav", probname);
+        rval = unlink (buf);
+        if (rval && !opts.silent) {
+            printf ("CCutil_sdelete_file failed for %s\n", buf);
+        }
+
+        sprintf (buf, "%s.mas", probname);
+        rval = unlink (buf);
+        if (rval && !opts.silent) {
+            printf ("CCutil_sdelete_file failed for %s\n", buf);
+        }
+
+        sprintf (buf, "O%s.mas", probname);
+        rval = unlink (buf);
+        if (rval && !opts.silent) {
+            printf ("CCutil_sdelete_file failed for %s\n", buf);
+        }
+    }
+
+    CC_IFFREE (ptour, int);
+    CC_IFFREE (probname, char);
+    CCutil_freedatagroup (&dat);
+
+
+    return rval;
+}
+
+#endif /* CONCORDE_NO_MAIN */
+
+/* Solves the instance given by dat (the part of main () which used to follow
+   reading the instance). If ptour is not NULL, it is the permutation tour
+   read from a master file (and it is freed here). main () calls it with
+   the instance it read, and concorde_solve () with the x-y coordinates it
+   was given. */
+
+static int solve (int ncount, CCdatagroup *dat, int *ptour, char *probname,
+        char *problname, const concorde_opts *opts, CCrandstate *rstate,
+        concorde_result *result, double *branchzeit)
+{
+    int rval = 0;
+    int i, silent = opts->silent;
+    int elim = opts->eliminate_edges;
+    CCtsp_lp *lp = (CCtsp_lp *) NULL;
+    CCtsp_cutselect sel, tentativesel;
+    CCtsp_lpcuts *pool = (CCtsp_lpcuts *) NULL;
+    CCtsp_lpcuts *dominopool = (CCtsp_lpcuts *) NULL;
+    int ecount = 0;
+    int *elist = (int *) NULL;
+    int *elen = (int *) NULL;
+    int excount = 0;
+    int *exlist = (int *) NULL;
+    int *exlen = (int *) NULL;
+    int *besttour = (int *) NULL;
+    int is_infeasible = 0;
+    int bbcount = 0;
+    double szeit = CCutil_zeit ();
+    double upbound = 0.0;
+    double lowbound = 0.0;
+    double ub = opts->initial_ub;
+    char buf[1024];
+
+    *branchzeit = 0.0;
+    memset (result, 0, sizeof (concorde_result));
+    if (elim < 0) {
+        elim = (opts->bfs_branching || opts->dfs_branching) ? 1 : 0;
+    }
+
+    CCtsp_init_cutselect (&sel);
+    CCtsp_init_tentative_cutselect (&tentativesel);
+    CCtsp_cutselect_tighten (&sel, opts->usetighten);
+    CCtsp_cutselect_tighten (&tentativesel, opts->usetighten);
+    CCtsp_cutselect_chunksize (&sel, opts->maxchunksize);
+    CCtsp_cutselect_dominos (&sel, opts->usedominos);
+    if (opts->filecutname) CCtsp_cutselect_filecuts (&sel, opts->filecutname);
+#ifdef CC_NETREADY
+    if (opts->cutbossname != (char *) NULL) {
+        CCtsp_cutselect_remotepool (&sel, opts->cutbossname);
+        CCtsp_cutselect_remotepool (&tentativesel, opts->cutbossname);
+    }
+    if (opts->dombossname != (char *) NULL) {
+        CCtsp_cutselect_domboss (&sel, opts->dombossname);
+        CCtsp_cutselect_domboss (&tentativesel, opts->dombossname);
+    }
+#endif /* CC_NETREADY */
+
+    if (ptour == (int *) NULL) {
 
         /* Handle small instances */
 
@@ -268,21 +478,24 @@ int main(int ac, char **av)
             if (ncount == 3) {
                 for (i = 0; i < ncount; i++) besttour[i] = i;
             } else {
-                rval = run_hk (ncount, &dat, besttour);
+                rval = run_hk (ncount, dat, besttour);
                 CCcheck_rval (rval, "run_hk failed");
             }
             ptour = CC_SAFE_MALLOC (ncount, int);
             CCcheck_NULL (ptour, "out of memory for ptour");
             for (i = 0; i < ncount; i++) ptour[i] = i;
-            rval = CCtsp_dumptour (ncount, &dat, ptour, probname, besttour,
-                                   outfname, output_tour_as_edges, silent);
+            rval = CCtsp_dumptour (ncount, dat, ptour, probname, besttour,
+                                   opts->outfname, opts->output_tour_as_edges,
+                                   silent);
             CCcheck_rval (rval, "CCtsp_dumptour failed");
 
-			trt = CCutil_zeit () - szeit;
-			printf ("Total Running Time: %.2f (seconds) ?%f?", trt, trt);
-
-            fflush (stdout);
-            goto CLEANUP;
+            upbound = 0.0;
+            for (i = 0; i < ncount; i++) {
+                upbound += CCutil_dat_edgelen (besttour[i],
+                                  besttour[(i + 1) % ncount], dat);
+            }
+            lowbound = upbound;
+            goto DONE_SMALL;
         }
 
         /***** Get the permutation tour and permute the data  *****/
@@ -290,54 +503,54 @@ int main(int ac, char **av)
         ptour = CC_SAFE_MALLOC (ncount, int);
         CCcheck_NULL (ptour, "out of memory for ptour");
 
-        if (tourfname) {
-            rval = CCutil_getcycle (ncount, tourfname, ptour, 0);
+        if (opts->tourfname) {
+            rval = CCutil_getcycle (ncount, opts->tourfname, ptour, 0);
             CCcheck_rval (rval, "CCutil_getcycle failed");
         } else {
             double bnd;
-            if (just_cuts > 0) {
-                rval = find_tour (ncount, &dat, ptour, &bnd, -1, silent,
-                                  &rstate);
-            } else if (initial_ub == CCtsp_LP_MAXDOUBLE) {
-                rval = find_tour (ncount, &dat, ptour, &bnd, 1, silent,
-                                  &rstate);
+            if (opts->just_cuts > 0) {
+                rval = find_tour (ncount, dat, ptour, &bnd, -1, silent,
+                                  rstate);
+            } else if (ub == CCtsp_LP_MAXDOUBLE) {
+                rval = find_tour (ncount, dat, ptour, &bnd, 1, silent,
+                                  rstate);
             } else {
                 if (!silent) {
-                    printf ("Initial bnd %f - use short LK\n", initial_ub);
+                    printf ("Initial bnd %f - use short LK\n", ub);
                     fflush (stdout);
                 }
-                rval = find_tour (ncount, &dat, ptour, &bnd, 0, silent,
-                                 &rstate);
+                rval = find_tour (ncount, dat, ptour, &bnd, 0, silent,
+                                 rstate);
             }
             CCcheck_rval (rval, "find_tour failed");
         }
 
-        rval = CCutil_datagroup_perm (ncount, &dat, ptour);
+        rval = CCutil_datagroup_perm (ncount, dat, ptour);
         CCcheck_rval (rval, "CCutil_datagroup_perm failed");
 
         //sprintf (buf, "%s.mas", probname);
         sprintf (buf, "%s.mas", "plot");
-        rval = CCutil_putmaster (buf, ncount, &dat, ptour);
+        rval = CCutil_putmaster (buf, ncount, dat, ptour);
         CCcheck_rval (rval, "CCutil_putmaster failed");
     }
 
-    adjust_upbound (&initial_ub, ncount, &dat);
+    adjust_upbound (&ub, ncount, dat);
 
-    if (!probfname && !restartfname) {
+    if (!opts->probfname && !opts->restartfname) {
         rval = build_edges (&ecount, &elist, &elen, ncount, ptour,
-                            &dat, edgefname, edgegenfname, just_cuts,
-                            silent, &rstate);
+                            dat, opts->edgefname, opts->edgegenfname,
+                            opts->just_cuts, silent, rstate);
         CCcheck_rval (rval, "build_edges failed");
     }
 
     rval = build_fulledges (&excount, &exlist, &exlen, ncount, ptour,
-                            fullfname);
+                            opts->fullfname);
     CCcheck_rval (rval, "build_fulledges failed");
 
-    rval = CCtsp_init_cutpool (&ncount, poolfname, &pool);
+    rval = CCtsp_init_cutpool (&ncount, opts->poolfname, &pool);
     CCcheck_rval (rval, "CCtsp_init_cutpool failed");
 #ifdef CCtsp_USE_DOMINO_CUTS
-    rval = CCtsp_init_cutpool (&ncount, dominopoolfname, &dominopool);
+    rval = CCtsp_init_cutpool (&ncount, opts->dominopoolfname, &dominopool);
     CCcheck_rval (rval, "CCtsp_init_cutpool failed for dominos");
 #endif
 
@@ -349,26 +562,28 @@ int main(int ac, char **av)
         besttour[i] = i;
     }
 
-    if (restartfname) {
-        upbound  = initial_ub;
+    if (opts->restartfname) {
+        upbound  = ub;
         bbcount = 0;
 
-        rval = CCtsp_bfs_restart (problname, restartfname, &sel,
-                &tentativesel, &upbound, &bbcount, usebranchcliques, &dat,
-                ptour, pool, ncount, besttour, hostport, &branchzeit,
-                save_proof, tentative_branch_num, longedge_branching,
-                (double *) NULL, (int *) NULL, silent, &rstate);
+        rval = CCtsp_bfs_restart (problname, opts->restartfname, &sel,
+                &tentativesel, &upbound, &bbcount, opts->usebranchcliques,
+                dat, ptour, pool, ncount, besttour, opts->hostport, branchzeit,
+                opts->save_proof, opts->tentative_branch_num,
+                opts->longedge_branching, (double *) NULL, (int *) NULL,
+                silent, rstate);
         CCcheck_rval (rval, "CCtsp_bfs_restart failed");
         goto DONE;
     }
 
-    rval = CCtsp_dumptour (ncount, &dat, ptour, probname, besttour,
+    rval = CCtsp_dumptour (ncount, dat, ptour, probname, besttour,
                            (char *) NULL, 0, silent);
     CCcheck_rval (rval, "CCtsp_dumptour failded");
 
-    rval = CCtsp_init_lp (&lp, problname, -1, probfname, ncount, &dat,
-                    ecount, elist, elen, excount, exlist, exlen, valid_edges,
-                    ptour, initial_ub, pool, dominopool, silent, &rstate);
+    rval = CCtsp_init_lp (&lp, problname, -1, opts->probfname, ncount, dat,
+                    ecount, elist, elen, excount, exlist, exlen,
+                    opts->valid_edges, ptour, ub, pool, dominopool, silent,
+                    rstate);
     if (rval == 2) {
         printf ("CCtsp_init_lp reports an infeasible LP\n");
         rval = CCtsp_verify_infeasible_lp (lp, &is_infeasible, silent);
@@ -400,24 +615,24 @@ int main(int ac, char **av)
         }
     }
 
-    if (standalone_branch) {
-        rval = CCtsp_do_interactive_branch (lp, silent, &rstate);
+    if (opts->standalone_branch) {
+        rval = CCtsp_do_interactive_branch (lp, silent, rstate);
         CCcheck_rval (rval, "CCtsp_do_interactive_branch failed");
-
-		trt = CCutil_zeit () - szeit;
-		printf ("Total Running Time: %.2f (seconds) ?%f?", trt, trt);
-        goto CLEANUP;
+        upbound = lp->upperbound;
+        lowbound = lp->lowerbound;
+        goto DONE_SMALL;
     }
 
-    if (just_cuts > 0) {
-        rval = handle_just_cuts (lp, just_cuts, &rstate, silent);
+    if (opts->just_cuts > 0) {
+        rval = handle_just_cuts (lp, opts->just_cuts, rstate, silent);
         CCcheck_rval (rval, "handle_just_cuts failed");
-        if (want_rcnearest) {
-            rval = dump_rc (lp, want_rcnearest, probname, 0);
+        root_lp_stats (lp, result);
+        if (opts->want_rcnearest) {
+            rval = dump_rc (lp, opts->want_rcnearest, probname, 0);
             CCcheck_rval (rval, "dump_rc failed");
         }
-        if (xfname) {
-            rval = CCtsp_dump_x (lp, xfname);
+        if (opts->xfname) {
+            rval = CCtsp_dump_x (lp, opts->xfname);
             CCcheck_rval (rval, "CCtsp_dump_x failed");
         }
         goto DONE;
@@ -426,12 +641,12 @@ int main(int ac, char **av)
     rval = CCtsp_cutselect_set_tols (&sel, lp, 1, silent);
     CCcheck_rval (rval, "CCtsp_cutselect_set_tols failed");
 
-    if (dontcutroot == 0) {
-        if (multiple_chunker) {
-            rval = CCtsp_cutting_multiple_loop (lp, &sel, 1, maxchunksize,
-                                    1, silent, &rstate);
+    if (opts->dontcutroot == 0) {
+        if (opts->multiple_chunker) {
+            rval = CCtsp_cutting_multiple_loop (lp, &sel, 1,
+                                    opts->maxchunksize, 1, silent, rstate);
         } else {
-            rval = CCtsp_cutting_loop (lp, &sel, 1, silent, &rstate);
+            rval = CCtsp_cutting_loop (lp, &sel, 1, silent, rstate);
         }
         if (rval == 2) {
             printf ("CCtsp_cutting_loop reports an infeasible LP\n");
@@ -448,6 +663,7 @@ int main(int ac, char **av)
             printf ("Final LP has %d rows, %d columns, %d nonzeros\n",
                     CClp_nrows (lp->lp), CClp_ncols (lp->lp),
                     CClp_nnonzeros (lp->lp));
+            root_lp_stats (lp, result);
 
             goto DONE;
         } else if (rval) {
@@ -459,7 +675,7 @@ int main(int ac, char **av)
     {
         double tourval;
         CCutil_start_timer (&lp->stats.linkern);
-        rval = CCtsp_call_x_heuristic (lp, &tourval, besttour, silent, &rstate);
+        rval = CCtsp_call_x_heuristic (lp, &tourval, besttour, silent, rstate);
         CCcheck_rval (rval, "CCtsp_call_x_heuristic failed");
 
         if (!silent) CCutil_stop_timer (&lp->stats.linkern, 1);
@@ -468,7 +684,7 @@ int main(int ac, char **av)
         if (tourval < lp->upperbound) {
             printf ("New upperbound from x-heuristic: %.2f\n", tourval);
             lp->upperbound = tourval;
-            rval = CCtsp_dumptour (ncount, &dat, ptour, probname, besttour,
+            rval = CCtsp_dumptour (ncount, dat, ptour, probname, besttour,
                                    (char *) NULL, 0, silent);
             CCcheck_rval (rval, "CCtsp_dumptour failed");
         }
@@ -476,20 +692,21 @@ int main(int ac, char **av)
                                                           lp->upperbound);
         fflush (stdout);
     }
+    lowbound = lp->lowerbound;
 
-    if (xfname) {
-        rval = CCtsp_dump_x (lp, xfname);
+    if (opts->xfname) {
+        rval = CCtsp_dump_x (lp, opts->xfname);
         CCcheck_rval (rval, "CCtsp_dump_x failed");
     }
-    if (want_rcnearest) {
-        rval = dump_rc (lp, want_rcnearest, probname, 0);
+    if (opts->want_rcnearest) {
+        rval = dump_rc (lp, opts->want_rcnearest, probname, 0);
         CCcheck_rval (rval, "dump_rc failed");
     }
 
-    if (lp->graph.ncount < 100000 || complete_price) {
+    if (lp->graph.ncount < 100000 || opts->complete_price) {
         CCbigguy bound;
         CCbigguy bupper;
-        rval = CCtsp_exact_price (lp, &bound, complete_price, 0, silent);
+        rval = CCtsp_exact_price (lp, &bound, opts->complete_price, 0, silent);
         if (rval) {
             fprintf (stderr, "CCtsp_exact_price failed\n");
             goto CLEANUP;
@@ -507,7 +724,7 @@ int main(int ac, char **av)
         if (CCbigguy_cmp (lp->exact_lowerbound, bupper) > 0) {
             upbound = lp->upperbound;
             bbcount = 1;
-            if (!dfs_branching && !bfs_branching) {
+            if (!opts->dfs_branching && !opts->bfs_branching) {
                 printf ("Optimal Solution: %.2f\n", upbound);
 
                 printf ("Number of bbnodes: %d\t&%d&\n", bbcount, bbcount);
@@ -521,16 +738,18 @@ int main(int ac, char **av)
             printf ("Final LP has %d rows, %d columns, %d nonzeros\n",
                     CClp_nrows (lp->lp), CClp_ncols (lp->lp),
                     CClp_nnonzeros (lp->lp));
+            root_lp_stats (lp, result);
 
-            if (dat.ndepot > 0) {
-                rval = CCtsp_depot_valid (lp, dat.ndepot, (int *) NULL);
+            if (dat->ndepot > 0) {
+                rval = CCtsp_depot_valid (lp, dat->ndepot, (int *) NULL);
                 CCcheck_rval (rval, "CCtsp_depot_valid failed");
             }
             goto DONE;
         }
 
-        if (dat.ndepot == 0 && eliminate_edges) {
-            rval = CCtsp_eliminate_variables (lp, eliminate_sparse, silent);
+        if (dat->ndepot == 0 && elim) {
+            rval = CCtsp_eliminate_variables (lp, opts->eliminate_sparse,
+                                              silent);
             CCcheck_rval (rval, "CCtsp_eliminate_variables failed");
         }
     } else {
@@ -540,6 +759,7 @@ int main(int ac, char **av)
         printf ("Final LP has %d rows, %d columns, %d nonzeros\n",
                 CClp_nrows (lp->lp), CClp_ncols (lp->lp),
                 CClp_nnonzeros (lp->lp));
+        root_lp_stats (lp, result);
 
         goto DONE;
     }
@@ -549,26 +769,28 @@ int main(int ac, char **av)
             CClp_nrows (lp->lp), CClp_ncols (lp->lp),
             CClp_nnonzeros (lp->lp));
     fflush (stdout);
+    root_lp_stats (lp, result);
 
-    if (dat.ndepot > 0) {
-        rval = CCtsp_depot_valid (lp, dat.ndepot, (int *) NULL);
+    if (dat->ndepot > 0) {
+        rval = CCtsp_depot_valid (lp, dat->ndepot, (int *) NULL);
         CCcheck_rval (rval, "CCtsp_depot_valid failed");
         goto DONE;
     }
 
-    if (dfs_branching) {
+    if (opts->dfs_branching) {
         upbound = lp->upperbound;
         bbcount = 0;
 
-        if (simple_branching) CCtsp_init_simple_cutselect (&sel);
+        if (opts->simple_branching) CCtsp_init_simple_cutselect (&sel);
         rval = CCtsp_easy_dfs_brancher (lp, &sel, 0, &upbound, &bbcount,
-                     usebranchcliques, besttour, longedge_branching,
-                     simple_branching, silent, &rstate);
+                     opts->usebranchcliques, besttour,
+                     opts->longedge_branching, opts->simple_branching,
+                     silent, rstate);
         CCcheck_rval (rval, "CCtsp_easy_dfs_brancher failed");
-    } else if (bfs_branching) {
-        double lowbound = lp->lowerbound;
-        int id          = lp->id;
+    } else if (opts->bfs_branching) {
+        int id = lp->id;
 
+        lowbound = lp->lowerbound;
         upbound  = lp->upperbound;
         bbcount = 0;
 
@@ -577,34 +799,28 @@ int main(int ac, char **av)
         CCtsp_free_tsp_lp_struct (&lp);
 
         rval = CCtsp_bfs_brancher (problname, id, lowbound, &sel,
-                &tentativesel, &upbound, &bbcount, usebranchcliques, &dat,
-                ptour, pool, ncount, besttour, hostport, &branchzeit,
-                save_proof, tentative_branch_num, longedge_branching,
-                (double *) NULL, (int *) NULL, silent, &rstate);
+                &tentativesel, &upbound, &bbcount, opts->usebranchcliques,
+                dat, ptour, pool, ncount, besttour, opts->hostport, branchzeit,
+                opts->save_proof, opts->tentative_branch_num,
+                opts->longedge_branching, (double *) NULL, (int *) NULL,
+                silent, rstate);
         CCcheck_rval (rval, "CCtsp_bfs_brancher failed");
     }
 
 DONE:
-    if (dfs_branching || bfs_branching || restartfname) {
+    if (opts->dfs_branching || opts->bfs_branching || opts->restartfname) {
         printf ("Optimal Solution: %.2f\n", upbound);
         printf ("Number of bbnodes: %d\t&%d&\n", bbcount, bbcount);
         fflush (stdout);
-        rval = CCtsp_dumptour (ncount, &dat, ptour, probname, besttour,
-                               outfname, output_tour_as_edges, silent);
+        rval = CCtsp_dumptour (ncount, dat, ptour, probname, besttour,
+                               opts->outfname, opts->output_tour_as_edges,
+                               silent);
         CCcheck_rval (rval, "CCtsp_dumptour failed");
     } else {
         rval = CCtsp_write_probfile_sav (lp);
         CCcheck_rval (rval, "CCtsp_write_probfile_sav failed");
     }
 
-	trt = CCutil_zeit () - szeit;
-    printf ("Total Running Time: %.2f (seconds) ?%f?", trt, trt);
-
-    if (branchzeit != 0.0) {
-        printf ("  Branching Time: %.2f (seconds)", branchzeit);
-    }
-    printf ("\n"); fflush (stdout);
-
     /*  CCtsp_output_statistics (&lp->stats);  */
 
     if (pool && pool->cutcount) {
@@ -637,53 +853,15 @@ DONE:
         }
     }
 
+DONE_SMALL:
+    result->runningtime = CCutil_zeit () - szeit;
+    result->bbnodes = bbcount;
+    result->optimal = upbound;
+    result->lowerbound = lowbound;
+    result->branching_time = *branchzeit;
     rval = 0;
 
 CLEANUP:
-
-    if (unlink_files) {
-        if (!run_silently) {
-            printf ("Delete the temporary files: pul sav mas\n");
-            fflush (stdout);
-        }
-
-        sprintf (buf, "%s.pul", probname);
-        rval = unlink (buf);
-        if (rval && !run_silently) {
-            printf ("CCutil_sdelete_file failed for %s\n", buf);
-        }
-
-        sprintf (buf, "O%s.pul", probname);
-        rval = unlink (buf);
-        if (rval && !run_silently) {
-            printf ("CCutil_sdelete_file failed for %s\n", buf);
-        }
-
-        sprintf (buf, "%s.sav", probname);
-        rval = unlink (buf);
-        if (rval && !run_silently) {
-            printf ("CCutil_sdelete_file failed for %s\n", buf);
-        }
-
-        sprintf (buf, "O%s.sav", probname);
-        rval = unlink (buf);
-        if (rval && !run_silently) {
-            printf ("CCutil_sdelete_file failed for %s\n", buf);
-        }
-
-        sprintf (buf, "%s.mas", probname);
-        rval = unlink (buf);
-        if (rval && !run_silently) {
-            printf ("CCutil_sdelete_file failed for %s\n", buf);
-        }
-
-        sprintf (buf, "O%s.mas", probname);
-        rval = unlink (buf);
-        if (rval && !run_silently) {
-            printf ("CCutil_sdelete_file failed for %s\n", buf);
-        }
-    }
-
     if (lp) CCtsp_free_tsp_lp_struct (&lp);
     if (pool) { CCtsp_free_cutpool (&pool); }
     if (dominopool) { CCtsp_free_cutpool (&dominopool); }
@@ -694,13 +872,58 @@ CLEANUP:
     CC_IFFREE (exlen, int);
     CC_IFFREE (ptour, int);
     CC_IFFREE (besttour, int);
-    CC_IFFREE (probname, char);
-    CCutil_freedatagroup (&dat);
-
 
     return rval;
 }
 
+/* Records the size of the final root LP and the times of the phases of the
+   root computation (lp->stats) in the result, before lp is freed. */
+
+static void root_lp_stats (CCtsp_lp *lp, concorde_result *result)
+{
+    result->rows = CClp_nrows (lp->lp);
+    result->cols = CClp_ncols (lp->lp);
+    result->nonzeros = CClp_nnonzeros (lp->lp);
+    result->root_time = lp->stats.total.cum_zeit;
+    result->cutting_time = lp->stats.cutting_loop.cum_zeit;
+    result->linkern_time = lp->stats.linkern.cum_zeit;
+    result->price_time = lp->stats.ex_price.cum_zeit;
+}
+
+#ifndef CONCORDE_NO_MAIN
+
+/* Writes the results as one line (a JSON object with fixed keys) to the file
+   descriptor given with -j. The line is written with a single write () so a
+   program reading the other end of a pipe never sees part of it. If Concorde
+   failed, only "ok" (0) and the return value are written. */
+
+static void write_result (int fd, int rval, double trt,
+        const concorde_result *result)
+{
+    char rec[512];
+    int len;
+
+    if (rval) {
+        len = snprintf (rec, sizeof (rec), "{\"ok\":0,\"rval\":%d}\n", rval);
+    } else {
+        len = snprintf (rec, sizeof (rec),
+            "{\"ok\":1,\"time\":%f,\"bbnodes\":%d,"
+            "\"upperbound\":%f,\"lowerbound\":%f,"
+            "\"rows\":%d,\"cols\":%d,\"nonzeros\":%d,"
+            "\"timers\":{\"root\":%f,\"cutting\":%f,\"linkern\":%f,"
+            "\"price\":%f,\"branching\":%f}}\n",
+            trt, result->bbnodes, result->optimal, result->lowerbound,
+            result->rows, result->cols, result->nonzeros,
+            result->root_time, result->cutting_time, result->linkern_time,
+            result->price_time, result->branching_time);
+    }
+    if (write (fd, rec, len) != len) {
+        perror ("write result record");
+    }
+}
+
+#endif /* CONCORDE_NO_MAIN */
+
 static int handle_just_cuts (CCtsp_lp *lp, int the_cuts, CCrandstate *rstate,
        int silent)
 {
@@ -716,10 +939,10 @@ static int handle_just_cuts (CCtsp_lp *lp, int the_cuts, CCrandstate *rstate,
     } else if (the_cuts == CC_JUST_SUBTOUR) {
         rval = CCtsp_subtour_loop (lp, silent, rstate);
         CCcheck_rval (rval, "CCtsp_subtour_loop failed");
-    } else if (just_cuts == CC_JUST_BLOSSOM) {
+    } else if (the_cuts == CC_JUST_BLOSSOM) {
         rval = CCtsp_blossom_loop (lp, silent, rstate);
         CCcheck_rval (rval, "CCtsp_blossom_loop failed");
-    } else if (just_cuts == CC_JUST_SUBTOUR_AND_BLOSSOM) {
+    } else if (the_cuts == CC_JUST_SUBTOUR_AND_BLOSSOM) {
         rval = CCtsp_subtour_and_blossom_loop (lp, silent, rstate);
         CCcheck_rval (rval, "CCtsp_subtour_and_blossom_loop failed");
     }
@@ -1021,65 +1244,77 @@ CLEANUP:
     return rval;
 }
 
-static int parseargs (int ac, char **av)
+#ifndef CONCORDE_NO_MAIN
+
+static int parseargs (int ac, char **av, concorde_opts *opts)
 {
     int c, inorm;
     int boptind = 1;
     char *boptarg = (char *) NULL;
 
-    /* remaining: aAbcGHjlLpQWY */
+    /* remaining: aAcGHlLpQWY */
 
-    while ((c = CCutil_bix_getopt (ac, av, "BC:dD:e:E:fF:g:hiIJ:k:K:mM:n:N:o:P:qr:R:s:S:t:T:u:UvVwX:xyz:Z:", &boptind, &boptarg)) != EOF)
+    while ((c = CCutil_bix_getopt (ac, av, "bBC:dD:e:E:fF:g:hiIj:J:k:K:mM:n:N:o:P:qr:R:s:S:t:T:u:UvVwX:xyz:Z:", &boptind, &boptarg)) != EOF)
         switch (c) {
+        case 'b':
+            /* The dat file holds integer coordinates in the binary format
+               read by CCutil_getdata () (1 reads ints, 2 would read doubles);
+               the norm is given by -N. */
+            binary_in = 1;
+            tsplib_in = 0;
+            break;
         case 'B':
-            bfs_branching = 0;
+            opts->bfs_branching = 0;
             break;
         case 'C':
-            maxchunksize = atoi(boptarg);
+            opts->maxchunksize = atoi(boptarg);
             break;
         case 'd':
-            dfs_branching = 1;
-	    bfs_branching = 0;
+            opts->dfs_branching = 1;
+	    opts->bfs_branching = 0;
             break;
         case 'D':
-            edgegenfname = boptarg;
+            opts->edgegenfname = boptarg;
             break;
         case 'e':
-            edgefname = boptarg;
+            opts->edgefname = boptarg;
             break;
         case 'E':
-            fullfname = boptarg;
-	    valid_edges = 1;
+            opts->fullfname = boptarg;
+	    opts->valid_edges = 1;
             break;
         case 'f':
-            output_tour_as_edges = 1;
+            opts->output_tour_as_edges = 1;
             break;
         case 'F':
-            filecutname = boptarg;
+            opts->filecutname = boptarg;
             break;
         case 'g':
             grunthostname = boptarg;
             break;
         case 'h':
-            be_nethost = 1;
+            opts->hostport = CCtsp_HOST_PORT;
             break;
         case 'i':
-            just_cuts = CC_JUST_BLOSSOM;
+            opts->just_cuts = CC_JUST_BLOSSOM;
             break;
         case 'I':
-            just_cuts = CC_JUST_SUBTOUR;
+            opts->just_cuts = CC_JUST_SUBTOUR;
+            break;
+        case 'j':
+            result_fd = atoi (boptarg);
             break;
         case 'J':
-            tentative_branch_num = atoi (boptarg);
+            opts->tentative_branch_num = atoi (boptarg);
             break;
         case 'k':
             nnodes_want = atoi (boptarg);
             break;
         case 'K':
-            cutbossname = boptarg;
+            opts->cutbossname = boptarg;
             break;
         case 'm':
-            multiple_chunker = 1;
+            opts->multiple_chunker = 1;
             break;
         case 'M':
             masterfname = boptarg;
@@ -1088,88 +1323,88 @@ static int parseargs (int ac, char **av)
             problname = boptarg;
             break;
         case 'o':
-            outfname = boptarg;
+            opts->outfname = boptarg;
             break;
         case 'P':
-            poolfname = boptarg;
+            opts->poolfname = boptarg;
             break;
         case 'q':
-            dontcutroot = 1;
+            opts->dontcutroot = 1;
             break;
         case 'r':
             gridsize = atoi(boptarg);
             break;
         case 'R':
-            restartfname = boptarg;
+            opts->restartfname = boptarg;
             break;
         case 's':
-            seed = atoi (boptarg);
+            opts->seed = atoi (boptarg);
             break;
         case 'S':
-            probfname = boptarg;
+            opts->probfname = boptarg;
             break;
         case 't':
-            tourfname =  boptarg;
+            opts->tourfname =  boptarg;
             break;
 #ifdef CCtsp_USE_DOMINO_CUTS
         case 'Z':
-            usedominos = atoi(boptarg);
+            opts->usedominos = atoi(boptarg);
             break;
         case 'T':
-            dombossname = boptarg;
-            if (!usedominos) usedominos = 1;
+            opts->dombossname = boptarg;
+            if (!opts->usedominos) opts->usedominos = 1;
             break;
 #endif
         case 'u':
-            initial_ub = atof (boptarg);
+            opts->initial_ub = atof (boptarg);
             break;
         case 'U':
-            usebranchcliques = 0;
+            opts->usebranchcliques = 0;
             break;
         case 'v':
-            run_silently = 0;
+            opts->silent = 0;
             break;
         case 'V':
-            just_cuts = CC_JUST_FAST_CUTS;
-            maxchunksize = 0;
+            opts->just_cuts = CC_JUST_FAST_CUTS;
+            opts->maxchunksize = 0;
             break;
         case 'w':
-            just_cuts = CC_JUST_SUBTOUR_AND_BLOSSOM;
+            opts->just_cuts = CC_JUST_SUBTOUR_AND_BLOSSOM;
             break;
         case 'X':
-            xfname = boptarg;
+            opts->xfname = boptarg;
             break;
         case 'x':
             unlink_files = 1;
             break;
         case 'y':
-            simple_branching = 1;
+            opts->simple_branching = 1;
             break;
         case 'z':
-            want_rcnearest = atoi (boptarg);
+            opts->want_rcnearest = atoi (boptarg);
             break;
         case 'N':
             inorm = atoi (boptarg);
             switch (inorm) {
-            case 0: norm = CC_MAXNORM; break;
-            case 1: norm = CC_MANNORM; break;
-            case 2: norm = CC_EUCLIDEAN; break;
-            case 3: norm = CC_EUCLIDEAN_3D; break;
-            case 4: norm = CC_USER; break;
-            case 5: norm = CC_ATT; break;
-            case 6: norm = CC_GEOGRAPHIC; break;
-            case 7: norm = CC_MATRIXNORM; break;
-            case 8: norm = CC_DSJRANDNORM; break;
-            case 9: norm = CC_CRYSTAL; break;
-            case 10: norm = CC_SPARSE; break;
-            case 11: norm = CC_RHMAP1; break;
-            case 12: norm = CC_RHMAP2; break;
-            case 13: norm = CC_RHMAP3; break;
-            case 14: norm = CC_RHMAP4; break;
-            case 15: norm = CC_RHMAP5; break;
-            case 16: norm = CC_EUCTOROIDAL; break;
-            case 17: norm = CC_GEOM; break;
-            case 18: norm = CC_EUCLIDEAN_CEIL; break;
+            case 0: opts->norm = CC_MAXNORM; break;
+            case 1: opts->norm = CC_MANNORM; break;
+            case 2: opts->norm = CC_EUCLIDEAN; break;
+            case 3: opts->norm = CC_EUCLIDEAN_3D; break;
+            case 4: opts->norm = CC_USER; break;
+            case 5: opts->norm = CC_ATT; break;
+            case 6: opts->norm = CC_GEOGRAPHIC; break;
+            case 7: opts->norm = CC_MATRIXNORM; break;
+            case 8: opts->norm = CC_DSJRANDNORM; break;
+            case 9: opts->norm = CC_CRYSTAL; break;
+            case 10: opts->norm = CC_SPARSE; break;
+            case 11: opts->norm = CC_RHMAP1; break;
+            case 12: opts->norm = CC_RHMAP2; break;
+            case 13: opts->norm = CC_RHMAP3; break;
+            case 14: opts->norm = CC_RHMAP4; break;
+            case 15: opts->norm = CC_RHMAP5; break;
+            case 16: opts->norm = CC_EUCTOROIDAL; break;
+            case 17: opts->norm = CC_GEOM; break;
+            case 18: opts->norm = CC_EUCLIDEAN_CEIL; break;
             default:
                 usage (av[0]);
                 return 1;
@@ -1192,23 +1427,24 @@ static int parseargs (int ac, char **av)
     }
 
     if (datfname == (char *) NULL && nnodes_want == 0 &&
-        probfname == (char *) NULL && edgefname == (char *) NULL &&
+        opts->probfname == (char *) NULL &&
+        opts->edgefname == (char *) NULL &&
         masterfname == (char *) NULL && grunthostname == (char *) NULL) {
         usage (av[0]);
         return 1;
     }
 
     if (datfname == (char *) NULL && masterfname == (char *) NULL &&
-        edgefname != (char *) NULL) {
+        opts->edgefname != (char *) NULL) {
         fprintf (stderr, "cannot give edgefile without a dat or master file\n");
         return 1;
     }
 
-    if (eliminate_edges < 0) {
-        if (bfs_branching || dfs_branching) {
-            eliminate_edges = 1;
+    if (opts->eliminate_edges < 0) {
+        if (opts->bfs_branching || opts->dfs_branching) {
+            opts->eliminate_edges = 1;
         } else {
-            eliminate_edges = 0;
+            opts->eliminate_edges = 0;
         }
     }
 
@@ -1218,6 +1454,7 @@ static int parseargs (int ac, char **av)
 static void usage (char *f)
 {
     fprintf (stderr, "Usage: %s [-see below-] [dat_file]\n", f);
+    fprintf (stderr, "   -b    dat file in binary-ints format (norm from -N, default 2)\n");
     fprintf (stderr, "   -B    do not branch\n");
     fprintf (stderr, "   -C #  maximum chunk size in localcuts (default 16)\n");
     fprintf (stderr, "   -d    use dfs branching instead of bfs\n");
@@ -1230,6 +1467,7 @@ static void usage (char *f)
     fprintf (stderr, "   -h    be a boss for the branching\n");
     fprintf (stderr, "   -i    just solve the blossom polytope\n");
     fprintf (stderr, "   -I    just solve the subtour polytope\n");
+    fprintf (stderr, "   -j #  write a one-line record of the results to file descriptor #\n");
     fprintf (stderr, "   -J #  number of tentative branches\n");
     fprintf (stderr, "   -k #  number of nodes for random problem\n");
     fprintf (stderr, "   -K h  use cut server h\n");
@@ -1262,3 +1500,5 @@ static void usage (char *f)
     fprintf (stderr, "         8=DSJRAND, 9=CRYSTAL, 10=SPARSE, 11-15=RH-norm 1-5, 16=TOROIDAL\n");
     fprintf (stderr, "         17=GEOM, 18=JOHNSON\n");
 }
+
+#endif /* CONCORDE_NO_MAIN */
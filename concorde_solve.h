@@ -0,0 +1,290 @@
+/**
+ *	\file
+ *	\brief Solves a TSP instance with \e Concorde without starting a separate
+ *	process.
+ *
+ *	These functions are defined in the (modified) file concorde.c, so a program
+ *	using them must be linked with that file and the \e Concorde library, e.g.
+ *	\code
+ *  gcc -o prog prog.c concorde.c concorde.a -lm
+ *	\endcode
+ *	(concorde.c must be compiled with the include files of \e Concorde and with
+ *	\c CONCORDE_NO_MAIN defined, so it doesn't define \c main()). The
+ *	\c concorde program itself is built from the same file, and its \c main()
+ *	only turns the command line into a concorde_opts structure, reads the
+ *	instance and solves it with the same code as concorde_solve() (without
+ *	copying the instance, so any norm can be used).
+ *
+ *	The instance is given as an array of coordinates, so no TSPlib file needs
+ *	to be written, and the results are returned in a structure, so no output
+ *	needs to be read. \e Concorde still writes its usual files (the master file,
+ *	cut pools etc.) in the current directory, and still prints its progress on
+ *	\c stdout.
+ */
+
+#ifndef CONCORDE_SOLVE_H
+#define CONCORDE_SOLVE_H
+
+
+/**
+ *	\brief The options used to solve an instance. These are the options of the
+ *	\c concorde program which affect how an instance is solved (the program's
+ *	flag is given in brackets). Use concorde_default_opts() to get the values
+ *	the program uses when no flags are given.
+ *
+ *	The file names are \c NULL when the file isn't used.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The name of the instance (\c -n), which is used to name the files
+	 *	\e Concorde creates, or \c NULL for "unnamed".
+	 */
+	char *name;
+
+	/**
+	 *	\brief The random seed (\c -s).
+	 */
+	int seed;
+
+	/**
+	 *	\brief The norm used to compute the distance between two cities (\c -N),
+	 *	e.g. \c CC_EUCLIDEAN. It must be a norm which only uses the x and y
+	 *	coordinates of the cities.
+	 */
+	int norm;
+
+	/**
+	 *	\brief The order the cities were numbered in by \e Concorde when they
+	 *	were read from a master file (\c -M), or \c NULL to find a tour and
+	 *	number them in its order.
+	 */
+	const int *ptour;
+
+	/**
+	 *	\brief True (1) to use best-first branching (turned off by \c -B).
+	 */
+	int bfs_branching;
+
+	/**
+	 *	\brief True (1) to use depth-first branching (\c -d). This turns off
+	 *	best-first branching.
+	 */
+	int dfs_branching;
+
+	/**
+	 *	\brief True (1) to use simple branching (\c -y).
+	 */
+	int simple_branching;
+
+	/**
+	 *	\brief True (1) to branch on cliques (turned off by \c -U).
+	 */
+	int usebranchcliques;
+
+	/**
+	 *	\brief True (1) to branch on long edges.
+	 */
+	int longedge_branching;
+
+	/**
+	 *	\brief The number of tentative branches (\c -J).
+	 */
+	int tentative_branch_num;
+
+	/**
+	 *	\brief True (1) to eliminate edges using reduced costs, 0 not to, or -1
+	 *	to only do so when branching (which is what the program does).
+	 */
+	int eliminate_edges;
+
+	/**
+	 *	\brief True (1) to eliminate edges from the full edge list too (if it
+	 *	is valid).
+	 */
+	int eliminate_sparse;
+
+	/**
+	 *	\brief The maximum chunk size for the local cuts (\c -C, 0 for no local
+	 *	cuts).
+	 */
+	int maxchunksize;
+
+	/**
+	 *	\brief True (1) to use multiple chunk sizes (\c -m).
+	 */
+	int multiple_chunker;
+
+	/**
+	 *	\brief True (1) to use tighten.
+	 */
+	int usetighten;
+
+	/**
+	 *	\brief The domino parity cuts to use (\c -Z, 0 for none).
+	 */
+	int usedominos;
+
+	/**
+	 *	\brief True (1) to not cut the root LP (\c -q).
+	 */
+	int dontcutroot;
+
+	/**
+	 *	\brief True (1) to price over the complete graph.
+	 */
+	int complete_price;
+
+	/**
+	 *	\brief Only solve the subtour or blossom polytope, or only run the fast
+	 *	cuts (\c -I, \c -i, \c -w or \c -V), or 0 to solve the instance.
+	 */
+	int just_cuts;
+
+	/**
+	 *	\brief An upper bound on the length of an optimal tour (\c -u), e.g. the
+	 *	length of a known tour. Use \c CCtsp_LP_MAXDOUBLE if none is known.
+	 */
+	double initial_ub;
+
+	/**
+	 *	\brief A tour to start with (\c -t), the initial edge set (\c -e) or the
+	 *	edgegen file used to find it (\c -D), and the full edge set (\c -E).
+	 */
+	char *tourfname, *edgefname, *edgegenfname, *fullfname;
+
+	/**
+	 *	\brief True (1) if the full edge set contains every edge of an optimal
+	 *	tour (set by \c -E).
+	 */
+	int valid_edges;
+
+	/**
+	 *	\brief The file to read extra cuts from (\c -F), the cut pool (\c -P) and
+	 *	the domino cut pool.
+	 */
+	char *filecutname, *poolfname, *dominopoolfname;
+
+	/**
+	 *	\brief The problem file to start from (\c -S), or the restart file to
+	 *	continue branching from (\c -R).
+	 */
+	char *probfname, *restartfname;
+
+	/**
+	 *	\brief The file to write the optimal tour to (\c -o), and true (1) to
+	 *	write it as a list of edges (\c -f).
+	 */
+	char *outfname;
+	int output_tour_as_edges;
+
+	/**
+	 *	\brief The file to write the last fractional solution of the root LP to
+	 *	(\c -X), and the number of edges with the lowest reduced costs to write
+	 *	to name.rcn (\c -z, 0 for none).
+	 */
+	char *xfname;
+	int want_rcnearest;
+
+	/**
+	 *	\brief The cut server (\c -K) and domino server (\c -T) to use.
+	 */
+	char *cutbossname, *dombossname;
+
+	/**
+	 *	\brief The port the grunts doing the branching connect to (set by
+	 *	\c -h), or 0 to do the branching here.
+	 */
+	unsigned short hostport;
+
+	/**
+	 *	\brief True (1) to save the proof of optimality.
+	 */
+	int save_proof;
+
+	/**
+	 *	\brief True (1) to branch by hand.
+	 */
+	int standalone_branch;
+
+	/**
+	 *	\brief True (1) for less output (turned off by \c -v).
+	 */
+	int silent;
+} concorde_opts;
+
+
+/**
+ *	\brief The results of solving an instance.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The time (in seconds) taken to solve the instance (this is the
+	 *	"Total Running Time" printed by the \c concorde program, except it
+	 *	doesn't include the time taken to read the instance).
+	 */
+	double runningtime;
+
+	/**
+	 *	\brief The number of branch and bound nodes.
+	 */
+	int bbnodes;
+
+	/**
+	 *	\brief The length of an optimal tour.
+	 */
+	double optimal;
+
+	/**
+	 *	\brief The lower bound given by the LP at the root of the branch and
+	 *	bound tree.
+	 */
+	double lowerbound;
+
+	/**
+	 *	\brief The number of rows, columns and nonzeros of the final LP at the
+	 *	root of the branch and bound tree (0 if no LP was solved, e.g. for
+	 *	instances with less than 10 cities).
+	 */
+	int rows, cols, nonzeros;
+
+	/**
+	 *	\brief The time (in seconds) spent at the root of the branch and bound
+	 *	tree, and the parts of it spent in the cutting loop, finding tours
+	 *	with the x-heuristic (Lin-Kernighan) and exact pricing.
+	 */
+	double root_time, cutting_time, linkern_time, price_time;
+
+	/**
+	 *	\brief The time (in seconds) spent branching (0 if there was no need to
+	 *	branch).
+	 */
+	double branching_time;
+} concorde_result;
+
+
+/**
+ *	\brief Initialises the options to the values the \c concorde program uses
+ *	when no flags are given (except the random seed, which is 0).
+ *
+ *	\param opts The options to initialise.
+ */
+void concorde_default_opts(concorde_opts *opts);
+
+/**
+ *	\brief Solves the TSP instance with the given cities.
+ *
+ *	\param ncount The number of cities.
+ *	\param x      The x-coordinates of the cities.
+ *	\param y      The y-coordinates of the cities.
+ *	\param opts   The options to use, or \c NULL to use the default options.
+ *	\param result The results are returned in this parameter.
+ *	\return \c 0 if the instance was solved, non-zero otherwise (e.g. if there
+ *	        are less than three cities, or the norm needs more than the x and y
+ *	        coordinates of the cities).
+ */
+int concorde_solve(int ncount, const double *x, const double *y,
+                   const concorde_opts *opts, concorde_result *result);
+
+#endif
@@ -8,8 +8,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <limits.h>
 #include "ls.h"
+#include "ls_cache.h"
+#include "ls_index.h"
+#include "../lsys.h"
 #include "../util/upper_bound.h"
+#include "../util/sampling.h"
+#include "../util/launch.h"
+#include "../util/workspace.h"
+#include "../util/tsplib.h"
 #include "../mt19937ar/t_mt19937ar.h"
 
 
@@ -19,7 +28,8 @@
  */
 mt_prng rng;
 
-#define NUM_TSP_ITER   3    /* The number of times to run Concorde on an instance when computing the AVERAGE fitness. */
+#define NUM_TSP_ITER         3    /* The number of times (by default) to run Concorde on an instance when computing the AVERAGE fitness. */
+#define MAX_INSTANCE_SIZE 1500    /* Concorde isn't run on instances with more cities than this.                                         */
 
 
 /**
@@ -317,6 +327,7 @@ lsystem *create_ls(const int num_rules, const int rule_length)
 	}
 
 	ls->computed_f = 0;
+	memset(ls->censored, 0, sizeof(ls->censored));
 
 	return ls;
 }
@@ -336,122 +347,372 @@ void delete_ls(lsystem *ls)
 
 
 
-void runningtime(char *filename, double *runtime, int *numbbnodes) {
-	/* Create and open a pipe to the concorde program. */
-	FILE *concorde_pipe;
-	char *command;
-	asprintf(&command, "concorde -s 0 %s", filename);
-	concorde_pipe = popen(command, "r");
-	if (concorde_pipe == NULL)
+/**
+ *	\brief How long (and with how much memory) each run of Concorde is allowed
+ *	to take (see set_run_budget()).
+ */
+static run_budget budget = { 0, 0, 0 };
+
+/**
+ *	\brief True (1) if the instances are written in \e Concorde's binary format
+ *	(see set_binary_instances()).
+ */
+static int binary_instances = 0;
+
+
+void set_run_budget(double wall, int cpu, long memory)
+{
+	budget.wall = (wall > 0) ? wall : 0;
+	budget.cpu = (cpu > 0) ? cpu : 0;
+	budget.memory = (memory > 0) ? memory : 0;
+}
+
+
+void set_binary_instances(int binary)
+{
+	binary_instances = binary;
+}
+
+
+void run_concorde(char *filename, concorde_run *run)
+{
+	if (launch_concorde(filename, 0, binary_instances, &budget, run))
 	{
-		fprintf(stderr, "Could not open concorde pipe\n");
+		fprintf(stderr, "Could not run concorde\n");
 		exit(1);
 	}
+}
 
-	int nbytes = 810;
-	char *concorde_output = (char *)malloc(nbytes + 1), *pos;
-	int bytesread;
 
-	/* Run concorde and get the output */
-	double rtime = 0;
-	int bbnodes = 0;
-	bytesread = getdelim(&concorde_output, &nbytes, "\n\n", concorde_pipe);
+int runningtime(char *filename, double *runtime, int *numbbnodes) {
+	concorde_run run;
 
 	/* I could have used my own timer, but the Concorde program already
 	   outputs this information. So I decided to use their definition of
-	   Concorde's running time.                                          */
+	   Concorde's running time. If something went wrong, the running time is
+	   0 (so it has a weak fitness value), unless Concorde was killed because
+	   it went over its time budget.                                         */
+	run_concorde(filename, &run);
+
+	*runtime = run.runtime;
+	*numbbnodes = run.bbnodes;
+	return run.censored;
+}
 
-	/* If there is no '?' in the output, something went wrong. Since we're
-	   only interested in instances that make it work (and are difficult for it)
-	   we will return 0 and so it has a weak fitness value.                      */
-	pos = strchr(concorde_output, '?');
-	if (pos != NULL)
-		rtime = strtod(pos+1, NULL);
 
-	pos = strchr(concorde_output, '&');
-	if (pos != NULL)
-		bbnodes = (int)strtol(pos+1, NULL, 10);
 
-	if (pclose(concorde_pipe) == -1)
+/**
+ *	\brief Returns the index (0-25) of the symbol \c obj stands for, or -1 if it
+ *	isn't a symbol (i.e. it can't be replaced by a rule).
+ */
+static int symbol_index(const ruleobj *obj)
+{
+	switch (obj->type)
 	{
-		fprintf(stderr, "Could not close concorde pipe\n");
+		case F: case G: case D: case MM: case RULE:
+			if ((obj->str[0] >= 'A') && (obj->str[0] <= 'Z'))
+				return obj->str[0] - 'A';
 	}
-	free(concorde_output);
+	return -1;
+}
+
+
+/**
+ *	\brief Adds the number of times each symbol appears in the rule to
+ *	\c count. Like lsys.c, the rule ends at a \c ] which has no matching \c [.
+ */
+static void count_symbols(const ruleobj *rule, int rulelength, double count[26])
+{
+	int j, s, depth = 0;
 
-	*runtime = rtime;
-	*numbbnodes = bbnodes;
+	for (j = 0; j < rulelength; j++)
+	{
+		if (rule[j].type == PUSH)
+			depth++;
+		else if (rule[j].type == POP)
+		{
+			if (depth == 0)
+				break;
+			depth--;
+		}
+		else if ((s = symbol_index(&rule[j])) >= 0)
+			count[s]++;
+	}
 }
 
 
+void instance_sizes(const lsystem *ls, int maxorder, double *sizes)
+{
+	/* growth[a][b] is the number of b's that a is replaced by. */
+	double growth[26][26], axiom[26], points[26], next[26];
+	int hasrule[26];
+	int i, a, b, k;
+
+	memset(growth, 0, sizeof(growth));
+	memset(axiom, 0, sizeof(axiom));
+	memset(hasrule, 0, sizeof(hasrule));
+	count_symbols(ls->rule[0], ls->rulelength[0], axiom);
+	for (i = 1; i < ls->numrules; i++)
+	{
+		a = ls->startvar[i-1] - 'A';
+		if ((a < 0) || (a >= 26))
+			continue;
+		/* (Every rule with the same name replaces the symbol.) */
+		hasrule[a] = 1;
+		count_symbols(ls->rule[i], ls->rulelength[i], growth[a]);
+	}
+
+	/* points[a] is the number of points symbol a creates when it is replaced
+	   k times (F and D are the only symbols which create points when they are
+	   drawn). */
+	for (a = 0; a < 26; a++)
+		points[a] = ((a == 'F' - 'A') || (a == 'D' - 'A'));
+
+	for (k = 1; k <= maxorder; k++)
+	{
+		for (a = 0; a < 26; a++)
+		{
+			if (!hasrule[a])
+			{
+				next[a] = points[a];
+				continue;
+			}
+			next[a] = 0;
+			for (b = 0; b < 26; b++)
+				if (growth[a][b] != 0)
+					next[a] += growth[a][b]*points[b];
+		}
+		memcpy(points, next, sizeof(points));
+
+		/* Order k is the axiom with each symbol replaced k times. */
+		sizes[k-1] = 0;
+		for (a = 0; a < 26; a++)
+			if (axiom[a] != 0)
+				sizes[k-1] += axiom[a]*points[a];
+	}
+}
+
 
 /**
  *	\brief Creates NUM_ORDER_TEST TSPlib files representing the specified
- *	lsystem. The files are created in the current directory. The names of each file
+ *	lsystem. The files are created in the given workspace. The paths of each file
  *	are returned in the array \c filenames. The size of each instance is stored
  *	in the array <c>ls->instancesize</c>.
  *
+ *	No file is created (and its path is \c NULL) for the orders above the
+ *	largest one with at most MAX_INSTANCE_SIZE points, since Concorde isn't run
+ *	on them. Their sizes are the predicted ones. If the points can't be
+ *	created, every size is -1.
+ *
  *	You \e must delete the individual strings and the array itself when finished
  *	with them.
+ *
+ *	\param filenames The paths of the files are returned in this parameter.
+ *	\param ls        The L-System.
+ *	\param predicted The size of each instance (see instance_sizes()).
+ *	\param ws        The workspace to create the files in.
  */
-void createTSPFiles(char ***filenames, lsystem *ls)
+void createTSPFiles(char ***filenames, lsystem *ls, const double *predicted, const workspace *ws)
 {
 	char **fnames = (char **)malloc(sizeof(char *)*NUM_ORDER_TEST);
+	char name[16];
+	lsys_point *points[NUM_ORDER_TEST];
+	int sizes[NUM_ORDER_TEST];
+
+	/* Concorde isn't run on instances which are too large, so only the orders up
+	   to the largest one it is run on need to be created. */
+	int i, numnodes, error, maxorder = 0;
+	for (i = 0; i < NUM_ORDER_TEST; i++)
+	{
+		if (predicted[i] <= MAX_INSTANCE_SIZE)
+			maxorder = i + 1;
+		sizes[i] = (predicted[i] < INT_MAX) ? (int)predicted[i] : INT_MAX;
+	}
+
+	/* Compute the x-y coordinates of the instances (of every order) represented by this L-System.
+	   (Each call has its own context, so L-Systems can be created in different threads.) */
+	if (maxorder > 0)
+	{
+		lsys_ctx *ctx = create_lsys_ctx();
+		if ((ctx == NULL) || LsystemPointsOrders(ctx, maxorder, ls, points, sizes))
+		{
+			for (i = 0; i < NUM_ORDER_TEST; i++)
+				sizes[i] = -1;
+		}
+		delete_lsys_ctx(ctx);
+	}
 
-	int i, numnodes;
 	printf("\nInstance Sizes: ");
 	for (i = 0; i < NUM_ORDER_TEST; i++)
 	{
-		asprintf(&fnames[i], "plot_%d", i+1);
-		savetofile(ls, "temp.l", "temp", NULL);
+		sprintf(name, "plot_%d", i+1);
+		fnames[i] = workspace_file(ws, name);
 
-		/* Compute the x-y coordinates of the instance represented by this L-System. */
-		numnodes = Lsystem(i + 1,"temp.l", "temp", "plots");
+		numnodes = sizes[i];
 		ls->instancesize[i] = numnodes;
 		printf("%d\t", numnodes);
-
-		/* Now create a valid TSPlib file. */
-		FILE *outfile_stream = fopen(fnames[i], "w");
-
-		/* Check that the file has sucessfully been opened */
-		if (outfile_stream == NULL)
+		if (i >= maxorder)
 		{
-			printf("ERROR: File '%s' could not be opened\n", fnames[i]);
-			return;
+			/* There are no points (and no need for a file). */
+			free(fnames[i]);
+			fnames[i] = NULL;
+			continue;
 		}
 
-		/* Build the header file */
-		fprintf(outfile_stream, "NAME: %s\n", fnames[i]);
-		fprintf(outfile_stream, "TYPE: TSP\n");
-		fprintf(outfile_stream, "COMMENT: Created by Farhan Ahammed (farhan.ahammed@studentmail.newcastle.edu.au)\n");
-		fprintf(outfile_stream, "DIMENSION: %d\n", numnodes);
-		fprintf(outfile_stream, "EDGE_WEIGHT_TYPE: EUC_2D\n");
-		fprintf(outfile_stream, "NODE_COORD_TYPE: TWOD_COORDS\n");
-		fprintf(outfile_stream, "NODE_COORD_SECTION:\n");
-
-		/* Add the coordinates of the points in this instance. */
-		FILE *nodefile = fopen("plots", "r");
-		char line[255];
-		while(fgets(line, 255, nodefile) != NULL)
-		{
-			fprintf(outfile_stream, "%s", line);
-		}
-		fclose(nodefile);
-		remove("plots");
-		remove("temp.l");
+		/* Now create a valid TSPlib file (or a binary file, which Concorde reads
+		   without having to parse any text). */
+		if (binary_instances)
+			error = write_binary(fnames[i], (numnodes > 0) ? points[i] : NULL, numnodes);
+		else
+			error = write_tsplib(fnames[i], name, (numnodes > 0) ? points[i] : NULL, numnodes);
+		if (error)
+			printf("ERROR: File '%s' could not be written\n", fnames[i]);
+		if (numnodes > 0)
+			free(points[i]);
+	}
+
+	printf("\n");
 
-		fprintf(outfile_stream, "EOF:\n");
+	(*filenames) = fnames;
+}
 
-		/* Close the file */
-		int close_error_plot = fclose(outfile_stream);
-		if (close_error_plot)
+
+/**
+ *	\brief How many times Concorde is run on each instance (see set_sampling()).
+ */
+static sampling_plan plan = { NUM_TSP_ITER, NUM_TSP_ITER, 0 };
+
+/**
+ *	\brief Concorde stops being run on the instances of an L-System once it is
+ *	clear its fitness will be less than this (see set_fitness_cutoff()). There
+ *	is no cutoff if this is negative.
+ */
+static double fitness_cutoff = -1;
+
+
+void set_sampling(int min_runs, int max_runs, double rel_ci)
+{
+	if (min_runs > 0) plan.min_runs = min_runs;
+	if (max_runs > 0) plan.max_runs = max_runs;
+	if (plan.max_runs < plan.min_runs) plan.max_runs = plan.min_runs;
+	plan.rel_ci = rel_ci;
+}
+
+
+void set_fitness_cutoff(double cutoff)
+{
+	fitness_cutoff = cutoff;
+}
+
+
+/**
+ *	\brief Computes the fitness of an L-System from the average running times
+ *	of its instances.
+ *
+ *	\param points The sizes and average running times of the instances.
+ *	\param size   The size of the array \c points.
+ *	\param func   The upper bound of the running times is returned in this array.
+ *	\param se     The sum of errors is returned in this parameter.
+ *	\return The fitness.
+ */
+static double points_fitness(const data_point *points, int size, double func[5], double *se)
+{
+	int i = 0;
+	while ((i < size) && ((points[i].x < 100) || (points[i].y == 0))) i++;
+	int offset = i-1;
+	if (offset < 0) offset = 0;
+
+	/* We might not like too many (x,0) points, but we need to have at least
+	   three points to compute the upper bound. */
+	if (size - offset < 3) offset = size - 3;
+
+	/* Compute the upper bound of the running times of the plots of different sizes. */
+	find_upper_bound(func, points + offset, size - offset);
+
+	/* Compute the sum of errors. */
+	*se = sum_error(func, points + offset, size - offset);
+
+	/* We want to maximise 'func[0]' and minimise 'se'. */
+	/* TODO: Incorporate all the ls->numbbnodes[i] into the fitness function. */
+	return (func[0]*func[0])/(*se+1);
+}
+
+
+/**
+ *	\brief Returns the largest fitness the L-System could reasonably have, given
+ *	the running times measured so far. Each average running time is moved to
+ *	either end of its 95% confidence interval (or left where it is) and the
+ *	largest fitness found is returned.
+ *
+ *	\param points The sizes and average running times of the instances.
+ *	\param stats  The results of the runs made on each instance.
+ *	\param size   The size of the arrays \c points and \c stats.
+ *	\return The largest fitness.
+ */
+static double optimistic_fitness(const data_point *points, const sample_stats *stats, int size)
+{
+	data_point p[size];
+	double func[5], se, f, ci, best = 0;
+	int i, combo, numcombos = 1, c;
+
+	for (i = 0; i < size; i++)
+	{
+		/* We can't tell how large the running time could be. */
+		if ((stats[i].n == 1) || stats[i].censored)
+			return HUGE_VAL;
+		numcombos *= 3;
+	}
+
+	for (combo = 0; combo < numcombos; combo++)
+	{
+		c = combo;
+		for (i = 0; i < size; i++)
 		{
-			printf("ERROR: File '%s' could not be closed\n", fnames[i]);
+			p[i] = points[i];
+			if (stats[i].n > 0)
+			{
+				ci = sample_ci(&stats[i]);
+				p[i].y = stats[i].mean + (c%3 - 1)*ci;
+				if (p[i].y <= 0) p[i].y = stats[i].mean;
+			}
+			c /= 3;
 		}
+		f = points_fitness(p, size, func, &se);
+		if (f > best) best = f;
 	}
+	return best;
+}
 
-	printf("\n");
 
-	(*filenames) = fnames;
+/**
+ *	\brief Runs Concorde once on the specified TSPlib file and adds the result
+ *	to \c stats.
+ */
+static void sample_runningtime(char *filename, sample_stats *stats)
+{
+	concorde_run run;
+
+	run_concorde(filename, &run);
+	if (run.censored)
+	{
+		sample_censor(stats, run.runtime, (double)run.bbnodes);
+		printf("RT%2d: >= %0.4f (over budget)\n", stats->n, run.runtime);
+	}
+	else if (run.outofmemory)
+	{
+		sample_out_of_memory(stats, run.runtime, (double)run.bbnodes);
+		printf("RT%2d: Ran out of memory (status %d)\n", stats->n, run.status);
+	}
+	else if (!run.finished)
+	{
+		sample_fail(stats);
+		printf("RT%2d: Failed (status %d)\n", stats->n + 1, run.status);
+	}
+	else
+	{
+		sample_add(stats, run.runtime, (double)run.bbnodes);
+		printf("RT%2d: %0.4f\tBB: %d\tCPU: %0.3fu %0.3fs\tRSS: %ldK\n", stats->n, run.runtime, run.bbnodes, run.user, run.sys, run.maxrss);
+	}
 }
 
 
@@ -473,98 +734,239 @@ double fitness(lsystem *ls)
 	}
 	ls->f = 0;
 
-	/* Create the TSPlib files. */
-	char **filenames;
-	createTSPFiles(&filenames, ls);
-
-	print_ls(ls);
-
-	int i, j, bb;
+	int i, more;
 	int size = NUM_ORDER_TEST;
 	data_point points[size];
-	double rt, n, mean, S, delta;
-	for (i = 0; i < NUM_ORDER_TEST; i++)
+	sample_stats stats[size];
+
+	/* The fitness is 0 if some instance sizes are the same. The sizes can be
+	   found from the rules, so there is no need to create the instances (or
+	   even look in the cache) to find this out. */
+	double predicted[NUM_ORDER_TEST];
+	instance_sizes(ls, NUM_ORDER_TEST, predicted);
+	for (i = 1; i < NUM_ORDER_TEST; i++)
 	{
-		points[i].x = ls->instancesize[i];
-		ls->avgbbnodes[i] = 0;
-		printf("size: %.0f\n", points[i].x);
+		if (predicted[i] == predicted[i-1])
+			break;
+	}
+	if (i < NUM_ORDER_TEST)
+	{
+		printf("\nInstance Sizes: ");
+		for (i = 0; i < NUM_ORDER_TEST; i++)
+		{
+			ls->instancesize[i] = (predicted[i] < INT_MAX) ? (int)predicted[i] : INT_MAX;
+			ls->runningtimes[i] = ls->sd[i] = ls->avgbbnodes[i] = 0;
+			ls->censored[i] = 0;
+			printf("%d\t", ls->instancesize[i]);
+		}
+		printf("\n");
+		print_ls(ls);
+		printf("Some instance sizes are the same!!\n");
 
+		ls->computed_f = 1;
+		printf("fitness: %f\n", ls->f);
+		return ls->f;
+	}
 
-		points[i].y = 0;
-		/* Run each instance twice and take the average.
-		   Instances with large sizes take too long to solve and I am more
-		   interested in the smaller sized instances anyway.               */
-		if (points[i].x > 1500)
+	/* See if Concorde has already been run on this L-System (or on one which
+	   only differs by the names of its rules). */
+	unsigned long long hash = ls_hash(ls);
+	ls_cache_entry entry[NUM_ORDER_TEST];
+	int cached = 1;
+	for (i = 0; i < NUM_ORDER_TEST; i++)
+	{
+		sample_init(&stats[i]);
+		/* A different instance size means the hash matched a different
+		   L-System (so the entry is treated as missing). */
+		if (!ls_cache_lookup(hash, i + 1, &entry[i]) ||
+		    (entry[i].instancesize != ((predicted[i] < INT_MAX) ? (int)predicted[i] : INT_MAX)))
 		{
-			points[i].y = 0;
-			printf("Size too large (> 1500 cities)\n");
+			entry[i].nruns = -1;
+			cached = 0;
 		}
 		else
 		{
-			n = mean = S = 0;
-			for (j = 0; j < NUM_TSP_ITER; j++)
-			{
-				runningtime(filenames[i], &rt, &bb);
-				ls->avgbbnodes[i] += (double)bb;
-				printf("RT%2d: %0.4f\tBB: %d\n", j+1, rt, bb);
-
-				/* This calculation is used to compute the standard deviation. */
-				n++;
-				delta = rt - mean;
-				mean += delta/n;
-				S += delta*(rt - mean); /* NOTE: This expression uses the new value of mean. */
-			}
-			points[i].y = mean;
-			ls->runningtimes[i] = points[i].y;
-			ls->avgbbnodes[i] /= NUM_TSP_ITER;
-			printf("\nAVG: %0.4f(%0.4f)\n", ls->runningtimes[i], ls->avgbbnodes[i]);
-
-			S = S/(n - 1);
-			ls->sd[i] = fastsqrt(S);
-			printf("SD:  %0.4f\n", ls->sd[i]);
-			printf("68%% lies within:  (%7.4f, %7.4f)\n", ls->runningtimes[i] - ls->sd[i], ls->runningtimes[i] + ls->sd[i]);
-			printf("95%% lies within:  (%7.4f, %7.4f)\n", ls->runningtimes[i] - 2*(ls->sd[i]), ls->runningtimes[i] + 2*(ls->sd[i]));
+			sample_restore(&stats[i], entry[i].nruns, entry[i].runningtime, entry[i].sd, entry[i].avgbbnodes, entry[i].sdbbnodes, entry[i].censored);
+			if ((entry[i].instancesize <= MAX_INSTANCE_SIZE) && !sample_done(&stats[i], &plan))
+				cached = 0;
 		}
+	}
 
+	workspace ws;
+	char **filenames = NULL;
+	if (cached)
+	{
+		/* There is no need to create the TSPlib files. */
+		printf("\nInstance Sizes: ");
+		for (i = 0; i < NUM_ORDER_TEST; i++)
+		{
+			ls->instancesize[i] = entry[i].instancesize;
+			printf("%d\t", ls->instancesize[i]);
+		}
 		printf("\n");
-		free(filenames[i]);
 	}
-	free(filenames);
-	system("rm -f Oplot* plot*");
-
-
-	for (i = 0; i < NUM_ORDER_TEST; i++)
+	else
 	{
-		if (ls->instancesize[i] == ls->instancesize[i-1])
+		/* Create the TSPlib files (in a directory no other evaluation is using). */
+		if (create_workspace(&ws))
 		{
+			fprintf(stderr, "Could not create a workspace to compute the fitness in\n");
+			exit(1);
+		}
+		createTSPFiles(&filenames, ls, predicted, &ws);
+
+		/* The sizes were predicted to be different (see above), so they can
+		   only be the same if the points couldn't be created. */
+		if (ls->instancesize[0] == -1)
+		{
+			print_ls(ls);
+			printf("The instances could not be created!!\n");
+			for (i = 0; i < NUM_ORDER_TEST; i++)
+			{
+				ls->runningtimes[i] = ls->sd[i] = ls->avgbbnodes[i] = 0;
+				ls->censored[i] = 0;
+				free(filenames[i]);
+			}
+			free(filenames);
+			delete_workspace(&ws);
 			ls->computed_f = 1;
-			ls->f = 0;
-			printf("Some instance sizes are the same!!\n");
 			printf("fitness: %f\n", ls->f);
 			return ls->f;
 		}
 	}
 
-	i = 0;
-	while ((points[i].x < 100) || (points[i].y == 0)) i++;
-	int offset = i-1;
+	print_ls(ls);
 
-	/* We might not like too many (x,0) points, but we need to have at least
-	   three points to compute the upper bound. */
-	if (size - offset < 3) offset = size - 3;
+	for (i = 0; i < NUM_ORDER_TEST; i++)
+	{
+		points[i].x = ls->instancesize[i];
+		points[i].y = 0;
+		points[i].censored = 0;
+		ls->runningtimes[i] = ls->sd[i] = ls->avgbbnodes[i] = 0;
+		ls->censored[i] = 0;
 
-	/* Compute the upper bound of the running times of the plots of different sizes. */
-	double func[5];
-	find_upper_bound(func, points + offset, size - offset);
+		/* A different instance size means the hash matched a different L-System. */
+		if ((entry[i].nruns != -1) && (entry[i].instancesize != ls->instancesize[i]))
+		{
+			entry[i].nruns = -1;
+			sample_init(&stats[i]);
+		}
+	}
 
-	/* Compute the sum of errors. */
-	double se = sum_error(func, points + offset, size - offset);
+	/* Run Concorde the minimum number of times on each instance.
+	   Instances with large sizes take too long to solve and I am more
+	   interested in the smaller sized instances anyway.               */
+	for (i = 0; i < NUM_ORDER_TEST; i++)
+	{
+		printf("size: %.0f\n", points[i].x);
+		if (points[i].x > MAX_INSTANCE_SIZE)
+		{
+			printf("Size too large (> %d cities)\n", MAX_INSTANCE_SIZE);
+			sample_init(&stats[i]);
+		}
+		else
+		{
+			if (stats[i].n > 0)
+				printf("Using the results of %d earlier runs\n", stats[i].n);
+			while (!sample_done(&stats[i], &plan) && (stats[i].n < plan.min_runs))
+				sample_runningtime(filenames[i], &stats[i]);
+		}
+		printf("\n");
+	}
+	more = 1;
+
+	/* Keep running Concorde on the instances whose average running times aren't
+	   known precisely enough. We stop early if it becomes clear this L-System
+	   can't do better than the cutoff (most L-Systems are mediocre, and we don't
+	   need precise running times to know that). */
+	while (more)
+	{
+		more = 0;
+		for (i = 0; i < NUM_ORDER_TEST; i++)
+			if ((points[i].x <= MAX_INSTANCE_SIZE) && !sample_done(&stats[i], &plan))
+				more = 1;
+		if (!more)
+			break;
+
+		if ((fitness_cutoff >= 0) && (optimistic_fitness(points, stats, size) < fitness_cutoff))
+		{
+			printf("Can't do better than the cutoff (%f), no more runs needed\n\n", fitness_cutoff);
+			break;
+		}
+
+		for (i = 0; i < NUM_ORDER_TEST; i++)
+		{
+			if ((points[i].x <= MAX_INSTANCE_SIZE) && !sample_done(&stats[i], &plan))
+			{
+				printf("size: %.0f\n", points[i].x);
+				sample_runningtime(filenames[i], &stats[i]);
+			}
+		}
+	}
+
+	for (i = 0; i < NUM_ORDER_TEST; i++)
+	{
+		if (points[i].x > MAX_INSTANCE_SIZE)
+		{
+			/* Remember the size, so the TSPlib files don't need to be created next time. */
+			if (entry[i].nruns == -1)
+			{
+				entry[i].hash = hash;
+				entry[i].order = i + 1;
+				entry[i].instancesize = ls->instancesize[i];
+				entry[i].nruns = 0;
+				entry[i].runningtime = entry[i].sd = 0;
+				entry[i].avgbbnodes = entry[i].sdbbnodes = 0;
+				entry[i].censored = 0;
+				ls_cache_store(&entry[i]);
+			}
+		}
+		else if (stats[i].n > 0)
+		{
+			points[i].y = stats[i].mean;
+			points[i].censored = stats[i].censored;
+			ls->runningtimes[i] = points[i].y;
+			ls->censored[i] = points[i].censored;
+			ls->avgbbnodes[i] = stats[i].mean_bb;
+			ls->sd[i] = sample_sd(&stats[i]);
+			printf("size: %.0f\n", points[i].x);
+			if (ls->censored[i])
+				printf("Went over the time budget, so the average is only a lower bound\n");
+			printf("AVG: %0.4f(%0.4f)\n", ls->runningtimes[i], ls->avgbbnodes[i]);
+			printf("SD:  %0.4f\n", ls->sd[i]);
+			printf("68%% lies within:  (%7.4f, %7.4f)\n", ls->runningtimes[i] - ls->sd[i], ls->runningtimes[i] + ls->sd[i]);
+			printf("95%% lies within:  (%7.4f, %7.4f)\n", ls->runningtimes[i] - 2*(ls->sd[i]), ls->runningtimes[i] + 2*(ls->sd[i]));
+			printf("\n");
+
+			if ((stats[i].n > entry[i].nruns) && !stats[i].censored && !stats[i].outofmemory && !stats[i].failed)
+			{
+				entry[i].hash = hash;
+				entry[i].order = i + 1;
+				entry[i].instancesize = ls->instancesize[i];
+				entry[i].nruns = stats[i].n;
+				entry[i].runningtime = stats[i].mean;
+				entry[i].sd = ls->sd[i];
+				entry[i].avgbbnodes = stats[i].mean_bb;
+				entry[i].sdbbnodes = sample_sd_bb(&stats[i]);
+				entry[i].censored = stats[i].censored;
+				ls_cache_store(&entry[i]);
+			}
+		}
+	}
+
+	if (filenames != NULL)
+	{
+		for (i = 0; i < NUM_ORDER_TEST; i++)
+			free(filenames[i]);
+		free(filenames);
+		delete_workspace(&ws);
+	}
 
-	/* We want to maximise 'func[0]' and minimise 'se'. */
-	/* TODO: Incorporate all the ls->numbbnodes[i] into the fitness function. */
-	ls->f = (func[0]*func[0])/(se+1);
 	ls->computed_f = 1;
 
+	double func[5], se;
+	ls->f = points_fitness(points, size, func, &se);
+
 	printf("UB y =  %0.3f + %0.3f((x - %0.3f)/%0.3f)^(%0.6f)\n", func[2], func[4], func[1], func[3], func[0]);
 	printf("SE: %f\n", se);
 	printf("fitness: %f\n", ls->f);
@@ -852,7 +1254,7 @@ void savetofile(lsystem *ls, char *filename, char *lsname, char *comments)
 	/* Store (in a commented line) the times taken for each plot size tested. */
 	fprintf(outfile_stream, ";\n; Running Times:\n;");
 	for (i = 0; i < NUM_ORDER_TEST; i++)
-		fprintf(outfile_stream, " %f", ls->runningtimes[i]);
+		fprintf(outfile_stream, ls->censored[i] ? " >=%f" : " %f", ls->runningtimes[i]);
 	fprintf(outfile_stream, "\n");
 
 	/* Store (in a commented line) the upper bound on the running times. */
@@ -862,6 +1264,7 @@ void savetofile(lsystem *ls, char *filename, char *lsname, char *comments)
 	{
 		points[i].x = ls->instancesize[i];
 		points[i].y = ls->runningtimes[i];
+		points[i].censored = ls->censored[i];
 	}
 	double func[5];
 	find_upper_bound(func, points, NUM_ORDER_TEST);
@@ -944,111 +1347,187 @@ void savetofile(lsystem *ls, char *filename, char *lsname, char *comments)
 }
 
 
-#define LINE_LENGTH 160
-
 /**
- *	\brief Returns the number of L-Systems in the given file.
+ *	\brief Adds a rule to an L-System which is being read, making the arrays of
+ *	rules bigger if needed.
  *
- *	\param fp A file pointer to an L-System file.
- *	\return   The number of L-Systems in the file.
+ *	\param ls   The L-System.
+ *	\param max  The number of rules there is room for (updated if the arrays
+ *	            are made bigger).
+ *	\param name The name of the rule.
+ *	\param s    The rule.
+ *	\return \c 0 if the rule was added, \c -1 if there isn't enough memory (the
+ *	        L-System is left as it was).
  */
-int numLSystemsInFile(FILE *fp)
+static int add_read_rule(lsystem *ls, int *max, char name, char *s)
 {
-	int count = 0;
-	char line[LINE_LENGTH], *temp, *delims = " \t\n";
+	ruleobj **rule;
+	char *startvar;
+	int *rulelength;
 
-	rewind(fp);
-	while (fgets(line, LINE_LENGTH, fp) != NULL)
+	if (ls->numrules == *max)
 	{
-		if (line[0] != ';') /* Ignore comments. */
-		{
-			/* See if we've reached the end. */
-			if (strchr(line, '}')) count++;
-		}
+		/* (Each array is kept in the L-System as soon as it has been made
+		   bigger, so none is lost if a later one can't be.) */
+		rule = (ruleobj **)realloc(ls->rule, sizeof(ruleobj *) * *max * 2);
+		if (rule == NULL)
+			return -1;
+		ls->rule = rule;
+		startvar = (char *)realloc(ls->startvar, sizeof(char) * *max * 2);
+		if (startvar == NULL)
+			return -1;
+		ls->startvar = startvar;
+		rulelength = (int *)realloc(ls->rulelength, sizeof(int) * *max * 2);
+		if (rulelength == NULL)
+			return -1;
+		ls->rulelength = rulelength;
+		*max *= 2;
 	}
-	rewind(fp);
-	return count;
+	ls->rule[ls->numrules] = string2rule(s, &ls->rulelength[ls->numrules]);
+	ls->startvar[ls->numrules - 1] = name;
+	ls->numrules++;
+	return 0;
 }
 
 
 /**
- *	\brief Reads the L-System located immediately after the position in the
- *	file pointed to by the given file pointer.
+ *	\brief Converts a string to upper case (\c strupr() isn't standard C).
  *
- *	\param fp A file pointer to an L-System file pointing at an L-System.
- *	\param ls The lsystem object in which to store the L-System information.
+ *	\param s The string to convert.
  */
-void readLSystem(FILE *fp, lsystem *ls)
+static void upper(char *s)
 {
-	int rulecount = 0, m, n, i=1;
-	char line[LINE_LENGTH], *temp, *delims = " :;=\t\n", rule[LINE_LENGTH], c;
+	for (; *s; s++)
+		*s = toupper((unsigned char)*s);
+}
 
-	fpos_t file_loc;
-	fgetpos(fp, &file_loc);
 
-	while (fgets(line, LINE_LENGTH, fp) != NULL)
+int readLSystem(FILE *fp, lsystem *ls)
+{
+	int r, i, end = 0, ret = 0, max = 8;
+	char *delims = " :=\t";
+	ls_word word = { NULL, 0, 0 }, value = { NULL, 0, 0 };
+
+	/* The first rule is the axiom. */
+	ls->numrules = 1;
+	ls->rule = (ruleobj **)calloc(max, sizeof(ruleobj *));
+	ls->startvar = (char *)calloc(max, sizeof(char));
+	ls->rulelength = (int *)calloc(max, sizeof(int));
+	if ((ls->rule == NULL) || (ls->startvar == NULL) || (ls->rulelength == NULL))
+		ret = -1;
+
+	while (!ret && !end && ((r = ls_read_word(fp, delims, &word)) != EOF))
 	{
-		if (line[0] != ';') /* Ignore comments. */
+		if (r == 1)
 		{
-			/* See if this line has a rule. */
-			if (temp = strchr(line, '='))
-			{
-				rulecount++;
-			}
-			/* See if we've reached the end. */
-			if (strchr(line, '}')) break;
-		}
-	}
-	/* The extra rule is the axiom. */
-	ls->numrules = rulecount + 1;
-	ls->rule = (ruleobj **)malloc(sizeof(ruleobj *) * ls->numrules);
-	ls->startvar = (char *)malloc(sizeof(char) * (ls->numrules - 1));
-	ls->rulelength = (int *)malloc(sizeof(int) * ls->numrules);
+			upper(word.str);
 
-	fsetpos(fp, &file_loc);
-	while (fgets(line, LINE_LENGTH, fp) != NULL)
-	{
-		/* We Ignore comments by replacing the first ';' with NULL.
-		   This way the string terminates before the comments start. */
-		temp = strchr(line, ';');
-		if (temp != NULL) *temp = '\0';
-
-		strupr(line);
-		temp = strtok(line, delims);
-		if (temp != NULL)
-		{
-			if (!strcmp(temp, "ANGLE"))
-			{
-				temp = strtok(NULL, delims);
-				ls->angle = (int)strtol(temp, NULL, 10);
-			}
-			else if (!strcmp(temp, "AXIOM"))
-			{
-				temp = strtok(NULL, delims);
-				ls->rule[0] = string2rule(temp, &n);
-				ls->rulelength[0] = n;
-			}
-			else
+			/* See if we've reached the end. */
+			if (strchr(word.str, '}'))
+				end = 1;
+			else if (ls_read_word(fp, delims, &value) == 1)
 			{
-				/* We're analysing a rule. */
-				c = temp[0];
-				temp = strtok(NULL, delims);
-				if (temp != NULL)
+				upper(value.str);
+				if (!strcmp(word.str, "ANGLE"))
+				{
+					ls->angle = (int)strtol(value.str, NULL, 10);
+				}
+				else if (!strcmp(word.str, "AXIOM"))
+				{
+					free(ls->rule[0]);
+					ls->rule[0] = string2rule(value.str, &ls->rulelength[0]);
+				}
+				else if (word.len == 1)
 				{
-					ls->startvar[i-1] = c;
-					ls->rule[i] = string2rule(temp, &n);
-					ls->rulelength[i] = n;
-					i++;
+					/* We're analysing a rule. */
+					ret = add_read_rule(ls, &max, word.str[0], value.str);
 				}
+				else
+				{
+					printf("WARNING: Ignoring the line starting with '%s' (a rule name is a single letter)\n", word.str);
+				}
+				if (strchr(value.str, '}'))
+					end = 1;
 			}
 		}
-		/* See if we've reached the end. */
-		if (strchr(line, '}'))
-		{
-			ls->computed_f = 0;
-			return;
-		}
+		/* The L-System also ends if there is a '}' later on the line. */
+		if (!ret && ls_skip_line(fp))
+			end = 1;
 	}
+
+	free(word.str);
+	free(value.str);
+	if (ret)
+	{
+		/* Leave an empty L-System, which can still be deleted. */
+		if (ls->rule != NULL)
+			for (i = 0; i < ls->numrules; i++)
+				free(ls->rule[i]);
+		free(ls->rule);
+		free(ls->startvar);
+		free(ls->rulelength);
+		ls->rule = NULL;
+		ls->startvar = NULL;
+		ls->rulelength = NULL;
+		ls->numrules = 0;
+		return -1;
+	}
+	ls->computed_f = 0;
+	return 0;
+}
+
+
+/**
+ *	\brief Reads an L-System from its text (see ls_index_text()). The rules
+ *	start on the line after the one holding its name.
+ *
+ *	\return \c 0 if the L-System was read, \c -1 otherwise.
+ */
+static int parse_text(const char *text, long length, lsystem *ls)
+{
+	const char *p = (const char *)memchr(text, '\n', length);
+	FILE *fp;
+	int ret;
+
+	memset(ls, 0, sizeof(lsystem));
+	if ((p == NULL) || (++p == text + length))
+		return -1;
+	fp = fmemopen((void *)p, text + length - p, "r");
+	if (fp == NULL)
+		return -1;
+	ret = readLSystem(fp, ls);
+	fclose(fp);
+	return ret;
+}
+
+
+unsigned long long ls_text_hash(const char *text, long length)
+{
+	unsigned long long hash = 0;
+	lsystem *ls = (lsystem *)malloc(sizeof(lsystem));
+
+	if ((ls != NULL) && (parse_text(text, length, ls) == 0))
+	{
+		hash = ls_hash(ls);
+		delete_ls(ls);
+	}
+	else
+		free(ls);
+	return hash;
+}
+
+
+int readLSystemAt(const ls_index *idx, int i, lsystem *ls)
+{
+	long length;
+	char *text = ls_index_text(idx, i, &length);
+	int ret;
+
+	if (text == NULL)
+		return -1;
+	ret = parse_text(text, length, ls);
+	free(text);
+	return ret;
 }
 
 
@@ -1071,7 +1550,7 @@ void standardise_rules(lsystem **pop, int popsize)
 			rep[i] = 42;
 
 		num = 0;
-		for (i = 0; i < pop[p]->numrules; i++)
+		for (i = 0; i < pop[p]->numrules - 1; i++) /* The axiom has no name. */
 		{
 			if ((pop[p]->startvar[i] != 'D') && (pop[p]->startvar[i] != 'F') && (pop[p]->startvar[i] != 'G') && (pop[p]->startvar[i] != 'M'))
 			{
@@ -1124,52 +1603,36 @@ void standardise_rules(lsystem **pop, int popsize)
 }
 
 
-int readfile(FILE *fp, lsystem ***pop, char ***names)
+int readfile(const char *filename, lsystem ***pop, char ***names)
 {
-	int error, n, i;
-	char line[LINE_LENGTH], *temp, **_names;
+	int n, i;
+	char **_names;
+	ls_index idx;
 
-	if (!fp)
+	if (ls_index_open(&idx, filename, NULL))
 	{
-		printf("ERROR: Couldn't open file in function 'readfile(FILE *fp, lsystem ***pop, char ***names)\n");
+		printf("ERROR: Couldn't open file '%s' in function 'readfile(const char *filename, lsystem ***pop, char ***names)'\n", filename);
 		exit(1);
 	}
 
-	n = numLSystemsInFile(fp);
+	n = idx.count;
 	if (names != NULL) _names = (char **)malloc(sizeof(char *)*n);
 	*pop = (lsystem **)malloc(sizeof(lsystem *)*n);
 	for (i = 0; i < n; i++)
-		(*pop)[i] = (lsystem *)malloc(sizeof(lsystem));
-
-	i = 0;
-	while (fgets(line, LINE_LENGTH, fp) != NULL)
 	{
-
-		if (line[0] != ';') /* Ignore comments. */
+		(*pop)[i] = (lsystem *)malloc(sizeof(lsystem));
+		if (readLSystemAt(&idx, i, (*pop)[i]))
 		{
-			/* Search for newline character. */
-			temp = strchr(line,'\n');
-			/* Overwrite trailing newline.   */
-			if (temp != NULL)
-				*temp = '\0';
-			else
-				line[LINE_LENGTH - 1] = '\0';
-
-			/* We look for the L-System by finding a '{' */
-			temp = strchr(line, '{');
-			if (temp)
-			{
-				temp = strtok(line, " ");
-				if (names != NULL)
-				{
-					_names[i] = (char *)malloc(strlen(temp));
-					strcpy(_names[i], temp);
-				}
-				readLSystem(fp, (*pop)[i]);
-				i++;
-			}
+			printf("ERROR: Couldn't read L-System '%s' from file '%s'\n", ls_index_name(&idx, i), filename);
+			exit(1);
+		}
+		if (names != NULL)
+		{
+			_names[i] = (char *)malloc(strlen(ls_index_name(&idx, i)) + 1);
+			strcpy(_names[i], ls_index_name(&idx, i));
 		}
 	}
+	ls_index_close(&idx);
 
 	standardise_rules(*pop, n);
 
@@ -11,6 +11,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "ls_word.h"
+#include "ls_index.h"
+#include "../util/launch.h"
+
 
 /**
  *	\brief The number of orders of the L-System we will create and test.
@@ -99,6 +103,13 @@ typedef struct
 	 */
 	double runningtimes[NUM_ORDER_TEST];
 
+	/**
+	 *	\brief True (1) for the instances which CONCORDE couldn't solve within its
+	 *	time budget (see set_run_budget()). The running time of these instances
+	 *	is only a lower bound.
+	 */
+	int censored[NUM_ORDER_TEST];
+
 	/**
 	 *	\brief The standard deviation of the set of running times.
 	 */
@@ -124,6 +135,59 @@ typedef struct
  */
 void initialise_prng(unsigned long seed);
 
+/**
+ *	\brief Sets how many times \e Concorde is run on each instance when computing
+ *	the \e fitness of an L-System.
+ *
+ *	\e Concorde is run at least \c min_runs times. After that, it is run again
+ *	(up to \c max_runs times in total) until the half-width of the 95% confidence
+ *	interval of the average running time is at most \c rel_ci times the average.
+ *	By default, \e Concorde is run exactly three times.
+ *
+ *	\param min_runs The minimum number of runs (values less than 1 are ignored).
+ *	\param max_runs The maximum number of runs (values less than 1 are ignored).
+ *	\param rel_ci   The precision wanted, or 0 to always make \c min_runs runs.
+ */
+void set_sampling(int min_runs, int max_runs, double rel_ci);
+
+/**
+ *	\brief Stops running \e Concorde on the instances of an L-System (before the
+ *	precision given to set_sampling() is reached) once it is clear the
+ *	\e fitness of the L-System will be less than \c cutoff, even if the average
+ *	running times turn out to be anywhere in their confidence intervals.
+ *
+ *	\param cutoff The cutoff, or a negative number if there is no cutoff.
+ */
+void set_fitness_cutoff(double cutoff);
+
+/**
+ *	\brief Sets how long (and with how much memory) each run of \e Concorde is
+ *	allowed to take. A run which goes over its time budget is killed, and is
+ *	recorded as taking \e at \e least as long as it ran for (see
+ *	lsystem::censored). A run which goes over its memory budget fails, and is
+ *	treated like any other run which fails.
+ *
+ *	By default, there are no limits.
+ *
+ *	\param wall   The wall clock time limit (in seconds), or 0 for no limit.
+ *	\param cpu    The CPU time limit (in seconds), or 0 for no limit.
+ *	\param memory The memory limit (in megabytes), or 0 for no limit.
+ */
+void set_run_budget(double wall, int cpu, long memory);
+
+/**
+ *	\brief Makes createTSPFiles() write the instances in \e Concorde's binary
+ *	format (see util/tsplib.h) instead of as TSPlib files, and runningtime()
+ *	run \e Concorde in binary mode (its \c -b option, which needs the
+ *	modified concorde.c). Then \e Concorde doesn't parse the text of a TSPlib
+ *	file on every run.
+ *
+ *	By default, TSPlib files are written.
+ *
+ *	\param binary True (1) to write binary files, 0 to write TSPlib files.
+ */
+void set_binary_instances(int binary);
+
 /**
  *	\brief Creates a new lsystem structure with \c size rules.
  *
@@ -149,6 +213,24 @@ void delete_ls(lsystem *ls);
  */
 void print_ls(const lsystem *ls);
 
+/**
+ *	\brief Computes the number of points (cities) in each order of the
+ *	L-System from its rules, without creating the points.
+ *
+ *	Each rule gives the number of times each symbol appears in what it is
+ *	replaced by (the part of the rule before a \c ] without a matching \c [,
+ *	which ends the rule), and the number of points of each symbol is found one
+ *	order at a time from these counts. This takes microseconds, so individuals
+ *	can be rejected before their instances are created.
+ *
+ *	\param ls       An lsystem.
+ *	\param maxorder The largest order.
+ *	\param sizes    An array of size \c maxorder. The number of points of order
+ *	                \e k is returned in <c>sizes[k-1]</c> (a double, since it can
+ *	                be too large to fit in an \c int).
+ */
+void instance_sizes(const lsystem *ls, int maxorder, double *sizes);
+
 /**
  *	\brief Runs \e Concorde on the instance (stored in a file) and returns the
  *	time taken and the number of branch-and-bound nodes needed to solve it.
@@ -158,8 +240,26 @@ void print_ls(const lsystem *ls);
  *	                  this parameter.
  *	\param numbbnodes The number of branch-and-bound nodes needed by concorde
  *	                  is stored in the int pointed to by this parameter.
+ *	\return \c 1 if \e Concorde was killed because it went over its time budget
+ *	        (see set_run_budget()), in which case \c runtime is how long it ran
+ *	        for, \c 0 otherwise.
+ */
+int runningtime(char *filename, double *runtime, int *numbbnodes);
+
+/**
+ *	\brief Runs \e Concorde once on an instance file, the way fitness() does:
+ *	with the random seed 0, the budget given to set_run_budget() and (if
+ *	set_binary_instances() was called) the \c -b option. The program exits if
+ *	\e Concorde can't be run.
+ *
+ *	Everything which runs \e Concorde and adds the results to the cache (see
+ *	ls_cache.h) should use this, so that the results in the cache were all
+ *	measured the same way.
+ *
+ *	\param filename The instance file.
+ *	\param run      The results of the run are returned in this parameter.
  */
-void runningtime(char *filename, double *runtime, int *numbbnodes);
+void run_concorde(char *filename, concorde_run *run);
 
 /**
  *  \brief Computes the \e fitness of the specified L-System.
@@ -227,17 +327,65 @@ void crossover_ls(const lsystem *p1, const lsystem *p2, lsystem *c1, lsystem *c2
  */
 void savetofile(lsystem *ls, char *filename, char *lsname, char *comments);
 
+/**
+ *	\brief Reads the L-System located immediately after the position in the
+ *	file pointed to by the given file pointer (i.e. the lines after the one
+ *	holding its name, up to the line holding its '}').
+ *
+ *	The file is read once, word by word (see ls_read_word()), and the rules
+ *	are added to the L-System as they are read, so the lines and rules can be
+ *	of any length and the file doesn't need to be seekable. A line which
+ *	doesn't give the angle, the axiom or a rule with a one letter name is
+ *	ignored (with a warning).
+ *
+ *	\param fp A file pointer to an L-System file pointing at an L-System.
+ *	\param ls The lsystem object in which to store the L-System information.
+ *	\return \c 0 if the L-System was read, \c -1 if there wasn't enough
+ *	        memory (\c ls is then left with no rules, and can still be
+ *	        deleted with delete_ls()).
+ */
+int readLSystem(FILE *fp, lsystem *ls);
+
+/**
+ *	\brief Reads the L-System at the specified position in a file of L-Systems
+ *	(see ls/ls_index.h and readLSystem()).
+ *
+ *	\param idx The index of the file.
+ *	\param i   The position of the L-System.
+ *	\param ls  The lsystem object in which to store the L-System.
+ *	\return \c 0 if the L-System was read, \c -1 otherwise.
+ */
+int readLSystemAt(const ls_index *idx, int i, lsystem *ls);
+
+/**
+ *	\brief Returns the canonical hash (see ls_hash()) of an L-System from its
+ *	text in a file of L-Systems (see ls_index_text()). This is the function
+ *	given to ls_index_open() when the hashes of the L-Systems are needed.
+ *
+ *	\param text   The text of the L-System (from the line holding its name to
+ *	               the line holding its \c '}').
+ *	\param length The length of the text.
+ *	\return The hash, or \c 0 if the L-System couldn't be read.
+ */
+unsigned long long ls_text_hash(const char *text, long length);
+
 /**
  *	Reads all the L-Systems from the specified file, creates an array of lsystem
  *	objects and saves the L-Systems in the array which is returned via a parameter.
  *
- *	\param fp     A function pointer to the file containing L-Systems.
- *	\param pop    A pointer to an array of lsystem* structures. The created L-Systems
- *	              are returned via this parameter.
- *	\param names  A pointer to an array of char*. The names of the corresponding
- *	              L-Systems are returned via this parameter.
+ *	The L-Systems are found using the index of the file (see ls/ls_index.h), so
+ *	the file is only read once (and not at all, except for the L-Systems
+ *	themselves, if its index is up to date). The program exits if the file
+ *	can't be read.
+ *
+ *	\param filename The file containing L-Systems.
+ *	\param pop      A pointer to an array of lsystem* structures. The created L-Systems
+ *	                are returned via this parameter.
+ *	\param names    A pointer to an array of char*. The names of the corresponding
+ *	                L-Systems are returned via this parameter.
+ *	\return The number of L-Systems read.
  */
-int readfile(FILE *fp, lsystem ***pop, char ***names);
+int readfile(const char *filename, lsystem ***pop, char ***names);
 
 char *rule2string(ruleobj *rule, int rulelength);
 
@@ -0,0 +1,278 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the file ls_cache.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ls_cache.h"
+
+
+/* The constants used by the (64-bit) FNV-1a hash function. */
+#define FNV_OFFSET  14695981039346656037ULL
+#define FNV_PRIME   1099511628211ULL
+
+#define NUM_BUCKETS 4096    /* The size of the hash table which stores the cache in memory. */
+#define LINE_LENGTH 256     /* The maximum length of a line in the cache file.              */
+
+
+/**
+ *	\brief An entry in one of the (linked) lists of the hash table.
+ */
+typedef struct cache_node
+{
+	ls_cache_entry entry;
+	struct cache_node *next;
+} cache_node;
+
+
+/**
+ *	\brief The hash table which stores the cache in memory.
+ */
+static cache_node *buckets[NUM_BUCKETS];
+
+/**
+ *	\brief The cache file (or \c NULL if the results are only kept in memory).
+ */
+static char *cache_filename = NULL;
+
+/**
+ *	\brief The descriptor used to append results to the cache file.
+ */
+static int cache_fd = -1;
+
+/**
+ *	\brief How much of the cache file has been read so far.
+ */
+static long cache_offset = 0;
+
+
+/**
+ *	\brief Adds the next byte to the hash.
+ */
+static unsigned long long hash_byte(unsigned long long hash, unsigned char c)
+{
+	return (hash ^ c)*FNV_PRIME;
+}
+
+/**
+ *	\brief Adds the bytes of an int to the hash.
+ */
+static unsigned long long hash_int(unsigned long long hash, int n)
+{
+	int i;
+	for (i = 0; i < 4; i++)
+		hash = hash_byte(hash, (unsigned char)(n >> (8*i)));
+	return hash;
+}
+
+
+unsigned long long ls_hash(const lsystem *ls)
+{
+	unsigned long long hash = FNV_OFFSET;
+	int i, j, k, ref;
+	char c;
+
+	hash = hash_int(hash, ls->angle);
+	hash = hash_int(hash, ls->numrules);
+
+	for (i = 0; i < ls->numrules; i++)
+	{
+		/* A rule named after one of the drawing commands also changes how that
+		   command is drawn, so those names are kept. Every other name is replaced
+		   by the position of the first rule with that name (so rules sharing a
+		   name, which all expand it, don't hash like rules with different
+		   names). */
+		if (i > 0)
+		{
+			c = toupper(ls->startvar[i-1]);
+			if ((c == 'D') || (c == 'F') || (c == 'G') || (c == 'M'))
+				hash = hash_byte(hash, c);
+			else
+			{
+				for (k = 1; toupper(ls->startvar[k-1]) != c; k++);
+				hash = hash_byte(hash, 0);
+				hash = hash_int(hash, k);
+			}
+		}
+
+		for (j = 0; j < ls->rulelength[i]; j++)
+		{
+			const ruleobj *obj = &ls->rule[i][j];
+
+			hash = hash_byte(hash, obj->type);
+			if (obj->type == RULE)
+			{
+				/* Refer to the rule by its position (0 if there is no such rule). */
+				ref = 0;
+				for (k = 1; k < ls->numrules; k++)
+				{
+					if (toupper(ls->startvar[k-1]) == toupper(obj->str[0]))
+					{
+						ref = k;
+						break;
+					}
+				}
+				hash = hash_int(hash, ref);
+			}
+			else
+			{
+				for (k = 0; (k < obj->len) && (k < (int)sizeof(obj->str)) && obj->str[k]; k++)
+					hash = hash_byte(hash, toupper(obj->str[k]));
+			}
+		}
+
+		/* Mark the end of the rule. */
+		hash = hash_byte(hash, 0xFF);
+	}
+
+	return hash;
+}
+
+
+/**
+ *	\brief Adds the results to the hash table. If the table already has results
+ *	for the same instance, the ones with the most runs are kept.
+ */
+static void insert_entry(const ls_cache_entry *entry)
+{
+	cache_node **bucket = &buckets[(entry->hash ^ (entry->order*FNV_PRIME)) % NUM_BUCKETS];
+	cache_node *node;
+
+	for (node = *bucket; node != NULL; node = node->next)
+	{
+		if ((node->entry.hash == entry->hash) && (node->entry.order == entry->order))
+		{
+			if (entry->nruns >= node->entry.nruns)
+				node->entry = *entry;
+			return;
+		}
+	}
+
+	/* (Without the memory, the results just aren't found in this process.) */
+	node = (cache_node *)malloc(sizeof(cache_node));
+	if (node == NULL)
+		return;
+	node->entry = *entry;
+	node->next = *bucket;
+	*bucket = node;
+}
+
+
+/**
+ *	\brief Finds the results in the hash table.
+ */
+static int find_entry(unsigned long long hash, int order, ls_cache_entry *entry)
+{
+	cache_node *node = buckets[(hash ^ (order*FNV_PRIME)) % NUM_BUCKETS];
+
+	for (; node != NULL; node = node->next)
+	{
+		if ((node->entry.hash == hash) && (node->entry.order == order))
+		{
+			*entry = node->entry;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ *	\brief Reads the results which have been added to the cache file since it
+ *	was last read.
+ */
+static void read_new_entries(void)
+{
+	FILE *fp;
+	char line[LINE_LENGTH];
+	ls_cache_entry entry;
+
+	if (cache_filename == NULL)
+		return;
+
+	fp = fopen(cache_filename, "r");
+	if (fp == NULL)
+		return;
+
+	fseek(fp, cache_offset, SEEK_SET);
+	while (fgets(line, LINE_LENGTH, fp) != NULL)
+	{
+		/* Another program may still be writing the last line. */
+		if (strchr(line, '\n') == NULL)
+			break;
+		cache_offset = ftell(fp);
+
+		if (line[0] == '#')
+			continue;
+		entry.censored = 0;
+		if ((sscanf(line, "%llx %d %d %d %lf %lf %lf %lf %d", &entry.hash, &entry.order,
+		            &entry.instancesize, &entry.nruns, &entry.runningtime, &entry.sd,
+		            &entry.avgbbnodes, &entry.sdbbnodes, &entry.censored) >= 8) &&
+		    !entry.censored)
+		{
+			insert_entry(&entry);
+		}
+	}
+	fclose(fp);
+}
+
+
+int ls_cache_open(const char *filename)
+{
+	if (filename == NULL)
+		filename = LS_CACHE_FILE;
+
+	if (cache_fd != -1)
+		close(cache_fd);
+	free(cache_filename);
+	cache_offset = 0;
+
+	cache_fd = open(filename, O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (cache_fd == -1)
+	{
+		fprintf(stderr, "ERROR: Couldn't open the cache file '%s'\n", filename);
+		cache_filename = NULL;
+		return -1;
+	}
+	cache_filename = strdup(filename);
+
+	read_new_entries();
+	return 0;
+}
+
+
+int ls_cache_lookup(unsigned long long hash, int order, ls_cache_entry *entry)
+{
+	if (find_entry(hash, order, entry))
+		return 1;
+
+	/* Maybe another program has computed it. */
+	read_new_entries();
+	return find_entry(hash, order, entry);
+}
+
+
+void ls_cache_store(const ls_cache_entry *entry)
+{
+	char line[LINE_LENGTH];
+	int len;
+
+	insert_entry(entry);
+
+	if (cache_fd == -1)
+		return;
+
+	/* The whole line is written at once, so that the lines written by different
+	   programs at the same time don't get mixed up. */
+	len = snprintf(line, LINE_LENGTH, "%016llx %d %d %d %f %f %f %f %d\n", entry->hash,
+	               entry->order, entry->instancesize, entry->nruns, entry->runningtime,
+	               entry->sd, entry->avgbbnodes, entry->sdbbnodes, entry->censored);
+	if ((len >= LINE_LENGTH) || (write(cache_fd, line, len) != len))
+		fprintf(stderr, "ERROR: Couldn't add to the cache file '%s'\n", cache_filename);
+}
@@ -0,0 +1,133 @@
+/**
+ *	\file
+ *	\brief A cache of the running times (and number of branch and bound nodes)
+ *	\e Concorde needs to solve the instances created by an L-System.
+ *
+ *	Each result is stored against a \e canonical hash of the L-System (see
+ *	ls_hash()) and the order of the instance. L-Systems which only differ by the
+ *	names of their rules (e.g. those created by crossover_ls() or by mutating a
+ *	child back into one of its parents) therefore share the same results, so
+ *	\e Concorde doesn't need to be run on them again.
+ *
+ *	The cache is kept in memory and (once ls_cache_open() has been called) in a
+ *	file which results are only ever appended to. Any number of programs (e.g.
+ *	\c evoalg, \c agent and \c analysels, or the worker processes of one of
+ *	them) can use the same file at the same time. Results other programs add to
+ *	the file are read the next time a lookup can't be found in memory.
+ *
+ *	Each line of the file has the form
+ *	<c>&lt;hash&gt; &lt;order&gt; &lt;instance size&gt; &lt;number of runs&gt;
+ *	&lt;avg. run time&gt; &lt;sd&gt; &lt;avg. bb nodes&gt; &lt;sd&gt;
+ *	&lt;censored&gt;</c>. The last field may be missing (in files written before
+ *	it was added), in which case it is taken to be 0. Lines starting with a '#'
+ *	are ignored.
+ */
+
+#ifndef LS_CACHE_H
+#define LS_CACHE_H
+
+#include "ls.h"
+
+
+/**
+ *	\brief The file used to store the cache if no other file is specified.
+ */
+#define LS_CACHE_FILE "fitness.cache"
+
+
+/**
+ *	\brief The results of running \e Concorde a number of times on the instance
+ *	of one order of an L-System.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The canonical hash of the L-System (see ls_hash()).
+	 */
+	unsigned long long hash;
+
+	/**
+	 *	\brief The order of the instance.
+	 */
+	int order;
+
+	/**
+	 *	\brief The number of cities in the instance.
+	 */
+	int instancesize;
+
+	/**
+	 *	\brief The number of times \e Concorde was run on the instance. This is 0
+	 *	if only the size of the instance is known (e.g. because it was too large
+	 *	to solve).
+	 */
+	int nruns;
+
+	/**
+	 *	\brief The average running time and its standard deviation.
+	 */
+	double runningtime, sd;
+
+	/**
+	 *	\brief The average number of branch and bound nodes and its standard
+	 *	deviation.
+	 */
+	double avgbbnodes, sdbbnodes;
+
+	/**
+	 *	\brief True (1) if a run went over its budget, in which case the average
+	 *	running time is only a lower bound. Such results aren't stored (the
+	 *	bound depends on the budget), and are ignored if an older cache file
+	 *	has them.
+	 */
+	int censored;
+} ls_cache_entry;
+
+
+/**
+ *	\brief Computes a hash of the specified L-System which doesn't depend on
+ *	the names given to its rules.
+ *
+ *	The hash covers the angle and every rule. Each reference to a rule is
+ *	replaced by the position of that rule (which is the same idea used by
+ *	standardise_rules()), and so is the name of each rule (except the drawing
+ *	commands), so renaming the rules doesn't change the hash. Rules with the
+ *	same name are given the position of the first of them.
+ *
+ *	\param ls An L-System.
+ *	\return The hash of the L-System.
+ */
+unsigned long long ls_hash(const lsystem *ls);
+
+/**
+ *	\brief Makes the cache use (and add results to) the specified file. The
+ *	file is created if it doesn't exist, and any results already in it are read.
+ *
+ *	If this is never called, the results are only kept in memory.
+ *
+ *	\param filename The cache file, or \c NULL to use #LS_CACHE_FILE.
+ *	\return \c 0 if the file could be opened, \c -1 otherwise (in which case
+ *	        the results are only kept in memory).
+ */
+int ls_cache_open(const char *filename);
+
+/**
+ *	\brief Finds the results for the instance of the given order of an
+ *	L-System. If there is more than one, the one with the most runs is returned.
+ *
+ *	\param hash  The canonical hash of the L-System.
+ *	\param order The order of the instance.
+ *	\param entry The results are returned in this parameter.
+ *	\return \c 1 if the results were found, \c 0 otherwise.
+ */
+int ls_cache_lookup(unsigned long long hash, int order, ls_cache_entry *entry);
+
+/**
+ *	\brief Adds the specified results to the cache (and to the end of the cache
+ *	file).
+ *
+ *	\param entry The results to add.
+ */
+void ls_cache_store(const ls_cache_entry *entry);
+
+#endif
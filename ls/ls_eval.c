@@ -0,0 +1,112 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the file ls_eval.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ls_eval.h"
+#include "../util/workers.h"
+
+
+/**
+ *	\brief The information a worker process sends back to the parent once it
+ *	has computed the fitness of an L-System.
+ */
+typedef struct
+{
+	int    instancesize[NUM_ORDER_TEST];
+	double runningtimes[NUM_ORDER_TEST];
+	int    censored[NUM_ORDER_TEST];
+	double sd[NUM_ORDER_TEST];
+	double avgbbnodes[NUM_ORDER_TEST];
+	double f;
+} eval_result;
+
+
+/**
+ *	\brief The L-Systems being evaluated.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The array of L-Systems.
+	 */
+	lsystem **array;
+
+	/**
+	 *	\brief The position (in the array) of the L-System of each job.
+	 */
+	int *todo;
+} eval_jobs;
+
+
+/**
+ *	\brief Computes the fitness of the L-System of a job (see run_workers()).
+ */
+static void eval_job(void *data, int job, void *result)
+{
+	eval_jobs *jobs = (eval_jobs *)data;
+	lsystem *ls = jobs->array[jobs->todo[job]];
+	eval_result *res = (eval_result *)result;
+
+	res->f = fitness(ls);
+	memcpy(res->instancesize, ls->instancesize, sizeof(res->instancesize));
+	memcpy(res->runningtimes, ls->runningtimes, sizeof(res->runningtimes));
+	memcpy(res->censored,     ls->censored,     sizeof(res->censored));
+	memcpy(res->sd,           ls->sd,           sizeof(res->sd));
+	memcpy(res->avgbbnodes,   ls->avgbbnodes,   sizeof(res->avgbbnodes));
+}
+
+
+/**
+ *	\brief Copies the result of a job into its L-System.
+ */
+static void eval_done(void *data, int job, const void *result)
+{
+	eval_jobs *jobs = (eval_jobs *)data;
+	lsystem *ls = jobs->array[jobs->todo[job]];
+	const eval_result *res = (const eval_result *)result;
+
+	if (res != NULL)
+	{
+		memcpy(ls->instancesize, res->instancesize, sizeof(res->instancesize));
+		memcpy(ls->runningtimes, res->runningtimes, sizeof(res->runningtimes));
+		memcpy(ls->censored,     res->censored,     sizeof(res->censored));
+		memcpy(ls->sd,           res->sd,           sizeof(res->sd));
+		memcpy(ls->avgbbnodes,   res->avgbbnodes,   sizeof(res->avgbbnodes));
+		ls->f = res->f;
+	}
+	else
+	{
+		fprintf(stderr, "ERROR: The worker evaluating L-System #%d failed\n", jobs->todo[job] + 1);
+		ls->f = 0;
+	}
+	ls->computed_f = 1;
+}
+
+
+void evaluate_ls_array(lsystem **array, int size, int numworkers)
+{
+	eval_jobs jobs;
+	int i, numjobs = 0;
+
+	jobs.array = array;
+	jobs.todo = (int *)malloc(sizeof(int)*(size ? size : 1));
+	if ((numworkers < 2) || (jobs.todo == NULL))
+	{
+		for (i = 0; i < size; i++)
+			fitness(array[i]);
+		free(jobs.todo);
+		return;
+	}
+
+	for (i = 0; i < size; i++)
+		if (!array[i]->computed_f)
+			jobs.todo[numjobs++] = i;
+
+	run_workers(numjobs, numworkers, sizeof(eval_result), eval_job, eval_done, &jobs);
+	free(jobs.todo);
+}
@@ -0,0 +1,37 @@
+/**
+ *	\file
+ *	\brief Evaluates the \e fitness of a collection of lsystem structures
+ *	concurrently, using a pool of worker processes.
+ */
+
+#ifndef LS_EVAL_H
+#define LS_EVAL_H
+
+#include "ls.h"
+
+
+/**
+ *	\brief Computes the \e fitness of every lsystem structure in the given array
+ *	which has not been computed yet (i.e. <c>computed_f == 0</c>).
+ *
+ *	Up to \c numworkers L-Systems are evaluated at the same time. Each one is
+ *	evaluated by calling fitness() in a separate (forked) process and the results
+ *	are copied back into the corresponding lsystem structure. Since the time taken
+ *	to compute the fitness is almost entirely spent waiting for \e Concorde, this
+ *	reduces the time taken for each generation by (roughly) a factor of
+ *	\c numworkers.
+ *
+ *	If \c numworkers is less than two, the L-Systems are evaluated one after the
+ *	other in this process.
+ *
+ *	If a worker process fails, the fitness of its L-System is set to 0. Every
+ *	worker process is waited for before this function returns. Other child
+ *	processes of the caller are left alone.
+ *
+ *	\param array      An array of lsystem structures.
+ *	\param size       The size of the array \c array.
+ *	\param numworkers The maximum number of L-Systems to evaluate at the same time.
+ */
+void evaluate_ls_array(lsystem **array, int size, int numworkers);
+
+#endif
@@ -0,0 +1,502 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the file ls_index.h.
+ *
+ *	An index is stored as a header, the hash table of the names (\c numslots
+ *	slots, each holding the position of an L-System plus 1, or 0 if it is
+ *	empty), a record for each L-System and then the names of the L-Systems
+ *	(each followed by a \c '\\0'). Everything before the names is stored as
+ *	4 byte unsigned integers, so the layout is the same in 32 and 64-bit
+ *	programs.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ls_index.h"
+
+
+#define INDEX_MAGIC   0x5844494C    /* "LIDX" (when read as a little-endian integer). */
+#define INDEX_VERSION 3
+
+
+/**
+ *	\brief The start of an index.
+ */
+typedef struct
+{
+	unsigned int magic, version;
+
+	/**
+	 *	\brief The number of L-Systems and the size of the hash table (a power
+	 *	of 2).
+	 */
+	unsigned int count, numslots;
+
+	/**
+	 *	\brief The size of the file of L-Systems and its modification time
+	 *	when the index was built.
+	 */
+	unsigned int size_lo, size_hi;
+	unsigned int mtime_lo, mtime_hi, mtime_nsec;
+
+	/**
+	 *	\brief The size of the names (in bytes).
+	 */
+	unsigned int names_size;
+
+	/**
+	 *	\brief True (1) if the hashes of the L-Systems were found.
+	 */
+	unsigned int hashed;
+} index_header;
+
+
+/**
+ *	\brief Where an L-System is in the file, its canonical hash and its name
+ *	(an offset into the names).
+ */
+typedef struct
+{
+	unsigned int offset_lo, offset_hi, length;
+	unsigned int hash_lo, hash_hi;
+	unsigned int name, namelen;
+} index_record;
+
+
+#define HEADER(idx)  ((const index_header *)(idx)->data)
+#define SLOTS(idx)   ((const unsigned int *)((idx)->data + sizeof(index_header)))
+#define RECORDS(idx) ((const index_record *)(SLOTS(idx) + HEADER(idx)->numslots))
+#define NAMES(idx)   ((const char *)(RECORDS(idx) + HEADER(idx)->count))
+
+
+/**
+ *	\brief Returns the (32-bit FNV-1a) hash of a name.
+ */
+static unsigned int name_hash(const char *name, size_t len)
+{
+	unsigned int hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char)name[i])*16777619U;
+	return hash;
+}
+
+
+/**
+ *	\brief Returns the end of the line \c p is in (its \c '\\n', or \c end).
+ */
+static const char *line_end(const char *p, const char *end)
+{
+	const char *q = (const char *)memchr(p, '\n', end - p);
+	return q ? q : end;
+}
+
+
+/**
+ *	\brief Finds where the L-System whose \c '{' is at \c p ends: after the
+ *	first line (after the \c '{') holding a \c '}' which isn't in a comment,
+ *	as readLSystem() does.
+ */
+static const char *entry_end(const char *p, const char *end)
+{
+	const char *le, *q;
+
+	for (p = line_end(p, end) + 1; p < end; p = le + 1)
+	{
+		le = line_end(p, end);
+		for (q = p; (q < le) && (*q != ';'); q++)
+			if (*q == '}')
+				return (le < end) ? le + 1 : end;
+	}
+	return end;
+}
+
+
+/**
+ *	\brief Writes \c len bytes to a file. Returns \c 0, or \c -1 if they
+ *	couldn't be written.
+ */
+static int write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	for (; len > 0; buf += n, len -= n)
+	{
+		n = write(fd, buf, len);
+		if (n == -1)
+		{
+			if (errno != EINTR)
+				return -1;
+			n = 0;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ *	\brief Reads the whole file of L-Systems into memory. Returns the contents
+ *	(followed by a \c '\\0'), or \c NULL if the file couldn't be read.
+ */
+static char *read_source(int fd, size_t size)
+{
+	char *text = (char *)malloc(size + 1);
+	size_t done = 0;
+	ssize_t n;
+
+	while ((text != NULL) && (done < size))
+	{
+		n = pread(fd, text + done, size - done, done);
+		if ((n == -1) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+		{
+			free(text);
+			return NULL;
+		}
+		done += n;
+	}
+	if (text != NULL)
+		text[size] = '\0';
+	return text;
+}
+
+
+/**
+ *	\brief Stores an index in a file. The index is written to a temporary file
+ *	which is then renamed, so a program opening the index at the same time
+ *	never sees half of it.
+ */
+static void store_index(const char *data, size_t size, const char *idxname)
+{
+	char *tmpname = (char *)malloc(strlen(idxname) + 16);
+	int fd, error;
+
+	if (tmpname == NULL)
+		return;
+	sprintf(tmpname, "%s.%d", idxname, (int)getpid());
+	fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd != -1)
+	{
+		error = write_all(fd, data, size);
+		if (close(fd) == -1)
+			error = -1;
+		if (error || (rename(tmpname, idxname) == -1))
+			unlink(tmpname);
+	}
+	free(tmpname);
+}
+
+
+/**
+ *	\brief Builds the index of a file of L-Systems (and stores it, see
+ *	store_index()).
+ *
+ *	\param idx     The index (whose file is open). The index is built in memory
+ *	               allocated with \c malloc().
+ *	\param st      The status of the file.
+ *	\param idxname The file to store the index in.
+ *	\param hasher  The function which finds the hash of each L-System (or
+ *	               \c NULL).
+ *	\return \c 0 if the index was built, \c -1 otherwise.
+ */
+static int build_index(ls_index *idx, const struct stat *st, const char *idxname, ls_text_hasher hasher)
+{
+	const char *p, *end, *le, *brace, *comment, *n0, *n1;
+	index_record *records = NULL, *r;
+	index_header *header;
+	unsigned int *slots, numslots, s;
+	char *text, *names = NULL, *data, *tmp;
+	size_t names_size = 0, names_max = 0, size;
+	unsigned long long hash;
+	int count = 0, max = 0, i;
+
+	if ((text = read_source(idx->fd, st->st_size)) == NULL)
+		return -1;
+
+	/* Find where each L-System starts and ends. */
+	end = text + st->st_size;
+	for (p = text; p < end; p = le + 1)
+	{
+		le = line_end(p, end);
+		comment = (const char *)memchr(p, ';', le - p);
+		brace = (const char *)memchr(p, '{', (comment ? comment : le) - p);
+		if (brace == NULL)
+			continue;
+
+		for (n0 = p; (n0 < brace) && isspace((unsigned char)*n0); n0++);
+		for (n1 = n0; (n1 < brace) && !isspace((unsigned char)*n1); n1++);
+		le = entry_end(brace, end) - 1;
+		if (n0 == n1)
+			continue; /* (It has no name, so it can't be asked for.) */
+
+		if (count == max)
+		{
+			max = max ? max*2 : 64;
+			r = (index_record *)realloc(records, max*sizeof(index_record));
+			if (r == NULL)
+				goto fail;
+			records = r;
+		}
+		while (names_size + (n1 - n0) + 1 > names_max)
+		{
+			names_max = names_max ? names_max*2 : 1024;
+			tmp = (char *)realloc(names, names_max);
+			if (tmp == NULL)
+				goto fail;
+			names = tmp;
+		}
+
+		r = &records[count++];
+		r->offset_lo = (unsigned int)(p - text);
+		r->offset_hi = (unsigned int)((unsigned long long)(p - text) >> 32);
+		r->length = (unsigned int)(le + 1 - p);
+		r->name = names_size;
+		r->namelen = n1 - n0;
+		memcpy(names + names_size, n0, n1 - n0);
+		names_size += (n1 - n0);
+		names[names_size++] = '\0';
+
+		hash = hasher ? hasher(p, r->length) : 0;
+		r->hash_lo = (unsigned int)hash;
+		r->hash_hi = (unsigned int)(hash >> 32);
+	}
+
+	/* The hash table is kept at most half full. */
+	for (numslots = 2; numslots < 2*(unsigned int)count; numslots *= 2);
+
+	size = sizeof(index_header) + numslots*sizeof(unsigned int) + count*sizeof(index_record) + names_size;
+	data = (char *)calloc(size, 1);
+	if (data == NULL)
+		goto fail;
+
+	header = (index_header *)data;
+	header->magic = INDEX_MAGIC;
+	header->version = INDEX_VERSION;
+	header->count = count;
+	header->numslots = numslots;
+	header->size_lo = (unsigned int)st->st_size;
+	header->size_hi = (unsigned int)((unsigned long long)st->st_size >> 32);
+	header->mtime_lo = (unsigned int)st->st_mtim.tv_sec;
+	header->mtime_hi = (unsigned int)((unsigned long long)st->st_mtim.tv_sec >> 32);
+	header->mtime_nsec = (unsigned int)st->st_mtim.tv_nsec;
+	header->names_size = names_size;
+	header->hashed = (hasher != NULL);
+
+	/* The first of the L-Systems with the same name is the one found. */
+	slots = (unsigned int *)(data + sizeof(index_header));
+	for (i = 0; i < count; i++)
+	{
+		s = name_hash(names + records[i].name, records[i].namelen) & (numslots - 1);
+		while (slots[s] != 0)
+		{
+			r = &records[slots[s] - 1];
+			if ((r->namelen == records[i].namelen) && !memcmp(names + r->name, names + records[i].name, r->namelen))
+				break;
+			s = (s + 1) & (numslots - 1);
+		}
+		if (slots[s] == 0)
+			slots[s] = i + 1;
+	}
+	memcpy(slots + numslots, records, count*sizeof(index_record));
+	if (names_size > 0)
+		memcpy((char *)(slots + numslots) + count*sizeof(index_record), names, names_size);
+
+	free(text);
+	free(records);
+	free(names);
+
+	store_index(data, size, idxname);
+	idx->data = data;
+	idx->size = size;
+	idx->mapped = 0;
+	return 0;
+
+fail:
+	free(text);
+	free(records);
+	free(names);
+	return -1;
+}
+
+
+/**
+ *	\brief Returns true (1) if an index is complete and was built from the
+ *	current version of the file of L-Systems (and holds the hashes, if they
+ *	are needed).
+ */
+static int index_valid(const char *data, size_t size, const struct stat *st, int needhashes)
+{
+	const index_header *header = (const index_header *)data;
+
+	if ((size < sizeof(index_header)) || (header->magic != INDEX_MAGIC) || (header->version != INDEX_VERSION))
+		return 0;
+	if ((header->numslots == 0) || (header->numslots & (header->numslots - 1)))
+		return 0;
+	if (size != sizeof(index_header) + (size_t)header->numslots*sizeof(unsigned int)
+	           + (size_t)header->count*sizeof(index_record) + header->names_size)
+		return 0;
+	if (needhashes && !header->hashed)
+		return 0;
+
+	return (header->size_lo == (unsigned int)st->st_size)
+	    && (header->size_hi == (unsigned int)((unsigned long long)st->st_size >> 32))
+	    && (header->mtime_lo == (unsigned int)st->st_mtim.tv_sec)
+	    && (header->mtime_hi == (unsigned int)((unsigned long long)st->st_mtim.tv_sec >> 32))
+	    && (header->mtime_nsec == (unsigned int)st->st_mtim.tv_nsec);
+}
+
+
+int ls_index_open(ls_index *idx, const char *filename, ls_text_hasher hasher)
+{
+	struct stat st, ist;
+	char *idxname, *data;
+	int ifd;
+
+	idx->data = NULL;
+	idx->size = 0;
+	idx->mapped = 0;
+	idx->count = 0;
+
+	idx->fd = open(filename, O_RDONLY);
+	if (idx->fd == -1)
+		return -1;
+	idxname = (char *)malloc(strlen(filename) + sizeof(LS_INDEX_SUFFIX));
+	if ((idxname == NULL) || (fstat(idx->fd, &st) == -1))
+	{
+		free(idxname);
+		ls_index_close(idx);
+		return -1;
+	}
+	sprintf(idxname, "%s%s", filename, LS_INDEX_SUFFIX);
+
+	/* Use the stored index if it is up to date. */
+	ifd = open(idxname, O_RDONLY);
+	if (ifd != -1)
+	{
+		if ((fstat(ifd, &ist) == 0) && (ist.st_size >= (off_t)sizeof(index_header)))
+		{
+			data = (char *)mmap(NULL, ist.st_size, PROT_READ, MAP_SHARED, ifd, 0);
+			if (data != MAP_FAILED)
+			{
+				if (index_valid(data, ist.st_size, &st, hasher != NULL))
+				{
+					idx->data = data;
+					idx->size = ist.st_size;
+					idx->mapped = 1;
+				}
+				else
+					munmap(data, ist.st_size);
+			}
+		}
+		close(ifd);
+	}
+
+	if ((idx->data == NULL) && (build_index(idx, &st, idxname, hasher) == -1))
+	{
+		free(idxname);
+		ls_index_close(idx);
+		return -1;
+	}
+	free(idxname);
+
+	idx->count = HEADER(idx)->count;
+	return 0;
+}
+
+
+void ls_index_close(ls_index *idx)
+{
+	if (idx->data != NULL)
+	{
+		if (idx->mapped)
+			munmap(idx->data, idx->size);
+		else
+			free(idx->data);
+	}
+	if (idx->fd != -1)
+		close(idx->fd);
+	idx->data = NULL;
+	idx->fd = -1;
+	idx->count = 0;
+}
+
+
+int ls_index_find(const ls_index *idx, const char *name)
+{
+	const index_header *header = HEADER(idx);
+	const unsigned int *slots = SLOTS(idx);
+	const index_record *r;
+	size_t len = strlen(name);
+	unsigned int s, n;
+
+	s = name_hash(name, len) & (header->numslots - 1);
+	for (n = 0; (n < header->numslots) && (slots[s] != 0); n++)
+	{
+		if (slots[s] <= header->count)
+		{
+			r = &RECORDS(idx)[slots[s] - 1];
+			if ((r->namelen == len) && ((size_t)r->name + len < header->names_size) && !memcmp(NAMES(idx) + r->name, name, len))
+				return slots[s] - 1;
+		}
+		s = (s + 1) & (header->numslots - 1);
+	}
+	return -1;
+}
+
+
+const char *ls_index_name(const ls_index *idx, int i)
+{
+	const index_record *r = &RECORDS(idx)[i];
+
+	if ((size_t)r->name + r->namelen >= HEADER(idx)->names_size)
+		return "";
+	return NAMES(idx) + r->name;
+}
+
+
+unsigned long long ls_index_hash(const ls_index *idx, int i)
+{
+	const index_record *r = &RECORDS(idx)[i];
+
+	return ((unsigned long long)r->hash_hi << 32) | r->hash_lo;
+}
+
+
+char *ls_index_text(const ls_index *idx, int i, long *length)
+{
+	const index_record *r = &RECORDS(idx)[i];
+	off_t offset = (off_t)(((unsigned long long)r->offset_hi << 32) | r->offset_lo);
+	char *text = (char *)malloc((size_t)r->length + 1);
+	size_t done = 0;
+	ssize_t n;
+
+	while ((text != NULL) && (done < r->length))
+	{
+		n = pread(idx->fd, text + done, r->length - done, offset + done);
+		if ((n == -1) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+		{
+			free(text);
+			return NULL;
+		}
+		done += n;
+	}
+	if (text != NULL)
+	{
+		text[r->length] = '\0';
+		*length = r->length;
+	}
+	return text;
+}
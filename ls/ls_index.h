@@ -0,0 +1,142 @@
+/**
+ *	\file
+ *	\brief An index of a file of L-Systems, so any L-System in the file can be
+ *	found (by its name) and read without reading the rest of the file.
+ *
+ *	The index is stored next to the file (in <c>&lt;file&gt;.idx</c>). It is
+ *	built the first time the file is opened, and again whenever the size or
+ *	the modification time of the file has changed since it was built. If it
+ *	can't be stored (e.g. the directory can't be written to), it is built in
+ *	memory each time the file is opened instead.
+ *
+ *	The index holds a hash table of the names of the L-Systems and, for each
+ *	L-System, where it is in the file (from the start of the line holding its
+ *	name to the end of the line holding its \c '}'), its name and its
+ *	canonical hash (see ls_hash()). The index is mapped into memory rather than
+ *	read, so opening it and finding an L-System take the same time however
+ *	many L-Systems the file holds.
+ *
+ *	The index only finds and reads the text of the L-Systems, so it can be used
+ *	without the rest of the L-System code (e.g. by lsys.c). The hashes are
+ *	found by a function given when the index is opened (see ls_text_hash() in
+ *	ls.h); an index built without one holds no hashes, and is built again the
+ *	next time it is opened with one.
+ *
+ *	An L-System starts on a line of the form <c>&lt;name&gt; {</c>, and its
+ *	name is the first word on that line. Anything after a \c ';' is a comment.
+ */
+
+#ifndef LS_INDEX_H
+#define LS_INDEX_H
+
+#include <stddef.h>
+
+
+/**
+ *	\brief The suffix added to the name of a file of L-Systems to get the name
+ *	of its index.
+ */
+#define LS_INDEX_SUFFIX ".idx"
+
+
+/**
+ *	\brief A function which returns the canonical hash of an L-System from its
+ *	text (see ls_index_text()), or 0 if it can't be read.
+ */
+typedef unsigned long long (*ls_text_hasher)(const char *text, long length);
+
+
+/**
+ *	\brief An open file of L-Systems and its index.
+ *
+ *	The fields are only used by the methods in ls_index.c.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The file of L-Systems.
+	 */
+	int fd;
+
+	/**
+	 *	\brief The index (mapped into memory, or in memory allocated with
+	 *	\c malloc() if \c mapped is 0) and its size.
+	 */
+	char *data;
+	size_t size;
+	int mapped;
+
+	/**
+	 *	\brief The number of L-Systems in the file.
+	 */
+	int count;
+} ls_index;
+
+
+/**
+ *	\brief Opens a file of L-Systems and its index (which is built first if
+ *	it is missing or out of date).
+ *
+ *	\param idx      The index structure to initialise.
+ *	\param filename The file of L-Systems.
+ *	\param hasher   The function which finds the hash of each L-System, or
+ *	                 \c NULL if the hashes aren't needed (see ls_index_hash()).
+ *	\return \c 0 if the file was opened, \c -1 otherwise.
+ *	\see ls_index_close(ls_index *idx)
+ */
+int ls_index_open(ls_index *idx, const char *filename, ls_text_hasher hasher);
+
+/**
+ *	\brief Closes a file of L-Systems and its index.
+ *
+ *	\param idx The index (opened by ls_index_open()).
+ */
+void ls_index_close(ls_index *idx);
+
+/**
+ *	\brief Finds the L-System with the specified name.
+ *
+ *	\param idx  The index.
+ *	\param name The name of the L-System.
+ *	\return The position of the L-System in the file (the first L-System is
+ *	        at position 0), or \c -1 if there is no L-System with that name.
+ *	        If more than one L-System has the name, the first is found.
+ */
+int ls_index_find(const ls_index *idx, const char *name);
+
+/**
+ *	\brief Returns the name of the L-System at the specified position.
+ *
+ *	\param idx The index.
+ *	\param i   The position of the L-System (from 0 to <c>idx->count - 1</c>).
+ *	\return The name (which stays valid until the index is closed).
+ */
+const char *ls_index_name(const ls_index *idx, int i);
+
+/**
+ *	\brief Returns the canonical hash (see ls_hash()) of the L-System at the
+ *	specified position, without reading it.
+ *
+ *	\param idx The index.
+ *	\param i   The position of the L-System.
+ *	\return The hash, or \c 0 if the index was opened without a hash function
+ *	        and holds no hashes.
+ */
+unsigned long long ls_index_hash(const ls_index *idx, int i);
+
+/**
+ *	\brief Reads the text of the L-System at the specified position from the
+ *	file (from the start of the line holding its name to the end of the line
+ *	holding its \c '}').
+ *
+ *	You \e must free the text when finished with it.
+ *
+ *	\param idx    The index.
+ *	\param i      The position of the L-System.
+ *	\param length The length of the text is returned in this parameter.
+ *	\return The text (followed by a \c '\\0'), or \c NULL if it couldn't be
+ *	        read.
+ */
+char *ls_index_text(const ls_index *idx, int i, long *length);
+
+#endif
@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include "ls_pop.h"
+#include "ls_eval.h"
 #include "../sortalg/mergesort_ls.h"
 #include "../mt19937ar/t_mt19937ar.h"
 
@@ -70,6 +71,7 @@ void createPopulation(ls_population **pop, const int numparents, const int num_r
 
 	temp_pop->numrules = num_rules + 1;
 	temp_pop->ls_array = temp_ls;
+	temp_pop->num_workers = 1;
 
 	*pop = temp_pop;
 }
@@ -110,8 +112,20 @@ int compare(lsystem **ls1, lsystem **ls2)
 }
 
 
+void evaluatepopulation(ls_population *pop)
+{
+	/* Children which can't do better than the worst parent won't survive, so
+	   their fitness doesn't need to be computed precisely. */
+	lsystem *worst = pop->ls_array[pop->num_parents - 1];
+	set_fitness_cutoff(worst->computed_f ? worst->f : -1);
+
+	evaluate_ls_array(pop->ls_array, pop->pop_size, pop->num_workers);
+}
+
+
 void sortpopulation(ls_population *pop)
 {
+	evaluatepopulation(pop);
 	mergesort_ls(pop->ls_array, pop->pop_size, &compare);
 }
 
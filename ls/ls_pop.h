@@ -46,6 +46,12 @@ typedef struct
 	 */
 	lsystem **ls_array;
 
+	/**
+	 *	\brief The number of L-Systems whose fitness can be computed at the same
+	 *	time (see evaluatepopulation()).
+	 */
+	int num_workers;
+
 } ls_population;
 
 
@@ -89,8 +95,25 @@ void createPopulation(ls_population **pop, const int numparents, const int num_r
  */
 void deletePopulation(ls_population *pop);
 
+/**
+ *	\brief Computes the fitness of every L-System in the population whose
+ *	fitness hasn't already been computed.
+ *
+ *	Up to <c>pop->num_workers</c> L-Systems are evaluated at the same time.
+ *	The fitness of the worst parent is used as the cutoff (see
+ *	set_fitness_cutoff()), so less time is spent on children which won't survive.
+ *
+ *	\param pop The ls population to evaluate.
+ *	\see evaluate_ls_array(lsystem **array, int size, int numworkers)
+ */
+void evaluatepopulation(ls_population *pop);
+
 /**
  *	\brief Sorts the specified population from best individual to worst.
+ *
+ *	The population is evaluated (see evaluatepopulation()) before it is sorted,
+ *	so the sort itself only compares fitness values that are already known.
+ *
  *	\param pop The population, whose array is to be sorted.
  */
 void sortpopulation(ls_population *pop);
@@ -0,0 +1,61 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the file ls_word.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ls_word.h"
+
+
+int ls_read_word(FILE *fp, const char *delims, ls_word *word)
+{
+	int ch;
+	char *str;
+
+	word->len = 0;
+	while (((ch = getc(fp)) != EOF) && (ch != '\n') && (ch != ';') && strchr(delims, ch));
+	if ((ch == '\n') || (ch == ';'))
+	{
+		ungetc(ch, fp);
+		return 0;
+	}
+	if (ch == EOF)
+		return EOF;
+
+	do
+	{
+		/* Make room for this character and the '\0'. */
+		if (word->len + 2 > word->size)
+		{
+			str = (char *)realloc(word->str, word->size ? word->size*2 : 64);
+			if (str == NULL)
+				return EOF;
+			word->str = str;
+			word->size = word->size ? word->size*2 : 64;
+		}
+		word->str[word->len++] = ch;
+	} while (((ch = getc(fp)) != EOF) && (ch != '\n') && (ch != ';') && !strchr(delims, ch));
+
+	if ((ch == '\n') || (ch == ';'))
+		ungetc(ch, fp);
+	word->str[word->len] = '\0';
+	return 1;
+}
+
+
+int ls_skip_line(FILE *fp)
+{
+	int ch, brace = 0, comment = 0;
+
+	while (((ch = getc(fp)) != EOF) && (ch != '\n'))
+	{
+		if (ch == ';')
+			comment = 1;
+		else if ((ch == '}') && !comment)
+			brace = 1;
+	}
+	return brace;
+}
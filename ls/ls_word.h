@@ -0,0 +1,65 @@
+/**
+ *	\file
+ *	\brief Reads the words of an L-System file one at a time, so the lines
+ *	(and rules) of the file can be of any length.
+ *
+ *	This is used by readLSystem() (see ls.h) and by lsys.c, which doesn't need
+ *	the rest of ls.c to read an L-System file.
+ */
+
+#ifndef LS_WORD_H
+#define LS_WORD_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/**
+ *	\brief A word read from an L-System file by ls_read_word(). The buffer
+ *	grows to fit the longest word read, so there is no limit on the length of
+ *	a word (or of a line).
+ *
+ *	Initialise every field to 0 before the first word is read, and free \c str
+ *	when finished with it.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The word (followed by a \c '\\0').
+	 */
+	char *str;
+
+	/**
+	 *	\brief The length of the word and the size of the buffer.
+	 */
+	size_t len, size;
+} ls_word;
+
+/**
+ *	\brief Reads the next word on the current line of an L-System file.
+ *
+ *	Any of the characters in \c delims before the word are skipped, and the
+ *	word ends at the next one (which is also skipped, as \c strtok() does), at
+ *	the end of the line or at a \c ';' (the rest of the line is a comment).
+ *	The end of the line is never skipped (see ls_skip_line()).
+ *
+ *	\param fp     The file to read.
+ *	\param delims The characters which separate words.
+ *	\param word   The word is returned in this parameter.
+ *	\return \c 1 if a word was read, \c 0 if there are no more words on the
+ *	        line, or \c EOF at the end of the file (or if there isn't enough
+ *	        memory for the word).
+ */
+int ls_read_word(FILE *fp, const char *delims, ls_word *word);
+
+/**
+ *	\brief Skips the rest of the current line of an L-System file (including
+ *	its \c '\\n').
+ *
+ *	\param fp The file to read.
+ *	\return True (1) if a \c '}' was skipped (other than in a comment), so
+ *	        the L-System ends on this line.
+ */
+int ls_skip_line(FILE *fp);
+
+#endif
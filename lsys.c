@@ -20,12 +20,92 @@
           according to the epsilon and a random angle.
         - Included code so that the Mersenne Twister pseudorandom number generator is used to
           create the random angles.
+
+    October 16, 2026
+      - The points can be created directly from an lsystem structure (see ls/ls.h).
+        - Implemented method 'LsystemPoints' which loads the rules from the lsystem
+          structure (instead of a file) and returns the points in an array (instead of
+          writing them to a file).
+        - Created 'pointbuf' to store the points while they are being created.
+        - The code shared by 'Lsystem' and 'LsystemPoints' was moved into 'generate'.
+      - Created lsys.h which declares the methods other files can use.
+      - Many orders of an L-System can be created at the same time.
+        - Implemented methods 'LsystemOrders' and 'LsystemPointsOrders' which expand the
+          rules once (to the largest order) instead of once for each order.
+        - Implemented method 'drawLSysOrders' which draws each command for every order
+          it belongs to. Each order has its own 'lsys_turtle'.
+        - The scaling code in 'findscale' was moved into 'setscale'.
+      - The rules are compiled into a stream of one byte opcodes (see 'compile_rule')
+        instead of an array of 'struct lsys_cmd' (one function pointer per command).
+        - The rules a command is replaced by are found when the rule is compiled,
+          instead of searching every rule for every command.
+        - A run of '+' and '-' commands becomes a single turn.
+        - Commands which do nothing (and have no rules) are left out.
+        - 'drawLSys' and 'drawLSysOrders' run the opcodes with a switch statement
+          instead of making an indirect call for each command.
+        - The lsys_do* methods were moved into 'lsys_exec', which does what an
+          opcode tells the turtle to do.
+      - The rules are expanded without recursion (see 'expandLSys' and
+        'expandLSysOrders'), using a stack of 'lsys_frame's on the heap.
+        - An L-System which is nested too deeply (more than LSYS_MAXFRAMES frames)
+          is reported, and Lsystem() etc. return -1, instead of overflowing the stack.
+        - The state of an expansion is kept in an 'lsys_expansion', so an expansion
+          can be stopped after a number of opcodes and continued later.
+      - The rules are only expanded once (instead of once in 'findscale' to find the
+        bounds of the points and again to draw them).
+        - 'add_point' stores the unscaled position of each point in 'rawbuf' while
+          the bounds are being found.
+        - 'place_points' then scales and rounds the points (and writes them to the
+          output file), using the scale found by 'setscale'.
+        - 'findscale', 'draw_line' and the OP_SIZE* opcodes were removed.
+      - Added LsystemExtents(), which finds the number of points and the bounds of
+        an order without expanding the rules (see 'macro_extents').
+        - The net move of each rule ('lsys_macro') is found for each depth, angle
+          and value of 'reverse', from the moves of the rules one depth lower.
+        - 'expand_orders' and 'free_turtles' were split out of 'generate_orders'.
+      - All the global variables were moved into 'struct lsys_ctx', which every
+        method is given, so L-Systems can be created in different threads at the
+        same time (each with its own context).
+        - Implemented methods 'create_lsys_ctx' and 'delete_lsys_ctx'.
+        - 'init_angles' fills in the sin/cos tables (instead of four copies of the loop).
+        - The unused variables 'dmaxangle' and 'counter' were removed.
+      - The rules named by each symbol are found in a table made when the rules are
+        loaded (see 'index_rules'), instead of searching every rule for every command
+        when the rules are compiled.
+      - 'D' and 'M' only find the cosine and sine of 'realangle' when it has changed
+        (see 'cachedangle'), instead of at every step.
+      - The points are sent to an 'lsys_sink' (see lsys.h) instead of being written to
+        'outputfile' or returned in an array by 'place_points'.
+        - Implemented methods 'LsystemSink' and 'LsystemPointsSink', and sinks which
+          return the points in an array or write a TSPlib file or a binary file.
+        - The 'outputfile' variable was removed ('Lsystem' writes to a file through a sink).
+      - Implemented method 'LsystemStream', which writes the points straight into a
+        memory mapped file while the rules are expanded (see 'lsys_stream'), so large
+        orders can be created without keeping the points in memory.
+      - The L-Systems in a file are found using the index of the file (see
+        ls/ls_index.h), which is stored next to it, instead of searching the file.
+        - 'readLSystemFile' looks the name up in the index and reads just that
+          L-System (see 'readLSystemIndex').
+        - The code that reads the rules was moved from 'readLSystemFile' into
+          'readLSystemStream', which reads them from any FILE.
+        - Implemented method 'LsystemIndexSink', which creates the L-System at a
+          position in the index.
+      - The lines of an L-System are read a word at a time (see ls_read_word() in
+        ls/ls.h), so lines and rules can be any length (they were limited to 160
+        characters).
 */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 #ifdef __TURBOC__
 #include <alloc.h>
 #define nint floor
@@ -33,6 +113,10 @@
 #include <malloc.h>
 #endif
 
+#include "lsys.h"
+#include "ls/ls_word.h"
+#include "util/tsplib.h"
+
 #define PI 3.14159265358979323846
 #define nint floor
 
@@ -40,13 +124,103 @@
 #define xdots 1000
 #define ydots 1000
 
-/* The points will be sent to a file (instead of stdout). */
-FILE *outputfile;
+#define MAXRULES 27 /* this limits rules to 25 */
 
-/* For each node being created, their label will also be assigned,
-   This way a valid TSP file can be created.
-   i.e. <currentnode> <x-coord> <y-coord>                        */
-static int currentnode;
+/* A point before it is scaled. */
+typedef struct {
+  double x, y;
+} lsys_rawpoint;
+
+/* When more than one order of the L-System is created at the same time (see
+   generate_orders()), each order has its own turtle. The turtle of the order
+   currently being drawn is kept in the context (see use_turtle()).         */
+struct lsys_turtle {
+  double xpos, ypos, size, realangle;
+  char angle, reverse;
+  double Xmin, Xmax, Ymin, Ymax;
+  lsys_rawpoint *rawbuf;
+  int rawbuf_size, currentnode;
+};
+
+/* A file the points are written straight into while the rules are expanded
+   (see LsystemStream()), instead of being kept until the bounds are known.
+   The file is made as large as it could need to be and is mapped into
+   memory one window at a time. Once the window is full it is unmapped, its
+   pages are written out and the windows before it are dropped from the page
+   cache, so only about one window of the file is in memory at a time.     */
+#define LSYS_STREAM_WINDOW (16L*1024*1024)
+
+struct lsys_stream {
+  int fd, binary;
+  int counting;              /* Set while the points are only being counted
+                                (to find the bounds).                       */
+  int failed, negative;
+  double x0, y0, scale;      /* How to place the points (see place_points()). */
+  off_t size;                /* The size of the file.                       */
+  off_t offset;              /* Where the window starts in the file.        */
+  off_t flushed;             /* Where the pages still in the cache start.   */
+  char *window;
+  size_t length, used;       /* The size of the window and how much of it
+                                has been written.                           */
+};
+
+/* Everything used to create the points of an L-System is kept in a context
+   (instead of global variables), so L-Systems can be created in different
+   threads at the same time as long as each thread has its own context.     */
+struct lsys_ctx {
+  /* The turtle which is drawing (the fields of an 'lsys_turtle').          */
+  double xpos, ypos, size, realangle;
+  char angle, reverse;
+  double Xmin, Xmax, Ymin, Ymax;
+
+  /* The direction of 'realangle' (used by 'D' and 'M') when it was last
+     found, so cos() and sin() are only called when the turtle has been
+     turned by '/' or '\' (or a different turtle is drawing).             */
+  double cosangle, sinangle, cachedangle;
+
+  /* The points are stored in this array (before they are scaled) while the
+     rules are expanded. 'rawbuf_size' is the number of points the array can
+     hold.                                                                 */
+  lsys_rawpoint *rawbuf;
+  int rawbuf_size;
+
+  /* For each node being created, their label will also be assigned,
+     This way a valid TSP file can be created.
+     i.e. <currentnode> <x-coord> <y-coord>                        */
+  int currentnode;
+
+  /* Set when there isn't enough memory. */
+  char stackoflow;
+
+  /* Set once the points have been found to contain negative numbers (so
+     the warning is only given once).                                      */
+  int lessthanzero;
+
+  /* The number of directions the turtle can face (with 'F' and 'G'), and
+     the sine and cosine of each.                                          */
+  char maxangle;
+  double sins[50];
+  double coss[50];
+
+  /* The rules (the axiom is 'ruleptrs[0]') and the compiled rules. */
+  char  *ruleptrs[MAXRULES];
+  unsigned char  *progs[MAXRULES];
+
+  /* The rules named by each symbol, made by index_rules() when the rules
+     are loaded: 'firstrule[ch]' is the index of the first rule named 'ch'
+     and 'nextrule[i]' is the next rule with the same name as rule i (0
+     when there are no more).                                              */
+  unsigned char firstrule[256];
+  unsigned char nextrule[MAXRULES];
+
+  /* 'turtles[k]' is the turtle used for order k ('turtles[0]' isn't used). */
+  struct lsys_turtle *turtles;
+  int curturtle;
+
+  /* The file the points are being written to (see LsystemStream()), or
+     NULL if the points are being stored in 'rawbuf'.                      */
+  struct lsys_stream *stream;
+};
 
 
 char *strlwr(char *s)
@@ -56,177 +230,304 @@ char *strlwr(char *s)
 }
 
 
-struct lsys_cmd {
-  char ch;
-  void (*f)(double n);
-  double n;
+/* The opcodes the rules are compiled into (see compile_rule()). Each opcode
+   is one byte, and some are followed by an operand. The opcodes from OP_TURN
+   on are done by lsys_exec().                                             */
+enum {
+  OP_END,     /* The end of the rule.                                      */
+  OP_POP,     /* ']'                                                       */
+  OP_PUSH,    /* '['                                                       */
+  OP_RULES,   /* Followed by the number of rules the command is replaced by
+                 and the index of each rule. The next opcode is what the
+                 command does when it isn't replaced.                      */
+  OP_NOP,     /* A command which does nothing (but has rules).             */
+  OP_TURN,    /* '+' and '-', followed by the number of steps to turn and
+                 the number of steps when 'reverse' is set (one byte each). */
+  OP_PIPE,    /* '|'                                                       */
+  OP_BANG,    /* '!'                                                       */
+  OP_SLASH,   /* '/',  followed by a double.                               */
+  OP_BSLASH,  /* '\\', followed by a double.                               */
+  OP_AT,      /* '@',  followed by a double.                               */
+  OP_DRAWD,   /* 'd'                                                       */
+  OP_DRAWM,   /* 'm'                                                       */
+  OP_DRAWG,   /* 'g'                                                       */
+  OP_DRAWF    /* 'f'                                                       */
 };
 
 
-void draw_line(double a,double b,double c,double d)
-{
-  static int lessthanzero=0;
-  /*printf("%d %d\n",(int)nint(c),(int)nint(d));*/
-  fprintf(outputfile, "%lu %d %d\n", currentnode, (int)nint(c),(int)nint(d));
-  currentnode++;
+static void stream_point(lsys_ctx *, double, double);
 
-  if (!lessthanzero && (nint(c)<0 || nint(d)<0)) {
-     fprintf(stderr,"Warning:  output contains negative numbers\n");
-     lessthanzero=1;
-  }
-}
-
-
-static double	   getnumber(char  **);
-static int	   findscale(struct lsys_cmd  *, struct lsys_cmd  **, int);
-static struct lsys_cmd  *  drawLSys(struct lsys_cmd  *, struct lsys_cmd  **, int);
-static int	   readLSystemFile(char *, char *);
-static void	   free_rules_mem(void);
-static int	   save_rule(char *,char  **);
-static struct lsys_cmd  *SizeTransform(char  *s);
-static struct lsys_cmd  *DrawTransform(char  *s);
-static void free_lcmds();
-static void stopmsg(char *);
-
-double sins[50];
-double coss[50];
-
-/* dmaxangle is maxangle - 1. */
-char maxangle,dmaxangle;
-double size;
-double realangle;
-double xpos,ypos;
-char counter,angle,reverse,stackoflow;
-double lsys_Xmin, lsys_Xmax, lsys_Ymin, lsys_Ymax;
-
-
-
-static void lsys_doplus(double n)
+/* Stores the (unscaled) position of the turtle as the next point. */
+static void add_point(lsys_ctx *c, double x, double y)
 {
-  if (reverse) {
-    if (++angle == maxangle)
-      angle = 0;
+  if (c->stream != NULL) {
+    if (!c->stream->counting)
+      stream_point(c, x, y);
+    c->currentnode++;
+    return;
   }
-  else {
-    if (angle)
-      angle--;
-    else
-      angle = dmaxangle;
+  if (c->currentnode == c->rawbuf_size) {
+    lsys_rawpoint *doub;
+    doub = (lsys_rawpoint *) realloc(c->rawbuf, (long) (c->rawbuf_size ? c->rawbuf_size*2 : 1024) * sizeof(lsys_rawpoint));
+    if (doub == NULL) {
+      c->stackoflow = 1;
+      return;
+    }
+    c->rawbuf = doub;
+    c->rawbuf_size = c->rawbuf_size ? c->rawbuf_size*2 : 1024;
   }
+  c->rawbuf[c->currentnode].x = x;
+  c->rawbuf[c->currentnode].y = y;
+  c->currentnode++;
 }
 
-
-static void lsys_dominus(double n)
+/* Scales the 'n' unscaled points in 'raw' (moving the turtle by one unit
+   moves it 'scale' units, and the turtle starts at '(x0,y0)') and rounds
+   them. The points are put straight into the array given by the sink, and
+   then the sink is told they are ready. Returns 0, or -1 if the sink
+   failed (e.g. there isn't enough memory or the points couldn't be
+   written).                                                              */
+static int place_points(lsys_ctx *c, const lsys_rawpoint *raw, int n, double x0, double y0, double scale, lsys_sink *sink)
 {
-  if (reverse) {
-    if (angle)
-      angle--;
-    else
-      angle = dmaxangle;
+  lsys_point *points;
+  int i, negative = 0;
+
+  points = sink->begin(sink, n);
+  if (points == NULL)
+    return -1;
+  for (i=0; i<n; i++) {
+    points[i].x = (int)nint(x0 + scale*raw[i].x);
+    points[i].y = (int)nint(y0 + scale*raw[i].y);
+    negative |= (points[i].x < 0) | (points[i].y < 0);
   }
-  else {
-    if (++angle == maxangle)
-      angle = 0;
+
+  if (!c->lessthanzero && negative) {
+     fprintf(stderr,"Warning:  output contains negative numbers\n");
+     c->lessthanzero=1;
   }
+  return sink->end(sink, points, n);
 }
 
 
-static void lsys_doslash(double n)
+/* The sinks the points can be sent to (see lsys.h). Every sink gives
+   place_points() an array to put the points in: the array sink gives the
+   array which is returned to the caller, and the other sinks give a
+   temporary array and write the points once they are all in it.          */
+
+static lsys_point *alloc_points(lsys_sink *sink, int numpoints)
 {
-  if (reverse)
-    realangle -= n;
-  else
-    realangle += n;
+  (void)sink;
+  return (lsys_point *) malloc((long) (numpoints ? numpoints : 1) * sizeof(lsys_point));
 }
 
-
-static void lsys_dobslash(double n)
+static lsys_point *array_begin(lsys_sink *sink, int numpoints)
 {
-  if (reverse)
-    realangle += n;
-  else
-    realangle -= n;
+  lsys_point *points = alloc_points(sink, numpoints);
+  *(lsys_point **) sink->data = points;
+  return points;
 }
 
-
-static void lsys_doat(double n)
+static int array_end(lsys_sink *sink, lsys_point *points, int numpoints)
 {
-  size *= n;
+  (void)sink; (void)points; (void)numpoints;
+  return 0;
 }
 
+/* Writes each point on a line of the form "<node ID> <x-coord> <y-coord>"
+   (this is what Lsystem() writes). The lines are formatted into one buffer
+   (see util/tsplib.h) and written in one go. */
+static int text_end(lsys_sink *sink, lsys_point *points, int numpoints)
+{
+  FILE *file = (FILE *) sink->data;
+  char *buf, *end;
+  int ret = -1;
+
+  buf = (char *) malloc((long) (numpoints ? numpoints : 1) * TSPLIB_MAX_LINE);
+  if (buf != NULL) {
+    end = tsplib_put_points(buf, points, numpoints);
+    if (fwrite(buf, 1, end - buf, file) == (size_t) (end - buf))
+      ret = 0;
+    free(buf);
+  }
+  free(points);
+  return ret;
+}
 
-static void lsys_dopipe(double n)
+static int tsplib_end(lsys_sink *sink, lsys_point *points, int numpoints)
 {
-  angle += maxangle / 2;
-  angle %= maxangle;
+  FILE *file = (FILE *) sink->data;
+  int ret = -1;
+
+  /* (Anything already in the FILE's buffer has to be written first.) */
+  if (fflush(file) == 0)
+    ret = write_tsplib_fd(fileno(file), sink->name, points, numpoints);
+  free(points);
+  return ret;
 }
 
+static int binary_end(lsys_sink *sink, lsys_point *points, int numpoints)
+{
+  FILE *file = (FILE *) sink->data;
+  int ret = -1;
 
-static void lsys_dobang(double n)
+  if (fflush(file) == 0)
+    ret = write_binary_fd(fileno(file), points, numpoints);
+  free(points);
+  return ret;
+}
+
+void lsys_array_sink(lsys_sink *sink, lsys_point **points)
 {
-  reverse = ! reverse;
+  sink->begin = array_begin;
+  sink->end = array_end;
+  sink->data = points;
+  sink->name = NULL;
 }
 
+static void text_sink(lsys_sink *sink, FILE *file)
+{
+  sink->begin = alloc_points;
+  sink->end = text_end;
+  sink->data = file;
+  sink->name = NULL;
+}
 
-static void lsys_dosizedm(double n)
+void lsys_tsplib_sink(lsys_sink *sink, FILE *file, const char *name)
 {
-  xpos+=size*cos(realangle*PI/180);
-  ypos+=size*sin(realangle*PI/180);
-  if (xpos>lsys_Xmax) lsys_Xmax=xpos;
-  if (ypos>lsys_Ymax) lsys_Ymax=ypos;
-  if (xpos<lsys_Xmin) lsys_Xmin=xpos;
-  if (ypos<lsys_Ymin) lsys_Ymin=ypos;
+  sink->begin = alloc_points;
+  sink->end = tsplib_end;
+  sink->data = file;
+  sink->name = name;
 }
 
-static void lsys_dosizegf(double n)
+void lsys_binary_sink(lsys_sink *sink, FILE *file)
 {
-  xpos+=size*coss[angle];
-  ypos+=size*sins[angle];
-  if (xpos>lsys_Xmax) lsys_Xmax=xpos;
-  if (ypos>lsys_Ymax) lsys_Ymax=ypos;
-  if (xpos<lsys_Xmin) lsys_Xmin=xpos;
-  if (ypos<lsys_Ymin) lsys_Ymin=ypos;
+  sink->begin = alloc_points;
+  sink->end = binary_end;
+  sink->data = file;
+  sink->name = NULL;
 }
 
 
-static void lsys_dodrawd(double n)
-{
-  double lastx=xpos;
-  double lasty=ypos;
+static double	   getnumber(char  **);
+static void	   setscale(lsys_ctx *, double, double, double, double);
+static int	   drawLSys(lsys_ctx *, int);
+static int	   readLSystemFile(lsys_ctx *, char *, char *);
+static int	   readLSystemStream(lsys_ctx *, FILE *);
+static int	   readLSystemIndex(lsys_ctx *, const ls_index *, int);
+static int	   readLSystem_ls(lsys_ctx *, const lsystem *);
+static void	   init_angles(lsys_ctx *);
+static void	   index_rules(lsys_ctx *);
+static int	   generate(lsys_ctx *, int, lsys_sink *);
+static int	   generate_orders(lsys_ctx *, int, lsys_point **, int *);
+static void	   free_rules_mem(lsys_ctx *);
+static int	   save_rule(lsys_ctx *, char *,char  **);
+static unsigned char  *compile_rule(lsys_ctx *, char  *);
+static void compile_rules(lsys_ctx *);
+static int expand_orders(lsys_ctx *, int);
+static void free_turtles(lsys_ctx *, int);
+static void free_progs(lsys_ctx *);
+static void stopmsg(char *);
 
-  xpos+=size*cos(realangle*PI/180);
-  ypos+=size*sin(realangle*PI/180);
-  draw_line(lastx,lasty,xpos,ypos);
-#ifdef STDERROUT
-fprintf(stderr,"%.18g %.18g\n",xpos,ypos);
-#endif
 
-}
 
-static void lsys_dodrawm(double n)
+
+/* Returns the opcode after the one at 'pc' (without doing anything). */
+static unsigned char  *lsys_skip(unsigned char  *pc)
 {
-  xpos+=size*cos(realangle*PI/180);
-  ypos+=size*sin(realangle*PI/180);
+  switch (*pc) {
+    case OP_RULES:  return pc + 2 + pc[1];
+    case OP_TURN:   return pc + 3;
+    case OP_SLASH:
+    case OP_BSLASH:
+    case OP_AT:     return pc + 1 + sizeof(double);
+    default:        return pc + 1;
+  }
 }
 
-static void lsys_dodrawg(double n)
+/* Does what the opcode at 'pc' tells the turtle to do, and returns the
+   opcode after it. */
+static unsigned char  *lsys_exec(lsys_ctx *c, unsigned char  *pc)
 {
-  xpos+=size*coss[angle];
-  ypos+=size*sins[angle];
-}
+  double n;
 
+  switch (*pc) {
+    case OP_TURN:
+      /* The number of steps is followed by the number of steps to turn when
+         'reverse' is set. */
+      c->angle += pc[c->reverse ? 2 : 1];
+      if (c->angle >= c->maxangle)
+        c->angle -= c->maxangle;
+      return pc + 3;
+
+    case OP_PIPE:
+      c->angle += c->maxangle / 2;
+      c->angle %= c->maxangle;
+      break;
 
-static void lsys_dodrawf(double n)
-{
-  double lastx=xpos;
-  double lasty=ypos;
+    case OP_BANG:
+      c->reverse = ! c->reverse;
+      break;
 
-  xpos+=size*coss[angle];
-  ypos+=size*sins[angle];
-  draw_line(lastx,lasty,xpos,ypos);
+    case OP_SLASH:
+      memcpy(&n, pc+1, sizeof(n));
+      if (c->reverse)
+        c->realangle -= n;
+      else
+        c->realangle += n;
+      return pc + 1 + sizeof(n);
+
+    case OP_BSLASH:
+      memcpy(&n, pc+1, sizeof(n));
+      if (c->reverse)
+        c->realangle += n;
+      else
+        c->realangle -= n;
+      return pc + 1 + sizeof(n);
+
+    case OP_AT:
+      memcpy(&n, pc+1, sizeof(n));
+      c->size *= n;
+      return pc + 1 + sizeof(n);
+
+    /* Every move keeps track of the bounds of the points (which are used to
+       scale them once they have all been created). */
+    case OP_DRAWD:
+    case OP_DRAWM:
+      if (c->realangle != c->cachedangle) {
+        c->cosangle = cos(c->realangle*PI/180);
+        c->sinangle = sin(c->realangle*PI/180);
+        c->cachedangle = c->realangle;
+      }
+      c->xpos+=c->size*c->cosangle;
+      c->ypos+=c->size*c->sinangle;
+      if (c->xpos>c->Xmax) c->Xmax=c->xpos;
+      if (c->ypos>c->Ymax) c->Ymax=c->ypos;
+      if (c->xpos<c->Xmin) c->Xmin=c->xpos;
+      if (c->ypos<c->Ymin) c->Ymin=c->ypos;
+      if (*pc == OP_DRAWD)
+        add_point(c,c->xpos,c->ypos);
 #ifdef STDERROUT
-fprintf(stderr,"%.18g %.18g\n",xpos,ypos);
+fprintf(stderr,"%.18g %.18g\n",c->xpos,c->ypos);
 #endif
+      break;
+
+    case OP_DRAWG:
+    case OP_DRAWF:
+      c->xpos+=c->size*c->coss[(int)c->angle];
+      c->ypos+=c->size*c->sins[(int)c->angle];
+      if (c->xpos>c->Xmax) c->Xmax=c->xpos;
+      if (c->ypos>c->Ymax) c->Ymax=c->ypos;
+      if (c->xpos<c->Xmin) c->Xmin=c->xpos;
+      if (c->ypos<c->Ymin) c->Ymin=c->ypos;
+      if (*pc == OP_DRAWF)
+        add_point(c,c->xpos,c->ypos);
+#ifdef STDERROUT
+fprintf(stderr,"%.18g %.18g\n",c->xpos,c->ypos);
+#endif
+      break;
+  }
+  return pc + 1;
 }
 
 
@@ -280,27 +581,21 @@ static double  getnumber(char  **str)
 }
 
 
-static int  findscale(struct lsys_cmd  *command, struct lsys_cmd  **rules, int depth)
+/* Puts the turtle at the origin (and makes it one unit long) and clears
+   the bounds of the points. */
+static void reset_turtle(lsys_ctx *c)
+{
+   c->xpos=c->ypos=c->Xmin=c->Xmax=c->Ymax=c->Ymin=c->angle=c->reverse=c->realangle=0;
+   c->size=1.0;
+}
+
+/* Sets the starting position and the size of each step so that the points
+   lying within the given bounds fit in an xdots by ydots area. */
+static void setscale(lsys_ctx *c, double xmin, double xmax, double ymin, double ymax)
 {
    float horiz,vert;
-   double xmin, xmax, ymin, ymax;
    double locsize;
-   int i;
-   struct lsys_cmd  *fsret;
-   for(i=0;i<maxangle;i++) {
-      sins[i]=sin(2*i*PI/maxangle);
-      coss[i]=cos(2*i*PI/maxangle);
-   }
-   xpos=ypos=lsys_Xmin=lsys_Xmax=lsys_Ymax=lsys_Ymin=angle=reverse=realangle=counter=0;
-   size=1.0;
-   fsret = drawLSys(command,rules,depth);
-   xmin = lsys_Xmin;
-   xmax = lsys_Xmax;
-   ymin = lsys_Ymin;
-   ymax = lsys_Ymax;
-   locsize = size;
-   if (fsret == NULL)
-      return 0;
+
    if (xmax == xmin)
       horiz = 1E37;
    else
@@ -312,85 +607,428 @@ static int  findscale(struct lsys_cmd  *command, struct lsys_cmd  **rules, int d
    locsize = (vert<horiz) ? vert : horiz;
 
    if (horiz == 1E37)
-      xpos = ceil(xdots/2);
+      c->xpos = ceil(xdots/2);
    else
-      xpos = ceil(-xmin*(locsize)+5+((xdots-10)-(locsize)*(xmax-xmin))/2);
+      c->xpos = ceil(-xmin*(locsize)+5+((xdots-10)-(locsize)*(xmax-xmin))/2);
    if (vert == 1E37)
-      ypos = ceil(ydots/2);
+      c->ypos = ceil(ydots/2);
    else
-      ypos = ceil(-ymin*(locsize)+3+((ydots-6)-(locsize)*(ymax-ymin))/2);
+      c->ypos = ceil(-ymin*(locsize)+3+((ydots-6)-(locsize)*(ymax-ymin))/2);
    locsize=floor(locsize);
    if (locsize==0) {
      locsize=1;
      fprintf(stderr,"Size too small\n");
    }
-   size = locsize;
+   c->size = locsize;
 #ifdef STDERROUT
-  fprintf(stderr,"start: %.18g,%.18g   %.18g\n",xpos,ypos,size);
+  fprintf(stderr,"start: %.18g,%.18g   %.18g\n",c->xpos,c->ypos,c->size);
 #endif
-   return 1;
 }
 
-static struct lsys_cmd  *  drawLSys(struct lsys_cmd  *command,struct lsys_cmd  **rules,int depth)
+/* Instead of recursing, drawLSys() and drawLSysOrders() keep a stack of
+   frames. A frame is pushed for each command being replaced by its rules
+   (OP_RULES) and for each '[' (OP_PUSH).                                  */
+struct lsys_frame {
+  unsigned char  *pc;       /* The OP_RULES or OP_PUSH opcode.              */
+  int level;                /* The depth (drawLSys()) or level
+                               (drawLSysOrders()) of the opcode.            */
+  int maxorder;             /* The largest order (drawLSysOrders()).        */
+  int n;                    /* OP_RULES: the rule being expanded.
+                               OP_PUSH: the number of turtles saved
+                               (drawLSysOrders()).                          */
+  char angle, reverse;      /* OP_PUSH: the turtle when the '[' was reached */
+  double size, realangle;   /* (drawLSys()).                                */
+  double xpos, ypos;
+};
+
+/* The most frames the stack may hold, so that an L-System which is nested
+   too deeply is reported instead of using up all the memory.              */
+#define LSYS_MAXFRAMES 1000000
+
+/* The state of an expansion of the rules. An expansion can be stopped (after
+   a given number of opcodes) and continued later from where it stopped.    */
+struct lsys_expansion {
+  lsys_ctx *c;              /* The context (which has the compiled rules). */
+  unsigned char  *pc;       /* The next opcode.                             */
+  int level, maxorder;      /* The depth (or level and largest order) of
+                               the next opcode.                             */
+  struct lsys_frame *stack;
+  int nframes, maxframes;
+  struct lsys_turtle *saved; /* The turtles saved by '[' (drawLSysOrders()). */
+  int nsaved, maxsaved;
+  const char *error;        /* Why the expansion failed.                    */
+};
+
+/* Starts an expansion of the axiom 'c->progs[0]'. */
+static void expansion_start(struct lsys_expansion *x, lsys_ctx *c, int level, int maxorder)
+{
+   memset(x, 0, sizeof(struct lsys_expansion));
+   x->c = c;
+   x->pc = c->progs[0];
+   x->level = level;
+   x->maxorder = maxorder;
+}
+
+static void expansion_free(struct lsys_expansion *x)
 {
-   struct lsys_cmd  **rulind;
-   int tran;
+   free(x->stack);
+   free(x->saved);
+   x->stack = NULL;
+   x->saved = NULL;
+}
 
-   while (command->ch && command->ch !=']') {
-      tran=0;
-      if (depth) {
-	 for(rulind=rules;*rulind;rulind++)
-	    if ((*rulind)->ch == command->ch) {
-	       tran=1;
-	       if (drawLSys((*rulind)+1,rules,depth-1) == NULL)
-		  return NULL;
+/* Pushes a frame for the opcode at 'pc' and returns it, or returns NULL if
+   the stack can't grow. */
+static struct lsys_frame *push_frame(struct lsys_expansion *x, unsigned char  *pc, int level)
+{
+   struct lsys_frame *doub;
+   struct lsys_frame *f;
+
+   if (x->nframes == x->maxframes) {
+      if (x->maxframes == LSYS_MAXFRAMES) {
+	 x->error = "the L-System is nested too deeply, try a lower order";
+	 return NULL;
+      }
+      doub = (struct lsys_frame *) realloc(x->stack, (long) (x->maxframes ? x->maxframes*2 : 64) * sizeof(struct lsys_frame));
+      if (doub == NULL) {
+	 x->c->stackoflow = 1;
+	 x->error = "insufficient memory, try a lower order";
+	 return NULL;
+      }
+      x->stack = doub;
+      x->maxframes = x->maxframes ? x->maxframes*2 : 64;
+      if (x->maxframes > LSYS_MAXFRAMES)
+	 x->maxframes = LSYS_MAXFRAMES;
+   }
+   f = &x->stack[x->nframes++];
+   f->pc = pc;
+   f->level = level;
+   f->n = 0;
+   return f;
+}
+
+/* Continues the expansion 'x', replacing each command by the rules it
+   matches until the depth reaches 0 and drawing the rest. At most 'maxops'
+   opcodes are run (or all of them if 'maxops' is negative). Returns 0 once
+   the expansion has finished, 1 if it stopped after 'maxops' opcodes (call
+   this again to continue it), or -1 if it failed (see 'x->error').         */
+static int expandLSys(struct lsys_expansion *x, long maxops)
+{
+   lsys_ctx *c = x->c;
+   unsigned char  *pc = x->pc;
+   int depth = x->level;
+   struct lsys_frame *f;
+
+   for (; maxops; maxops--) {
+      /* Most opcodes just move the turtle (or draw a point). */
+      if (*pc >= OP_TURN) {
+	 pc = lsys_exec(c, pc);
+	 continue;
+      }
+      switch (*pc) {
+      case OP_RULES:
+	 if (depth) {
+	    if (x->nframes < x->maxframes) {
+	       f = &x->stack[x->nframes++];
+	       f->pc = pc;
+	       f->level = depth;
+	       f->n = 0;
 	    }
+	    else if (push_frame(x, pc, depth) == NULL)
+	       goto FAILED;
+	    pc = c->progs[pc[2]];
+	    depth--;
+	 }
+	 else
+	    pc += 2 + pc[1];
+	 break;
+      case OP_PUSH:
+	 if ((f = push_frame(x, pc, depth)) == NULL)
+	    goto FAILED;
+	 f->angle = c->angle;
+	 f->reverse = c->reverse;
+	 f->size = c->size;
+	 f->realangle = c->realangle;
+	 f->xpos = c->xpos;
+	 f->ypos = c->ypos;
+	 pc++;
+	 break;
+      case OP_NOP:
+	 pc++;
+	 break;
+      case OP_END:
+      case OP_POP:
+	 if (x->nframes == 0) {
+	    /* The end of the axiom. */
+	    x->pc = pc;
+	    x->level = depth;
+	    return 0;
+	 }
+	 f = &x->stack[x->nframes-1];
+	 if (*f->pc == OP_PUSH) {
+	    c->angle = f->angle;
+	    c->reverse = f->reverse;
+	    c->size = f->size;
+	    c->realangle = f->realangle;
+	    c->xpos = f->xpos;
+	    c->ypos = f->ypos;
+	    x->nframes--;
+	    /* (The end of a rule also ends the rule the '[' is in.) */
+	    if (*pc == OP_POP)
+	       pc++;
+	 }
+	 else if (++f->n < f->pc[1]) {
+	    /* Expand the next rule the command is replaced by. */
+	    depth = f->level - 1;
+	    pc = c->progs[f->pc[2+f->n]];
+	 }
+	 else {
+	    /* The command was replaced, so it isn't drawn. */
+	    depth = f->level;
+	    pc = lsys_skip(f->pc + 2 + f->pc[1]);
+	    x->nframes--;
+	 }
+	 break;
       }
-      if (!depth||!tran) {
-	if (command->f)
-	  (*command->f)(command->n);
-	else if (command->ch == '[') {
-	  char saveang,saverev;
-	  double savesize,savex,savey;
-	  double saverang;
-	  saveang=angle;
-	  saverev=reverse;
-	  savesize=size;
-	  saverang=realangle;
-	  savex=xpos;
-	  savey=ypos;
-	  if ((command=drawLSys(command+1,rules,depth)) == NULL)
-	     return(NULL);
-	  angle=saveang;
-	  reverse=saverev;
-	  size=savesize;
-	  realangle=saverang;
-	  xpos=savex;
-	  ypos=savey;
-	}
+   }
+   x->pc = pc;
+   x->level = depth;
+   return 1;
+
+FAILED:
+   x->pc = pc;
+   x->level = depth;
+   return -1;
+}
+
+/* Runs the compiled rules 'c->progs' (the axiom is 'c->progs[0]'), replacing
+   the commands by the rules they match until 'depth' reaches 0. Returns 0, or
+   -1 if the L-System couldn't be expanded.                               */
+static int drawLSys(lsys_ctx *c, int depth)
+{
+   struct lsys_expansion x;
+   int ret;
+
+   expansion_start(&x, c, depth, 0);
+   ret = expandLSys(&x, -1);
+   if (ret < 0 && !c->stackoflow)
+      fprintf(stderr, "Error:  %s\n", x.error);
+   expansion_free(&x);
+   return ret;
+}
+
+/* Copies the turtle which is drawing into the current turtle. */
+static void save_turtle(lsys_ctx *c)
+{
+  struct lsys_turtle *t = &c->turtles[c->curturtle];
+  t->xpos = c->xpos;
+  t->ypos = c->ypos;
+  t->size = c->size;
+  t->realangle = c->realangle;
+  t->angle = c->angle;
+  t->reverse = c->reverse;
+  t->Xmin = c->Xmin;
+  t->Xmax = c->Xmax;
+  t->Ymin = c->Ymin;
+  t->Ymax = c->Ymax;
+  t->rawbuf = c->rawbuf;
+  t->rawbuf_size = c->rawbuf_size;
+  t->currentnode = c->currentnode;
+}
+
+/* Makes the current turtle the one which is drawing. */
+static void load_turtle(lsys_ctx *c)
+{
+  struct lsys_turtle *t = &c->turtles[c->curturtle];
+  c->xpos = t->xpos;
+  c->ypos = t->ypos;
+  c->size = t->size;
+  c->realangle = t->realangle;
+  c->angle = t->angle;
+  c->reverse = t->reverse;
+  c->Xmin = t->Xmin;
+  c->Xmax = t->Xmax;
+  c->Ymin = t->Ymin;
+  c->Ymax = t->Ymax;
+  c->rawbuf = t->rawbuf;
+  c->rawbuf_size = t->rawbuf_size;
+  c->currentnode = t->currentnode;
+}
+
+/* Makes the turtle of the specified order the current turtle. */
+static void use_turtle(lsys_ctx *c, int order)
+{
+  if (order == c->curturtle)
+    return;
+  save_turtle(c);
+  c->curturtle = order;
+  load_turtle(c);
+}
+
+/* Does the same as expandLSys(), but for every order from 1 to the largest
+   order at the same time. An opcode belongs to a rule which is 'level' rules
+   below the axiom. The orders greater than 'level' replace the command by
+   the rules it matches and the other orders draw it, so each order sees
+   exactly the same commands drawLSys() would.                              */
+static int expandLSysOrders(struct lsys_expansion *x, long maxops)
+{
+   lsys_ctx *c = x->c;
+   unsigned char  *pc = x->pc;
+   int level = x->level, maxorder = x->maxorder;
+   int k, firstorder, lastorder;
+   struct lsys_frame *f;
+   struct lsys_turtle *doub;
+
+   lastorder = maxorder;
+   for (; maxops; maxops--) {
+      firstorder = level ? level : 1;
+      switch (*pc) {
+      case OP_RULES:
+	 if (level < maxorder) {
+	    if ((f = push_frame(x, pc, level)) == NULL)
+	       goto FAILED;
+	    f->maxorder = maxorder;
+	    pc = c->progs[pc[2]];
+	    level++;
+	 }
+	 else
+	    pc += 2 + pc[1];
+	 continue;
+      case OP_PUSH:
+	 if (firstorder <= lastorder) {
+	   if ((f = push_frame(x, pc, level)) == NULL)
+	      goto FAILED;
+	   f->maxorder = maxorder;
+	   f->n = lastorder - firstorder + 1;
+	   if (x->nsaved + f->n > x->maxsaved) {
+	      doub = (struct lsys_turtle *) realloc(x->saved, (long) (x->maxsaved*2 + f->n) * sizeof(struct lsys_turtle));
+	      if (doub == NULL) {
+		 c->stackoflow = 1;
+		 x->error = "insufficient memory, try a lower order";
+		 goto FAILED;
+	      }
+	      x->saved = doub;
+	      x->maxsaved = x->maxsaved*2 + f->n;
+	   }
+	   save_turtle(c);
+	   memcpy(&x->saved[x->nsaved], &c->turtles[firstorder], f->n * sizeof(struct lsys_turtle));
+	   x->nsaved += f->n;
+	   maxorder = lastorder;
+	 }
+	 pc++;
+	 break;
+      case OP_NOP:
+	 pc++;
+	 break;
+      case OP_END:
+      case OP_POP:
+	 if (x->nframes == 0) {
+	    /* The end of the axiom. */
+	    x->pc = pc;
+	    x->level = level;
+	    x->maxorder = maxorder;
+	    return 0;
+	 }
+	 f = &x->stack[x->nframes-1];
+	 if (*f->pc == OP_PUSH) {
+	    struct lsys_turtle *saved = &x->saved[x->nsaved - f->n];
+	    level = f->level;
+	    maxorder = f->maxorder;
+	    firstorder = level ? level : 1;
+	    save_turtle(c);
+	    for (k=0; k<f->n; k++) {
+	      c->turtles[firstorder+k].angle = saved[k].angle;
+	      c->turtles[firstorder+k].reverse = saved[k].reverse;
+	      c->turtles[firstorder+k].size = saved[k].size;
+	      c->turtles[firstorder+k].realangle = saved[k].realangle;
+	      c->turtles[firstorder+k].xpos = saved[k].xpos;
+	      c->turtles[firstorder+k].ypos = saved[k].ypos;
+	    }
+	    load_turtle(c);
+	    x->nsaved -= f->n;
+	    x->nframes--;
+	    /* (The end of a rule also ends the rule the '[' is in.) */
+	    if (*pc == OP_POP)
+	       pc++;
+	 }
+	 else if (++f->n < f->pc[1]) {
+	    /* Expand the next rule the command is replaced by. */
+	    level = f->level + 1;
+	    maxorder = f->maxorder;
+	    pc = c->progs[f->pc[2+f->n]];
+	    continue;
+	 }
+	 else {
+	    level = f->level;
+	    maxorder = f->maxorder;
+	    pc = f->pc + 2 + f->pc[1];
+	    x->nframes--;
+	    /* A command which was replaced is only drawn by the order which has
+	       no more rules to apply. */
+	    lastorder = level;
+	    continue;
+	 }
+	 break;
+      default:
+	 for (k=firstorder; k<=lastorder; k++) {
+	   use_turtle(c, k);
+	   lsys_exec(c, pc);
+	 }
+	 pc = lsys_skip(pc);
+	 break;
       }
-      command++;
+      lastorder = maxorder;
    }
-   return command;
+   x->pc = pc;
+   x->level = level;
+   x->maxorder = maxorder;
+   return 1;
+
+FAILED:
+   x->pc = pc;
+   x->level = level;
+   x->maxorder = maxorder;
+   return -1;
 }
 
-#define MAXRULES 27 /* this limits rules to 25 */
-static char  *ruleptrs[MAXRULES];
-static struct lsys_cmd  *rules2[MAXRULES];
+/* Runs the compiled rules 'c->progs' for every order from 1 to 'maxorder'
+   (see expandLSysOrders()). Returns 0, or -1 if the L-System couldn't be
+   expanded.                                                              */
+static int drawLSysOrders(lsys_ctx *c, int maxorder)
+{
+   struct lsys_expansion x;
+   int ret;
+
+   expansion_start(&x, c, 0, maxorder);
+   ret = expandLSysOrders(&x, -1);
+   if (ret < 0 && !c->stackoflow)
+      fprintf(stderr, "Error:  %s\n", x.error);
+   expansion_free(&x);
+   return ret;
+}
 
 #ifndef SEEK_SET
 #define SEEK_SET 0
 #endif
 
-static int  readLSystemFile(char *str,char *name)
+static int  readLSystemFile(lsys_ctx *c, char *str,char *name)
 {
-   int c;
-   char  **rulind;
-   int err=0;
-   int linenum,check=0;
-   char theline[161],fixed[161],*word;
    FILE *infile;
-   char msgbuf[481]; /* enough for 6 full lines */
+   char *line = NULL;
+   size_t size = 0;
+   ssize_t len;
+   ls_index idx;
+   int i, ret;
+
+   /* The L-System is found in the index of the file if it has that name
+      (otherwise the first line which contains the name is searched for). */
+   if (name && ls_index_open(&idx, str, NULL) == 0) {
+      i = ls_index_find(&idx, name);
+      ret = (i >= 0) ? readLSystemIndex(c, &idx, i) : 0;
+      ls_index_close(&idx);
+      if (i >= 0)
+	 return ret;
+   }
 
    infile = fopen(str,"rt");
    if (!infile) {
@@ -398,89 +1036,143 @@ static int  readLSystemFile(char *str,char *name)
      return -1;
    }
    if (name) {
-     while (fgets(msgbuf,sizeof(msgbuf),infile)){
-       if (strstr(msgbuf,name)){
-         fseek(infile,ftell(infile)-strlen(msgbuf),SEEK_SET);
+     while ((len = getline(&line,&size,infile)) != -1){
+       if (strstr(line,name)){
+         fseek(infile,ftell(infile)-len,SEEK_SET);
          name=0;
          break;
        }
      }
+     free(line);
      if (name) {
        fprintf(stderr, "Unable to find lsystem '%s' in file '%s'\n\n",
               name,str);
+       fclose(infile);
        return -1;
      }
    }
-   while ((c = fgetc(infile)) != '{')
-      if (c == EOF) return -1;
+   ret = readLSystemStream(c, infile);
+   fclose(infile);
+   return ret;
+}
 
-   maxangle=0;
-   for(linenum=0;linenum<MAXRULES;++linenum) ruleptrs[linenum]=NULL;
-   rulind= &ruleptrs[1];
+
+/* Reads the rules of the L-System at position 'i' in the index 'idx' (see
+   ls/ls_index.h). */
+static int  readLSystemIndex(lsys_ctx *c, const ls_index *idx, int i)
+{
+   FILE *infile;
+   char *text;
+   long length;
+   int ret = -1;
+
+   /* The rules are read from the text in memory as if it was a file. */
+   text = ls_index_text(idx, i, &length);
+   if (text && (infile = fmemopen(text, length, "r"))) {
+      ret = readLSystemStream(c, infile);
+      fclose(infile);
+   }
+   free(text);
+   return ret;
+}
+
+
+/* Reads the rules of the first L-System (from its '{' to its '}') in
+   'infile'. */
+static int  readLSystemStream(lsys_ctx *c, FILE *infile)
+{
+   int ch, r;
+   char  **rulind;
+   int err=0;
+   int linenum,check=0;
+   ls_word word = { NULL, 0, 0 }, tok = { NULL, 0, 0 };
+   char *fixed;
+   char msgbuf[481]; /* enough for 6 lines */
+   size_t len;
+
+   while ((ch = fgetc(infile)) != '{')
+      if (ch == EOF) return -1;
+
+   c->maxangle=0;
+   for(linenum=0;linenum<MAXRULES;++linenum) c->ruleptrs[linenum]=NULL;
+   rulind= &c->ruleptrs[1];
    msgbuf[0]=linenum=0;
 
-   while(fgets(theline,160,infile))  /* Max line length 160 chars */
+   /* The lines are read a word at a time (see ls_read_word()), so they can be
+      of any length. */
+   while((r = ls_read_word(infile, " =\t", &word)) != EOF)
    {
       linenum++;
-      if ((word = strchr(theline,';'))) /* strip comment */
-	 *word = 0;
-      strlwr(theline);
-
-      if (strspn(theline," \t\n") < strlen(theline)) /* not a blank line */
+      if (r == 1) /* not a blank line */
       {
-	 word=strtok(theline," =\t\n");
-	 if (!strcmp(word,"axiom"))
+	 strlwr(word.str);
+	 if (!strcmp(word.str,"axiom"))
 	 {
-	    save_rule(strtok(NULL," \t\n"),&ruleptrs[0]);
+	    if (ls_read_word(infile, " \t", &tok) == 1) {
+	       strlwr(tok.str);
+	       save_rule(c, tok.str, &c->ruleptrs[0]);
+	    }
 	    check=1;
 	 }
-	 else if (!strcmp(word,"angle"))
+	 else if (!strcmp(word.str,"angle"))
 	 {
-	    maxangle=atoi(strtok(NULL," \t\n"));
-	    dmaxangle = maxangle - 1;
+	    c->maxangle = (ls_read_word(infile, " \t", &tok) == 1) ? atoi(tok.str) : 0;
 	    check=1;
 	 }
-	 else if (!strcmp(word,"}"))
+	 else if (!strcmp(word.str,"}"))
 	    break;
-	 else if (strlen(word)==1)
+	 else if (word.len==1 && rulind < &c->ruleptrs[MAXRULES-1])
 	 {
-	    char *tok;
-	    tok = strtok(NULL, " \t\n");
-	    strcpy(fixed, word);
-	    if (tok != NULL)
-               strcat(fixed, tok);
-	    save_rule(fixed, rulind++);
+	    if (ls_read_word(infile, " \t", &tok) == 1)
+	       strlwr(tok.str);
+	    /* The rule is its name followed by what it is replaced by. */
+	    if ((fixed = (char *) malloc(word.len + tok.len + 1)) != NULL) {
+	       memcpy(fixed, word.str, word.len);
+	       if (tok.len > 0)
+		  memcpy(fixed + word.len, tok.str, tok.len);
+	       fixed[word.len + tok.len] = 0;
+	    }
+	    else
+	       c->stackoflow = 1;
+	    *rulind++ = fixed;
 	    check=1;
 	 }
 	 else
 	    if (err<6)
 	    {
-	       sprintf(&msgbuf[strlen(msgbuf)],
-		       "Syntax error line %d: %s\n",linenum,word);
+	       len = strlen(msgbuf);
+	       snprintf(&msgbuf[len], sizeof(msgbuf) - len,
+			(word.len==1) ? "Too many rules line %d: %s\n" : "Syntax error line %d: %s\n",
+			linenum, word.str);
 	       ++err;
 	    }
 	 if (check)
 	 {
 	    check=0;
-	    if(word=strtok(NULL," \t\n"))
+	    if (ls_read_word(infile, " \t", &tok) == 1)
 	       if (err<6)
 	       {
-		  sprintf(&msgbuf[strlen(msgbuf)],
-			 "Extra text after command line %d: %s\n",linenum,word);
+		  len = strlen(msgbuf);
+		  snprintf(&msgbuf[len], sizeof(msgbuf) - len,
+			   "Extra text after command line %d: %s\n",linenum,tok.str);
 		  ++err;
 	       }
 	 }
       }
+      ls_skip_line(infile);
    }
-   fclose(infile);
-   if (!ruleptrs[0] && err<6)
+   free(word.str);
+   free(tok.str);
+   if (!c->ruleptrs[0] && err<6)
    {
-      strcat(msgbuf,"Error:  no axiom\n");
+      len = strlen(msgbuf);
+      snprintf(&msgbuf[len], sizeof(msgbuf) - len, "Error:  no axiom\n");
       ++err;
    }
-   if ((maxangle<3||maxangle>50) && err<6)
+   if ((c->maxangle<3||c->maxangle>50) && err<6)
    {
-      strcat(msgbuf,"Error:  illegal or missing angle\n");
+      len = strlen(msgbuf);
+      snprintf(&msgbuf[len], sizeof(msgbuf) - len, "Error:  illegal or missing angle\n");
       ++err;
    }
    if (err)
@@ -490,85 +1182,783 @@ static int  readLSystemFile(char *str,char *name)
       return -1;
    }
    *rulind=NULL;
+   index_rules(c);
    return 0;
 }
 
 
-int Lsystem(int order, char *name, char *title, char *outputfilename)
+/* Does the same as readLSystemFile(), except the rules are taken from an
+   lsystem structure. */
+static int  readLSystem_ls(lsys_ctx *c, const lsystem *ls)
 {
-   currentnode = 0;
-   outputfile = fopen(outputfilename, "w");
-   if (outputfile == NULL)
-      fprintf(stderr, "ERROR. Couldn't open outputfile (%s)\n", outputfilename);
+   int i, j, n;
+   char *rule, *s;
 
-   char  **rulesc;
-   struct lsys_cmd  **sc;
+   for(i=0;i<MAXRULES;++i) c->ruleptrs[i]=NULL;
 
-   if (LLoad(name,title))
+   if (ls->numrules < 1 || ls->numrules >= MAXRULES) {
+     fprintf(stderr, "Error:  the L-System has too many rules\n");
+     return -1;
+   }
+   if (ls->angle < 3 || ls->angle > 50) {
+     fprintf(stderr, "Error:  illegal or missing angle\n");
      return -1;
+   }
+   c->maxangle = ls->angle;
+
+   for (i = 0; i < ls->numrules; i++) {
+     /* Every rule (except the axiom) starts with the name of the rule. */
+     n = (i > 0);
+     for (j = 0; j < ls->rulelength[i]; j++)
+       n += ls->rule[i][j].len;
+     if ((rule = malloc((long)n+1)) == NULL) {
+       c->stackoflow = 1;
+       return -1;
+     }
+     s = rule;
+     if (i > 0)
+       *s++ = ls->startvar[i-1];
+     for (j = 0; j < ls->rulelength[i]; j++) {
+       memcpy(s, ls->rule[i][j].str, ls->rule[i][j].len);
+       s += ls->rule[i][j].len;
+     }
+     *s = 0;
+     strlwr(rule);
+     c->ruleptrs[i] = rule;
+   }
+   c->ruleptrs[ls->numrules] = NULL;
+   index_rules(c);
+   return 0;
+}
+
 
-   stackoflow = 0;
+/* Creates the points of the L-System whose rules are stored in 'ruleptrs'.
+   The rules are expanded once, storing the unscaled points in 'rawbuf' and
+   finding their bounds, then the points are scaled to fit in an xdots by
+   ydots area and sent to 'sink' by place_points(). Returns 0, or -1 if the
+   L-System couldn't be expanded (e.g. it is nested too deeply) or the sink
+   failed. */
+static int generate(lsys_ctx *c, int order, lsys_sink *sink)
+{
+   int ret = -1;
+
+   c->stackoflow = 0;
+   c->rawbuf = NULL;
+   c->rawbuf_size = 0;
+
+   compile_rules(c);
+   if (!c->stackoflow) {
+      reset_turtle(c);
+      ret = drawLSys(c, order);
+      if (ret == 0) {
+	 setscale(c, c->Xmin, c->Xmax, c->Ymin, c->Ymax);
+	 ret = place_points(c, c->rawbuf, c->currentnode, c->xpos, c->ypos, c->size, sink);
+      }
+   }
+   if (c->stackoflow)
+   {
+      static char  msg[]={"insufficient memory, try a lower order"};
+      stopmsg(msg);
+      ret = -1;
+   }
+   free(c->rawbuf);
+   c->rawbuf = NULL;
+   c->rawbuf_size = 0;
+   free_rules_mem(c);
+   free_progs(c);
+   return ret;
+}
 
-   sc = rules2;
-   for (rulesc = ruleptrs; *rulesc; rulesc++)
-     *sc++ = SizeTransform(*rulesc);
-   *sc = NULL;
 
-   if (findscale(rules2[0], &rules2[1], order)) {
-      realangle = angle = reverse = 0;
+/* Expands the rules (which are compiled first) for every order from 1 to
+   'maxorder' at the same time. The unscaled points and the bounds of order
+   k are left in 'c->turtles[k]' (call free_turtles() once they have been
+   used). Returns 0, or -1 if the L-System couldn't be expanded.           */
+static int expand_orders(lsys_ctx *c, int maxorder)
+{
+   int k, ret = -1;
 
-      free_lcmds();
-      sc = rules2;
-      for (rulesc = ruleptrs; *rulesc; rulesc++)
-        *sc++ = DrawTransform(*rulesc);
-      *sc = NULL;
+   c->stackoflow = 0;
 
-      drawLSys(rules2[0], &rules2[1], order);
+   c->turtles = (struct lsys_turtle *) calloc(maxorder+1, sizeof(struct lsys_turtle));
+   if (c->turtles == NULL) {
+      static char  msg[]={"insufficient memory, try a lower order"};
+      stopmsg(msg);
+      c->stackoflow = 1;
+      return -1;
+   }
+   for (k=0; k<=maxorder; k++)
+      c->turtles[k].size = 1.0;
+   c->curturtle = 0;
+   load_turtle(c);
+
+   compile_rules(c);
+   if (!c->stackoflow)
+      ret = drawLSysOrders(c, maxorder);
+   save_turtle(c);
+   return ret;
+}
+
+static void free_turtles(lsys_ctx *c, int maxorder)
+{
+   int k;
+
+   if (c->turtles != NULL) {
+      for (k=1; k<=maxorder; k++)
+	 free(c->turtles[k].rawbuf);
+      free(c->turtles);
+   }
+   c->turtles = NULL;
+   c->rawbuf = NULL;
+   c->rawbuf_size = 0;
+   c->currentnode = 0;
+}
+
+
+/* Does the same as generate() for every order from 1 to 'maxorder'. The
+   rules are only expanded once (to 'maxorder') and every command is drawn by
+   each order it belongs to, instead of expanding the rules again for each
+   order. The points of order k are returned in 'points[k-1]' and
+   'numpoints[k-1]'. Returns 0, or -1 if the L-System couldn't be expanded
+   (in which case no points are returned).                                */
+static int generate_orders(lsys_ctx *c, int maxorder, lsys_point **points, int *numpoints)
+{
+   int k, ret;
+   lsys_sink sink;
+
+   ret = expand_orders(c, maxorder);
+
+   /* Scale the points of each order to fit. */
+   for (k=1; k<=maxorder && ret == 0 && !c->stackoflow; k++) {
+      setscale(c, c->turtles[k].Xmin, c->turtles[k].Xmax, c->turtles[k].Ymin, c->turtles[k].Ymax);
+      lsys_array_sink(&sink, &points[k-1]);
+      if (place_points(c, c->turtles[k].rawbuf, c->turtles[k].currentnode, c->xpos, c->ypos, c->size, &sink))
+	 c->stackoflow = 1;
+      numpoints[k-1] = c->turtles[k].currentnode;
    }
-   if (stackoflow)
+   if (c->stackoflow)
    {
       static char  msg[]={"insufficient memory, try a lower order"};
       stopmsg(msg);
+      if (ret == 0) {
+	 for (k--; k>1; k--)
+	    free(points[k-2]);
+	 ret = -1;
+      }
    }
-   free_rules_mem();
-   free_lcmds();
+
+   free_turtles(c, maxorder);
+   free_rules_mem(c);
+   free_progs(c);
+   return ret;
+}
 
 
-   if (outputfile != NULL)
-      if (fclose(outputfile) != 0)
-         fprintf(stderr, "ERROR. Couldn't close outputfile (%s)\n", outputfilename);
+/* Moving the turtle only depends on 'angle', 'reverse' and 'size' (unless
+   the L-System uses 'd', 'm', '/' or '\'), so a rule expanded to a given
+   depth always moves the turtle in the same way when it starts with the same
+   'angle' and 'reverse', and everything it does is scaled by 'size'. This is
+   a "macro step": the rule is replaced by the net result of expanding it. */
+struct lsys_macro {
+  double dx, dy;            /* How far the turtle moves.                   */
+  double xmin, xmax;        /* The bounds of the turtle's moves (relative  */
+  double ymin, ymax;        /*   to where it starts).                      */
+  double numpoints;         /* The number of points created.               */
+  double scale;             /* How much 'size' is multiplied by.           */
+  char angle, reverse;      /* 'angle' and 'reverse' when it has finished. */
+};
+
+/* A layer of macro steps: the macro step of rule i (with the depth of the
+   layer) starting with angle a and reverse r is 'layer[MACRO(i,a,r)]'.    */
+#define MACRO(i,a,r) (((i)*c->maxangle + (a))*2 + (r))
+
+/* The state of the turtle while a macro step is found. */
+struct lsys_macro_turtle {
+  double x, y, size;
+  char angle, reverse;
+};
 
-   return currentnode;
+/* Finds the macro step of the compiled rule 'pc' starting with angle 'a'
+   and reverse 'r'. The commands in the rule are replaced by the macro steps
+   in 'layer' (the rules expanded to one less depth), or drawn if 'layer' is
+   NULL. 'stack' must have room for every '[' in the rule.               */
+static void find_macro(lsys_ctx *c, unsigned char  *pc, char a, char r, const struct lsys_macro *layer,
+		       struct lsys_macro_turtle *stack, struct lsys_macro *m)
+{
+  struct lsys_macro_turtle t;
+  const struct lsys_macro *e;
+  double n, x, y;
+  int i, nstack = 0;
+
+  t.x = t.y = 0;
+  t.size = 1.0;
+  t.angle = a;
+  t.reverse = r;
+  m->xmin = m->ymin = HUGE_VAL;
+  m->xmax = m->ymax = -HUGE_VAL;
+  m->numpoints = 0;
+
+  for (;;) {
+    switch (*pc) {
+    case OP_END:
+      /* (The end of a rule also ends every '[' in it.) */
+      if (nstack)
+        t = stack[0];
+      goto DONE;
+    case OP_POP:
+      /* (A ']' without a '[' ends the rule.) */
+      if (nstack == 0)
+        goto DONE;
+      t = stack[--nstack];
+      pc++;
+      break;
+    case OP_PUSH:
+      stack[nstack++] = t;
+      pc++;
+      break;
+    case OP_RULES:
+      if (layer == NULL) {
+        pc += 2 + pc[1];
+        break;
+      }
+      for (i=0; i<pc[1]; i++) {
+        e = &layer[MACRO(pc[2+i], t.angle, t.reverse)];
+        if (e->xmin <= e->xmax) {
+          /* ('size' can be negative, which swaps the bounds.) */
+          x = t.x + t.size*e->xmin;  y = t.x + t.size*e->xmax;
+          if (x > y) { n = x; x = y; y = n; }
+          if (x < m->xmin) m->xmin = x;
+          if (y > m->xmax) m->xmax = y;
+          x = t.y + t.size*e->ymin;  y = t.y + t.size*e->ymax;
+          if (x > y) { n = x; x = y; y = n; }
+          if (x < m->ymin) m->ymin = x;
+          if (y > m->ymax) m->ymax = y;
+        }
+        t.x += t.size*e->dx;
+        t.y += t.size*e->dy;
+        t.size *= e->scale;
+        t.angle = e->angle;
+        t.reverse = e->reverse;
+        m->numpoints += e->numpoints;
+      }
+      pc = lsys_skip(pc + 2 + pc[1]);
+      break;
+    case OP_TURN:
+      t.angle += pc[t.reverse ? 2 : 1];
+      if (t.angle >= c->maxangle)
+        t.angle -= c->maxangle;
+      pc += 3;
+      break;
+    case OP_PIPE:
+      t.angle = (t.angle + c->maxangle / 2) % c->maxangle;
+      pc++;
+      break;
+    case OP_BANG:
+      t.reverse = ! t.reverse;
+      pc++;
+      break;
+    case OP_AT:
+      memcpy(&n, pc+1, sizeof(n));
+      t.size *= n;
+      pc += 1 + sizeof(n);
+      break;
+    case OP_DRAWG:
+    case OP_DRAWF:
+      t.x += t.size*c->coss[(int)t.angle];
+      t.y += t.size*c->sins[(int)t.angle];
+      if (t.x < m->xmin) m->xmin = t.x;
+      if (t.x > m->xmax) m->xmax = t.x;
+      if (t.y < m->ymin) m->ymin = t.y;
+      if (t.y > m->ymax) m->ymax = t.y;
+      if (*pc == OP_DRAWF)
+        m->numpoints++;
+      pc++;
+      break;
+    default:
+      /* OP_NOP (the others were rejected by macro_extents()). */
+      pc = lsys_skip(pc);
+      break;
+    }
+  }
+DONE:
+  m->dx = t.x;
+  m->dy = t.y;
+  m->scale = t.size;
+  m->angle = t.angle;
+  m->reverse = t.reverse;
 }
 
-int LLoad(char *name,char *title)
+/* Finds the number of points and the (unscaled) bounds of every order from
+   1 to 'maxorder' of the compiled rules in 'c->progs' using macro steps, so the
+   time taken grows with 'maxorder' instead of the number of commands.
+   Returns 0, 1 if the L-System can't use macro steps (it uses 'd', 'm', '/'
+   or '\'), or -1 if there isn't enough memory.                           */
+static int macro_extents(lsys_ctx *c, int maxorder, lsys_extent *extents)
 {
-   char i;
-   if (readLSystemFile(name,title)) { /* error occurred */
-      free_rules_mem();
+  struct lsys_macro *layer, *prev, *tmp, m;
+  struct lsys_macro_turtle *stack;
+  unsigned char  *pc;
+  int i, k, a, r, nprogs, maxlen = 1;
+
+  for (nprogs=0; nprogs<MAXRULES && c->progs[nprogs]; nprogs++) {
+    for (pc=c->progs[nprogs]; *pc != OP_END; pc=lsys_skip(pc)) {
+      if (*pc == OP_SLASH || *pc == OP_BSLASH || *pc == OP_DRAWD || *pc == OP_DRAWM)
+        return 1;
+    }
+    if (pc - c->progs[nprogs] + 1 > maxlen)
+      maxlen = pc - c->progs[nprogs] + 1;
+  }
+
+  layer = (struct lsys_macro *) malloc((long) nprogs*c->maxangle*2 * sizeof(struct lsys_macro));
+  prev = (struct lsys_macro *) malloc((long) nprogs*c->maxangle*2 * sizeof(struct lsys_macro));
+  stack = (struct lsys_macro_turtle *) malloc((long) maxlen * sizeof(struct lsys_macro_turtle));
+  if (layer == NULL || prev == NULL || stack == NULL) {
+    free(layer);
+    free(prev);
+    free(stack);
+    return -1;
+  }
+
+  for (k=1; k<=maxorder; k++) {
+    /* Find the rules expanded to depth k-1 (their commands are drawn at
+       depth 0) from the rules expanded to depth k-2 in 'prev'.            */
+    for (i=1; i<nprogs; i++)
+      for (a=0; a<c->maxangle; a++)
+        for (r=0; r<2; r++)
+          find_macro(c, c->progs[i], a, r, (k > 1) ? prev : NULL, stack, &layer[MACRO(i,a,r)]);
+    tmp = prev;
+    prev = layer;
+    layer = tmp;
+
+    /* Order k is the axiom with its commands replaced by the rules expanded
+       to depth k-1. */
+    find_macro(c, c->progs[0], 0, 0, prev, stack, &m);
+    extents[k-1].numpoints = m.numpoints;
+    /* (The turtle starts at the origin, which is inside the bounds.) */
+    extents[k-1].xmin = (m.xmin < 0) ? m.xmin : 0;
+    extents[k-1].xmax = (m.xmax > 0) ? m.xmax : 0;
+    extents[k-1].ymin = (m.ymin < 0) ? m.ymin : 0;
+    extents[k-1].ymax = (m.ymax > 0) ? m.ymax : 0;
+  }
+
+  free(layer);
+  free(prev);
+  free(stack);
+  return 0;
+}
+
+
+int LsystemExtents(lsys_ctx *c, int maxorder, const lsystem *ls, lsys_extent *extents)
+{
+   int k, ret;
+
+   c->stackoflow = 0;
+   if (readLSystem_ls(c,ls)) {
+      free_rules_mem(c);
       return -1;
    }
-   for(i=0;i<maxangle;i++) {
-      sins[i]=sin(2*i*PI/maxangle);
-      coss[i]=cos(2*i*PI/maxangle);
+   init_angles(c);
+
+   compile_rules(c);
+   ret = c->stackoflow ? -1 : macro_extents(c, maxorder, extents);
+   free_progs(c);
+
+   if (ret == 1) {
+      /* The rules have to be expanded. */
+      ret = expand_orders(c, maxorder);
+      for (k=1; k<=maxorder && ret == 0; k++) {
+	 extents[k-1].numpoints = c->turtles[k].currentnode;
+	 extents[k-1].xmin = c->turtles[k].Xmin;
+	 extents[k-1].xmax = c->turtles[k].Xmax;
+	 extents[k-1].ymin = c->turtles[k].Ymin;
+	 extents[k-1].ymax = c->turtles[k].Ymax;
+      }
+      free_turtles(c, maxorder);
+      free_progs(c);
    }
+
+   free_rules_mem(c);
+   return ret;
+}
+
+
+/* Maps the window of the stream which starts at the page holding the next
+   byte to be written, and which has room for at least 'n' more bytes. The
+   window before it is unmapped and written out. Returns 0, or -1 if the
+   window couldn't be mapped. */
+static int stream_map(struct lsys_stream *s, size_t n)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  off_t offset = s->offset + (off_t) (s->used / page) * page;
+
+  if (s->window != NULL) {
+    munmap(s->window, s->length);
+    s->window = NULL;
+#ifdef SYNC_FILE_RANGE_WRITE
+    if (offset > s->offset)
+      sync_file_range(s->fd, s->offset, offset - s->offset, SYNC_FILE_RANGE_WRITE);
+#endif
+    /* (The writing of the windows before this one has been started, so they
+       can be dropped from the cache.) */
+    if (s->offset > s->flushed) {
+      posix_fadvise(s->fd, s->flushed, s->offset - s->flushed, POSIX_FADV_DONTNEED);
+      s->flushed = s->offset;
+    }
+  }
+
+  s->used -= offset - s->offset;
+  s->offset = offset;
+  s->length = LSYS_STREAM_WINDOW;
+  if ((off_t) s->length > s->size - offset)
+    s->length = s->size - offset;
+  if (s->used + n > s->length)
+    return -1;
+  s->window = (char *) mmap(NULL, s->length, PROT_READ|PROT_WRITE, MAP_SHARED, s->fd, offset);
+  if (s->window == MAP_FAILED) {
+    s->window = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+/* Returns where the next 'n' bytes of the stream should be written, or NULL
+   if the stream has failed. */
+static char *stream_reserve(struct lsys_stream *s, size_t n)
+{
+  if (s->failed)
+    return NULL;
+  if ((s->window == NULL || s->used + n > s->length) && stream_map(s, n)) {
+    s->failed = 1;
+    return NULL;
+  }
+  return s->window + s->used;
+}
+
+/* Places the next point (in the same way as place_points()) and writes it
+   to the stream. */
+static void stream_point(lsys_ctx *c, double x, double y)
+{
+  struct lsys_stream *s = c->stream;
+  int px = (int)nint(s->x0 + s->scale*x);
+  int py = (int)nint(s->y0 + s->scale*y);
+  char *p, *q;
+
+  s->negative |= (px < 0) | (py < 0);
+  if ((p = stream_reserve(s, TSPLIB_MAX_LINE)) == NULL)
+    return;
+  if (s->binary) {
+    tsplib_put_binary_int((unsigned char *) p, px);
+    tsplib_put_binary_int((unsigned char *) p + 4, py);
+    s->used += 8;
+  }
+  else {
+    q = tsplib_put_int(p, c->currentnode);
+    *q++ = ' ';
+    q = tsplib_put_int(q, px);
+    *q++ = ' ';
+    q = tsplib_put_int(q, py);
+    *q++ = '\n';
+    s->used += q - p;
+  }
+}
+
+/* Writes 'n' bytes to the stream. */
+static void stream_write(struct lsys_stream *s, const char *buf, size_t n)
+{
+  char *p = stream_reserve(s, n);
+  if (p != NULL) {
+    memcpy(p, buf, n);
+    s->used += n;
+  }
+}
+
+/* The number of opcodes run between checks that the stream hasn't failed. */
+#define LSYS_STREAM_CHUNK (1L<<20)
+
+int LsystemStream(lsys_ctx *c, int order, char *name, char *title, char *outputfilename, int binary, double *rate)
+{
+   struct lsys_stream s;
+   struct lsys_expansion x;
+   struct timeval start, end;
+   lsys_extent *extents;
+   double xmin, xmax, ymin, ymax, numpoints, seconds;
+   char header[512];
+   int ret = -1, n;
+
+   gettimeofday(&start, NULL);
+   memset(&s, 0, sizeof(s));
+   s.fd = -1;
+   s.binary = binary;
+   c->stackoflow = 0;
+   c->currentnode = 0;
+   if (LLoad(c,name,title))
+      return -1;
+   compile_rules(c);
+   if (c->stackoflow)
+      goto DONE;
+
+   /* The number of points and their bounds are needed before the points are
+      created. They are found from the net moves of the rules (see
+      macro_extents()) if possible, otherwise the rules are expanded and the
+      points are counted (without being stored). */
+   extents = (order > 0) ? (lsys_extent *) malloc((long) order * sizeof(lsys_extent)) : NULL;
+   if (extents != NULL && macro_extents(c, order, extents) == 0) {
+      numpoints = extents[order-1].numpoints;
+      xmin = extents[order-1].xmin;
+      xmax = extents[order-1].xmax;
+      ymin = extents[order-1].ymin;
+      ymax = extents[order-1].ymax;
+   }
+   else {
+      s.counting = 1;
+      c->stream = &s;
+      reset_turtle(c);
+      if (drawLSys(c, order)) {
+	 free(extents);
+	 goto DONE;
+      }
+      numpoints = c->currentnode;
+      xmin = c->Xmin;
+      xmax = c->Xmax;
+      ymin = c->Ymin;
+      ymax = c->Ymax;
+   }
+   free(extents);
+   if (numpoints > INT_MAX) {
+      fprintf(stderr, "Error:  too many points (%.0f)\n", numpoints);
+      goto DONE;
+   }
+   n = (int) numpoints;
+
+   setscale(c, xmin, xmax, ymin, ymax);
+   s.x0 = c->xpos;
+   s.y0 = c->ypos;
+   s.scale = c->size;
+   s.counting = 0;
+
+   /* Make the file as large as it could need to be (it is cut down to size
+      once the points have been written). */
+   if (binary)
+      header[0] = 0;
+   else
+      tsplib_header(header, sizeof(header), title, n);
+   s.size = strlen(header) + 4 + ((double) n + 1) * TSPLIB_MAX_LINE;
+   if ((double) s.size != strlen(header) + 4 + ((double) n + 1) * TSPLIB_MAX_LINE) {
+      fprintf(stderr, "Error:  the output file would be too large\n");
+      goto DONE;
+   }
+   s.fd = open(outputfilename, O_RDWR|O_CREAT|O_TRUNC, 0644);
+   if (s.fd == -1 || ftruncate(s.fd, s.size) == -1) {
+      fprintf(stderr, "ERROR. Couldn't open outputfile (%s)\n", outputfilename);
+      goto DONE;
+   }
+
+   if (binary) {
+      char count[4];
+      tsplib_put_binary_int((unsigned char *) count, n);
+      stream_write(&s, count, 4);
+   }
+   else
+      stream_write(&s, header, strlen(header));
+
+   /* Expand the rules, writing each point as it is created. */
+   c->stream = &s;
+   reset_turtle(c);
+   c->currentnode = 0;
+   expansion_start(&x, c, order, 0);
+   while ((ret = expandLSys(&x, LSYS_STREAM_CHUNK)) == 1 && !s.failed)
+      ;
+   if (ret < 0 && !c->stackoflow)
+      fprintf(stderr, "Error:  %s\n", x.error);
+   expansion_free(&x);
+
+   if (!binary)
+      stream_write(&s, "EOF:\n", 5);
+   if (ret == 0 && c->currentnode != n) {
+      fprintf(stderr, "Error:  %d points were created instead of %d\n", c->currentnode, n);
+      ret = -1;
+   }
+   if (ret == 0 && s.failed) {
+      fprintf(stderr, "ERROR. Couldn't write to outputfile (%s)\n", outputfilename);
+      ret = -1;
+   }
+   if (!c->lessthanzero && s.negative) {
+      fprintf(stderr,"Warning:  output contains negative numbers\n");
+      c->lessthanzero=1;
+   }
+
+DONE:
+   if (s.window != NULL)
+      munmap(s.window, s.length);
+   if (s.fd != -1) {
+      if (ftruncate(s.fd, s.offset + s.used) == -1 || close(s.fd) == -1)
+	 ret = -1;
+   }
+   c->stream = NULL;
+   if (c->stackoflow)
+   {
+      static char  msg[]={"insufficient memory, try a lower order"};
+      stopmsg(msg);
+      ret = -1;
+   }
+   free_rules_mem(c);
+   free_progs(c);
+
+   gettimeofday(&end, NULL);
+   seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+   if (rate != NULL)
+      *rate = (seconds > 0) ? c->currentnode / seconds : 0;
+   return (ret == 0) ? c->currentnode : -1;
+}
+
+
+int Lsystem(lsys_ctx *c, int order, char *name, char *title, char *outputfilename)
+{
+   FILE *outputfile;
+   lsys_sink sink;
+   int ret;
+
+   outputfile = fopen(outputfilename, "w");
+   if (outputfile == NULL) {
+      fprintf(stderr, "ERROR. Couldn't open outputfile (%s)\n", outputfilename);
+      return -1;
+   }
+
+   text_sink(&sink, outputfile);
+   ret = LsystemSink(c, order, name, title, &sink);
+
+   if (fclose(outputfile) != 0)
+      fprintf(stderr, "ERROR. Couldn't close outputfile (%s)\n", outputfilename);
+
+   return ret;
+}
+
+
+int LsystemSink(lsys_ctx *c, int order, char *name, char *title, lsys_sink *sink)
+{
+   c->currentnode = 0;
+   if (LLoad(c,name,title))
+     return -1;
+
+   if (generate(c, order, sink))
+      return -1;
+
+   return c->currentnode;
+}
+
+
+int LsystemPoints(lsys_ctx *c, int order, const lsystem *ls, lsys_point **points)
+{
+   lsys_sink sink;
+
+   lsys_array_sink(&sink, points);
+   return LsystemPointsSink(c, order, ls, &sink);
+}
+
+
+int LsystemPointsSink(lsys_ctx *c, int order, const lsystem *ls, lsys_sink *sink)
+{
+   c->currentnode = 0;
+
+   if (readLSystem_ls(c,ls)) {
+      free_rules_mem(c);
+      return -1;
+   }
+   init_angles(c);
+
+   if (generate(c, order, sink))
+      return -1;
+
+   return c->currentnode;
+}
+
+int LsystemOrders(lsys_ctx *c, int maxorder, char *name, char *title, lsys_point **points, int *numpoints)
+{
+   if (LLoad(c,name,title))
+     return -1;
+
+   return generate_orders(c, maxorder, points, numpoints);
+}
+
+
+int LsystemPointsOrders(lsys_ctx *c, int maxorder, const lsystem *ls, lsys_point **points, int *numpoints)
+{
+   if (readLSystem_ls(c,ls)) {
+      free_rules_mem(c);
+      return -1;
+   }
+   init_angles(c);
+
+   return generate_orders(c, maxorder, points, numpoints);
+}
+
+int LLoad(lsys_ctx *c, char *name,char *title)
+{
+   if (readLSystemFile(c,name,title)) { /* error occurred */
+      free_rules_mem(c);
+      return -1;
+   }
+   init_angles(c);
    return 0;
 }
 
-static void  free_rules_mem()
+int LsystemIndexSink(lsys_ctx *c, int order, const ls_index *idx, int i, lsys_sink *sink)
+{
+   c->currentnode = 0;
+   if (i < 0 || i >= idx->count)
+      return -1;
+
+   if (readLSystemIndex(c, idx, i)) {
+      free_rules_mem(c);
+      return -1;
+   }
+   init_angles(c);
+
+   if (generate(c, order, sink))
+      return -1;
+
+   return c->currentnode;
+}
+
+lsys_ctx *create_lsys_ctx(void)
+{
+   lsys_ctx *c = (lsys_ctx *) calloc(1, sizeof(lsys_ctx));
+   if (c != NULL)
+      c->cosangle = 1.0; /* (The direction of a 'realangle' of 0.) */
+   return c;
+}
+
+void delete_lsys_ctx(lsys_ctx *c)
+{
+   free(c);
+}
+
+/* Finds the sine and cosine of each direction the turtle can face. */
+static void init_angles(lsys_ctx *c)
+{
+   int i;
+   for(i=0;i<c->maxangle;i++) {
+      c->sins[i]=sin(2*i*PI/c->maxangle);
+      c->coss[i]=cos(2*i*PI/c->maxangle);
+   }
+}
+
+static void  free_rules_mem(lsys_ctx *c)
 {
    int i;
-   for(i=0;i<MAXRULES;++i)
-      if(ruleptrs[i]) free(ruleptrs[i]);
+   for(i=0;i<MAXRULES;++i) {
+      if(c->ruleptrs[i]) free(c->ruleptrs[i]);
+      c->ruleptrs[i]=NULL;
+   }
 }
 
-static int save_rule(char *rule,char  **saveptr)
+static int save_rule(lsys_ctx *c, char *rule,char  **saveptr)
 {
    int i;
    char  *tmp;
    i=strlen(rule)+1;
    if((tmp=malloc((long)i))==NULL) {
-       stackoflow = 1;
+       c->stackoflow = 1;
        return -1;
        }
    *saveptr=tmp;
@@ -576,166 +1966,150 @@ static int save_rule(char *rule,char  **saveptr)
    return 0;
 }
 
-static struct lsys_cmd  *SizeTransform(char  *s)
+/* Makes the table of the rules named by each symbol (see 'firstrule'), so
+   the rules of a symbol can be found without searching every rule. The
+   rules of each symbol are kept in the order they were given. */
+static void index_rules(lsys_ctx *c)
 {
-  struct lsys_cmd  *ret;
-  struct lsys_cmd  *doub;
-  int maxval = 10;
-  int n = 0;
-  void (*f)(double);
-  double num;
+  int i;
+  unsigned char last[256];
+
+  memset(c->firstrule, 0, sizeof(c->firstrule));
+  memset(c->nextrule, 0, sizeof(c->nextrule));
+  for (i=1; i<MAXRULES && c->ruleptrs[i]; i++) {
+    unsigned char ch = (unsigned char) c->ruleptrs[i][0];
+    if (c->firstrule[ch])
+      c->nextrule[last[ch]] = i;
+    else
+      c->firstrule[ch] = i;
+    last[ch] = i;
+  }
+}
 
-  void (*plus)(double) = lsys_doplus;
-  void (*minus)(double) = lsys_dominus;
-  void (*pipe)(double) = lsys_dopipe;
+/* Returns the number of rules named 'ch' and puts their indices (in
+   'ruleptrs') in 'index'. */
+static int findrules(lsys_ctx *c, char ch, unsigned char *index)
+{
+  int i, n = 0;
+
+  for (i=c->firstrule[(unsigned char) ch]; i; i=c->nextrule[i])
+    index[n++] = i;
+  return n;
+}
 
-  void (*slash)(double) =   lsys_doslash;
-  void (*bslash)(double) = lsys_dobslash;
-  void (*at)(double) =      lsys_doat;
-  void (*dogf)(double) =    lsys_dosizegf;
+/* Compiles a rule (without its name) into opcodes. */
+static unsigned char  *compile_rule(lsys_ctx *c, char  *s)
+{
+  unsigned char  *ret;
+  unsigned char  *doub;
+  unsigned char index[MAXRULES];
+  int maxval = 64;
+  int n = 0;
+  int nrules, step;
+  double num;
 
-  ret = (struct lsys_cmd  *) malloc((long) maxval * sizeof(struct lsys_cmd));
+  ret = (unsigned char  *) malloc((long) maxval);
   if (ret == NULL) {
-       stackoflow = 1;
+       c->stackoflow = 1;
        return NULL;
        }
   while (*s) {
-    f = NULL;
-    num = 0;
-    ret[n].ch = *s;
-    switch (*s) {
-      case '+': f = plus;            break;
-      case '-': f = minus;           break;
-      case '/': f = slash;           num = getnumber(&s);break;
-      case '\\': f = bslash;         num = getnumber(&s);    break;
-      case '@': f = at;              num = getnumber(&s);    break;
-      case '|': f = pipe;            break;
-      case '!': f = lsys_dobang;     break;
-      case 'd':
-      case 'm': f = lsys_dosizedm;   break;
-      case 'g':
-      case 'f': f = dogf;       break;
-      case '[': num = 1;        break;
-      case ']': num = 2;        break;
-      default:
-	num = 3;
-	break;
-    }
-    ret[n].f = f;
-    ret[n].n = num;
-    if (++n == maxval) {
-      doub = (struct lsys_cmd  *) malloc((long) maxval*2*sizeof(struct lsys_cmd));
+    /* Make sure the longest command (a list of rules followed by an opcode
+       with a double) fits. */
+    if (n + 2 + MAXRULES + 1 + (int)sizeof(double) > maxval) {
+      doub = (unsigned char  *) realloc(ret, (long) maxval*2);
       if (doub == NULL) {
          free(ret);
-         stackoflow = 1;
+         c->stackoflow = 1;
          return NULL;
          }
-      memcpy(doub, ret, maxval*sizeof(struct lsys_cmd));
-      free(ret);
       ret = doub;
       maxval <<= 1;
     }
-    s++;
-  }
-  ret[n].ch = 0;
-  ret[n].f = NULL;
-  ret[n].n = 0;
-  n++;
-
-  doub = (struct lsys_cmd  *) malloc((long) n*sizeof(struct lsys_cmd));
-  if (doub == NULL) {
-       free(ret);
-       stackoflow = 1;
-       return NULL;
-       }
-  memcpy(doub, ret, n*sizeof(struct lsys_cmd));
-  free(ret);
-  return doub;
-}
-
-static struct lsys_cmd  *DrawTransform(char  *s)
-{
-  struct lsys_cmd  *ret;
-  struct lsys_cmd  *doub;
-  int maxval = 10;
-  int n = 0;
-  void (*f)(double);
-  double num;
-
-  void (*plus)(double) = lsys_doplus;
-  void (*minus)(double) = lsys_dominus;
-  void (*pipe)(double) = lsys_dopipe;
-
-  void (*slash)(double) =   lsys_doslash;
-  void (*bslash)(double) =  lsys_dobslash;
-  void (*at)(double) =      lsys_doat;
-  void (*drawg)(double) =   lsys_dodrawg;
+    if (*s == ']') {
+      ret[n++] = OP_POP;
+      s++;
+      continue;
+    }
 
-  ret = (struct lsys_cmd  *) malloc((long) maxval * sizeof(struct lsys_cmd));
-  if (ret == NULL) {
-       stackoflow = 1;
-       return NULL;
-       }
-  while (*s) {
-    f = NULL;
-    num = 0;
-    ret[n].ch = *s;
+    nrules = findrules(c, *s, index);
+    if (nrules) {
+      ret[n++] = OP_RULES;
+      ret[n++] = nrules;
+      memcpy(ret+n, index, nrules);
+      n += nrules;
+    }
     switch (*s) {
-      case '+': f = plus;                break;
-      case '-': f = minus;               break;
-      case '/': f = slash;               num = getnumber(&s);    break;
-      case '\\': f = bslash;             num = getnumber(&s);   break;
-      case '@': f = at;                  num = getnumber(&s);    break;
-      case '|': f = pipe;                break;
-      case '!': f = lsys_dobang;         break;
-      case 'd': f = lsys_dodrawd;        break;
-      case 'm': f = lsys_dodrawm;        break;
-      case 'g': f = drawg;               break;
-      case 'f': f = lsys_dodrawf;        break;
-      case '[': num = 1;        break;
-      case ']': num = 2;        break;
+      case '+':
+      case '-':
+	step = (*s == '-') ? 1 : c->maxangle - 1;
+	/* Commands which have no rules are always done one after the other,
+	   so they can be combined into one turn. */
+	if (!nrules)
+	  while ((s[1] == '+' || s[1] == '-') && !findrules(c, s[1], index)) {
+	    s++;
+	    step += (*s == '-') ? 1 : c->maxangle - 1;
+	  }
+	step %= c->maxangle;
+	if (step || nrules) {
+	  ret[n++] = OP_TURN;
+	  ret[n++] = step;
+	  ret[n++] = step ? c->maxangle - step : 0;
+	}
+	break;
+      case '/':
+      case '\\':
+      case '@':
+	ret[n++] = (*s == '/') ? OP_SLASH : (*s == '@') ? OP_AT : OP_BSLASH;
+	num = getnumber(&s);
+	memcpy(ret+n, &num, sizeof(num));
+	n += sizeof(num);
+	break;
+      case '|': ret[n++] = OP_PIPE;   break;
+      case '!': ret[n++] = OP_BANG;   break;
+      case 'd': ret[n++] = OP_DRAWD;  break;
+      case 'm': ret[n++] = OP_DRAWM;  break;
+      case 'g': ret[n++] = OP_DRAWG;  break;
+      case 'f': ret[n++] = OP_DRAWF;  break;
+      case '[': ret[n++] = OP_PUSH;   break;
       default:
-	num = 3;
+	if (nrules)
+	  ret[n++] = OP_NOP;
 	break;
     }
-    ret[n].f = f;
-    ret[n].n = num;
-    if (++n == maxval) {
-      doub = (struct lsys_cmd  *) malloc((long) maxval*2*sizeof(struct lsys_cmd));
-      if (doub == NULL) {
-           free(ret);
-           stackoflow = 1;
-           return NULL;
-           }
-      memcpy(doub, ret, maxval*sizeof(struct lsys_cmd));
-      free(ret);
-      ret = doub;
-      maxval <<= 1;
-    }
     s++;
   }
-  ret[n].ch = 0;
-  ret[n].f = NULL;
-  ret[n].n = 0;
-  n++;
-
-  doub = (struct lsys_cmd  *) malloc((long) n*sizeof(struct lsys_cmd));
-  if (doub == NULL) {
-       free(ret);
-       stackoflow = 1;
-       return NULL;
-       }
-  memcpy(doub, ret, n*sizeof(struct lsys_cmd));
-  free(ret);
-  return doub;
+  ret[n++] = OP_END;
+
+  doub = (unsigned char  *) realloc(ret, (long) n);
+  return (doub != NULL) ? doub : ret;
+}
+
+/* Compiles the axiom and every rule in 'c->ruleptrs' into 'c->progs' (see
+   compile_rule()). */
+static void compile_rules(lsys_ctx *c)
+{
+  int i;
+
+  for (i=0; i<MAXRULES; i++)
+    c->progs[i] = NULL;
+  for (i=0; i<MAXRULES && c->ruleptrs[i]; i++) {
+    /* Every rule (except the axiom) starts with the name of the rule. */
+    c->progs[i] = compile_rule(c, c->ruleptrs[i] + (i > 0));
+    if (c->progs[i] == NULL)
+      return;
+  }
 }
 
-static void free_lcmds()
+static void free_progs(lsys_ctx *c)
 {
-  struct lsys_cmd  **sc = rules2;
+  int i;
 
-  while (*sc)
-    free(*sc++);
+  for (i=0; i<MAXRULES; i++) {
+    if (c->progs[i])
+      free(c->progs[i]);
+    c->progs[i] = NULL;
+  }
 }
 
 
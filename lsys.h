@@ -0,0 +1,321 @@
+/**
+ *	\file
+ *	\brief Declares the methods in lsys.c which create the <i>(x,y)</i> points
+ *	described by an L-System.
+ *
+ *	Everything these methods use is kept in an lsys_ctx (there are no global
+ *	variables), so L-Systems can be created in different threads at the same
+ *	time as long as each thread uses its own context.
+ */
+
+#ifndef LSYS_H
+#define LSYS_H
+
+#include <stdio.h>
+
+#include "ls/ls.h"
+#include "ls/ls_index.h"
+
+
+/**
+ *	\brief A point created by an L-System.
+ *
+ *	The label of the point (when written to a TSPlib file) is its position in
+ *	the array of points.
+ */
+typedef struct
+{
+	int x, y;
+} lsys_point;
+
+
+/**
+ *	\brief Where the points created by an L-System are sent.
+ *
+ *	Once the number of points is known, \c begin is called to get an array
+ *	with room for that many points, and the points are put straight into it.
+ *	Then \c end is called to do whatever the sink does with them (e.g. write
+ *	them to a file). So a point costs a couple of integer stores until it
+ *	reaches the sink.
+ *
+ *	Use lsys_array_sink(), lsys_tsplib_sink() or lsys_binary_sink() to set up
+ *	a sink, or fill in the fields to make a new kind of sink.
+ */
+typedef struct lsys_sink lsys_sink;
+struct lsys_sink
+{
+	/**
+	 *	\brief Returns an array with room for \c numpoints points, or \c NULL
+	 *	if there isn't enough memory.
+	 */
+	lsys_point *(*begin)(lsys_sink *sink, int numpoints);
+
+	/**
+	 *	\brief Called once the points are in the array returned by \c begin.
+	 *	Returns \c 0, or \c -1 if the sink failed.
+	 */
+	int (*end)(lsys_sink *sink, lsys_point *points, int numpoints);
+
+	/**
+	 *	\brief Where the sink sends the points (e.g. a \c FILE *).
+	 */
+	void *data;
+
+	/**
+	 *	\brief The name of the instance (used by lsys_tsplib_sink()).
+	 */
+	const char *name;
+};
+
+/**
+ *	\brief Sets up a sink which returns the points in an array.
+ *
+ *	Note: You \e must \c free() the returned array.
+ *
+ *	\param sink   The sink to set up.
+ *	\param points The array of points is returned in this parameter.
+ */
+void lsys_array_sink(lsys_sink *sink, lsys_point **points);
+
+/**
+ *	\brief Sets up a sink which writes the points to a TSPlib file (with the
+ *	\c EUC_2D edge weight type).
+ *
+ *	\param sink The sink to set up.
+ *	\param file The file to write to (which is not closed).
+ *	\param name The name of the instance.
+ */
+void lsys_tsplib_sink(lsys_sink *sink, FILE *file, const char *name);
+
+/**
+ *	\brief Sets up a sink which writes the points to a binary file: the number
+ *	of points followed by the x and y coordinates of each point, each written
+ *	as a 4 byte big-endian integer. This is the binary format \e Concorde reads
+ *	with its \c -b option (see util/tsplib.h).
+ *
+ *	\param sink The sink to set up.
+ *	\param file The file to write to (which is not closed).
+ */
+void lsys_binary_sink(lsys_sink *sink, FILE *file);
+
+
+/**
+ *	\brief The state used to create the points of an L-System (its rules, the
+ *	turtle etc.). A context can be used for any number of L-Systems, but only
+ *	by one thread at a time.
+ */
+typedef struct lsys_ctx lsys_ctx;
+
+/**
+ *	\brief Creates a new context.
+ *
+ *	\return The context, or \c NULL if there isn't enough memory.
+ *	\see delete_lsys_ctx(lsys_ctx *ctx)
+ */
+lsys_ctx *create_lsys_ctx(void);
+
+/**
+ *	\brief Deletes the specified context.
+ *
+ *	\param ctx The context to delete.
+ *	\see create_lsys_ctx()
+ */
+void delete_lsys_ctx(lsys_ctx *ctx);
+
+/**
+ *	\brief Creates a file containing the points described by an L-System which
+ *	is stored in a file. Each line of the created file has the form
+ *	<c>&lt;node ID&gt; &lt;x-coord&gt; &lt;y-coord&gt;</c>.
+ *
+ *	\param ctx            The context to use.
+ *	\param order          The order of the L-System to create.
+ *	\param name           The file containing the L-System.
+ *	\param title          The name of the L-System in the file.
+ *	\param outputfilename The file to write the points to.
+ *	\return The number of points created, or \c -1 if the L-System couldn't be read
+ *	        (or is nested too deeply to be expanded).
+ */
+int Lsystem(lsys_ctx *ctx, int order, char *name, char *title, char *outputfilename);
+
+/**
+ *	\brief Does the same as Lsystem(), except the points are sent to the given
+ *	sink (instead of being written to a file).
+ *
+ *	\param ctx   The context to use.
+ *	\param order The order of the L-System to create.
+ *	\param name  The file containing the L-System.
+ *	\param title The name of the L-System in the file.
+ *	\param sink  Where to send the points.
+ *	\return The number of points created, or \c -1 if the L-System couldn't be read
+ *	        (or is nested too deeply to be expanded) or the sink failed.
+ */
+int LsystemSink(lsys_ctx *ctx, int order, char *name, char *title, lsys_sink *sink);
+
+/**
+ *	\brief Does the same as Lsystem(), except the file written is a TSPlib
+ *	file (or a binary file, see lsys_binary_sink()) and the points are
+ *	written into it while the rules are expanded.
+ *
+ *	The number of points and their bounds are found before the points are
+ *	created (from the net moves of the rules, see LsystemExtents()), so the
+ *	points never have to be kept in memory: the file is mapped into memory a
+ *	window at a time and each point is written straight into it. This is
+ *	meant for orders with millions of points.
+ *
+ *	\param ctx            The context to use.
+ *	\param order          The order of the L-System to create.
+ *	\param name           The file containing the L-System.
+ *	\param title          The name of the L-System in the file.
+ *	\param outputfilename The file to write the points to.
+ *	\param binary         True (1) to write a binary file instead of a TSPlib
+ *	                       file.
+ *	\param rate           The number of points created per second is returned
+ *	                       in this parameter (if it isn't \c NULL).
+ *	\return The number of points created, or \c -1 if the L-System couldn't be read
+ *	        (or is nested too deeply to be expanded) or the file couldn't be
+ *	        written.
+ */
+int LsystemStream(lsys_ctx *ctx, int order, char *name, char *title, char *outputfilename, int binary, double *rate);
+
+/**
+ *	\brief Creates the points described by the given lsystem structure.
+ *
+ *	Unlike Lsystem(), the L-System isn't written to (and read back from) a file
+ *	and the points aren't written to a file either.
+ *
+ *	Note: You \e must \c free() the returned array.
+ *
+ *	\param ctx    The context to use.
+ *	\param order  The order of the L-System to create.
+ *	\param ls     The L-System.
+ *	\param points The array of points created is returned in this parameter.
+ *	\return The number of points created, or \c -1 if the L-System is not valid
+ *	        or is nested too deeply to be expanded (in which case no array is
+ *	        returned).
+ */
+int LsystemPoints(lsys_ctx *ctx, int order, const lsystem *ls, lsys_point **points);
+
+/**
+ *	\brief Does the same as LsystemPoints(), except the points are sent to the
+ *	given sink.
+ *
+ *	\param ctx   The context to use.
+ *	\param order The order of the L-System to create.
+ *	\param ls    The L-System.
+ *	\param sink  Where to send the points.
+ *	\return The number of points created, or \c -1 if the L-System is not valid
+ *	        or is nested too deeply to be expanded, or the sink failed.
+ */
+int LsystemPointsSink(lsys_ctx *ctx, int order, const lsystem *ls, lsys_sink *sink);
+
+/**
+ *	\brief Creates the points of every order (from 1 to \c maxorder) of an
+ *	L-System which is stored in a file.
+ *
+ *	The rules are only expanded once, so this takes about as long as creating
+ *	the largest order on its own (instead of the sum of the time taken to create
+ *	each order).
+ *
+ *	Note: You \e must \c free() each of the returned arrays.
+ *
+ *	\param ctx       The context to use.
+ *	\param maxorder  The largest order to create.
+ *	\param name      The file containing the L-System.
+ *	\param title     The name of the L-System in the file.
+ *	\param points    An array of size \c maxorder. The array of points of order
+ *	                 \e k is returned in <c>points[k-1]</c>.
+ *	\param numpoints An array of size \c maxorder. The number of points of order
+ *	                 \e k is returned in <c>numpoints[k-1]</c>.
+ *	\return \c 0 if the points were created, \c -1 if the L-System couldn't be read
+ *	        (or is nested too deeply to be expanded).
+ */
+int LsystemOrders(lsys_ctx *ctx, int maxorder, char *name, char *title, lsys_point **points, int *numpoints);
+
+/**
+ *	\brief Does the same as LsystemOrders(), except the L-System is given by an
+ *	lsystem structure.
+ *
+ *	\param ctx       The context to use.
+ *	\param maxorder  The largest order to create.
+ *	\param ls        The L-System.
+ *	\param points    An array of size \c maxorder. The array of points of order
+ *	                 \e k is returned in <c>points[k-1]</c>.
+ *	\param numpoints An array of size \c maxorder. The number of points of order
+ *	                 \e k is returned in <c>numpoints[k-1]</c>.
+ *	\return \c 0 if the points were created, \c -1 if the L-System is not valid
+ *	        (or is nested too deeply to be expanded).
+ */
+int LsystemPointsOrders(lsys_ctx *ctx, int maxorder, const lsystem *ls, lsys_point **points, int *numpoints);
+
+/**
+ *	\brief The number of points and the bounds of an order of an L-System,
+ *	before the points are scaled.
+ *
+ *	The bounds are in the units the turtle uses before it is scaled: the turtle
+ *	starts at the origin (which is always inside the bounds) and each step is
+ *	one unit long.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The number of points (this can be too large to fit in an \c int).
+	 */
+	double numpoints;
+
+	/**
+	 *	\brief The bounds of the points (and of the turtle's other moves).
+	 */
+	double xmin, xmax, ymin, ymax;
+} lsys_extent;
+
+/**
+ *	\brief Finds the number of points and the bounds of every order (from 1 to
+ *	\c maxorder) of an L-System, without creating the points.
+ *
+ *	The net move of each rule is found for each depth and direction the turtle
+ *	can start in, and each order is found from the moves of the order below it.
+ *	So the time taken grows with \c maxorder (instead of with the number of
+ *	points), and this can be used for orders which are far too large to
+ *	create. L-Systems which use \c D, \c M, \c / or \c \\ can't be handled
+ *	this way, and their points are created (and thrown away) instead.
+ *
+ *	\param ctx      The context to use.
+ *	\param maxorder The largest order.
+ *	\param ls       The L-System.
+ *	\param extents  An array of size \c maxorder. The number of points and the
+ *	                bounds of order \e k are returned in <c>extents[k-1]</c>.
+ *	\return \c 0, or \c -1 if the L-System is not valid (or its points had to
+ *	        be created and it is nested too deeply to be expanded).
+ */
+int LsystemExtents(lsys_ctx *ctx, int maxorder, const lsystem *ls, lsys_extent *extents);
+
+/**
+ *	\brief Does the same as LsystemSink(), except the L-System is taken from
+ *	a file of L-Systems which has already been opened (with its index).
+ *
+ *	\param ctx   The context to use.
+ *	\param order The order of the L-System to create.
+ *	\param idx   The file of L-Systems (opened by ls_index_open()).
+ *	\param i     The position of the L-System in the file (see ls_index_find()).
+ *	\param sink  Where to send the points.
+ *	\return The number of points created, or \c -1 if the L-System couldn't be read
+ *	        (or is nested too deeply to be expanded) or the sink failed.
+ */
+int LsystemIndexSink(lsys_ctx *ctx, int order, const ls_index *idx, int i, lsys_sink *sink);
+
+/**
+ *	\brief Reads the specified L-System from a file.
+ *
+ *	The L-System is found using the index of the file (see ls/ls_index.h),
+ *	which is built (and stored next to the file) if it is missing or out of
+ *	date. If no L-System in the file is called \c title, the first line of
+ *	the file which contains \c title is searched for instead.
+ *
+ *	\param ctx   The context to use.
+ *	\param name  The file containing the L-System.
+ *	\param title The name of the L-System in the file.
+ *	\return \c 0 if the L-System was read, \c -1 otherwise.
+ */
+int LLoad(lsys_ctx *ctx, char *name, char *title);
+
+#endif
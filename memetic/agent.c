@@ -10,8 +10,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 
 #include "../ls/ls.h"
+#include "../ls/ls_cache.h"
+#include "../lsys.h"
 #include "../util/upper_bound.h"
 #include "../mt19937ar/t_mt19937ar.h"
 
@@ -23,8 +26,6 @@ int names_size;
 
 
 
-#define LINE_LENGTH   160    /* The maximum length of a line in an L-System file.            */
-#define NUM_TSP_ITER   15    /* The number of times to run Concorde on an instance.          */
 #define NUM_F_CHANGED   3    /* The number of 'F's to pertube at any one time.               */
 #define NUM_RAND_INST  10    /* The number of random instances to generate (when pertubing). */
 
@@ -41,11 +42,6 @@ int names_size;
  */
 void createTSPFile(char *in_fname, char *lsname, char *out_fname, int order)
 {
-	/* Compute the x-y coordinates of the instance represented by this L-System. */
-	int numnodes = Lsystem(order, in_fname, lsname, "plots");
-	printf("\nInstance Size: %d\n", numnodes);fflush(stdout);
-
-	/* Now create a valid TSPlib file. */
 	FILE *outfile_stream = fopen(out_fname, "w");
 
 	/* Check that the file has sucessfully been opened */
@@ -55,26 +51,14 @@ void createTSPFile(char *in_fname, char *lsname, char *out_fname, int order)
 		return;
 	}
 
-	/* Build the header file */
-	fprintf(outfile_stream, "NAME: %s\n", lsname);
-	fprintf(outfile_stream, "TYPE: TSP\n");
-	fprintf(outfile_stream, "COMMENT: Created by Farhan Ahammed (farhan.ahammed@studentmail.newcastle.edu.au)\n");
-	fprintf(outfile_stream, "DIMENSION: %d\n", numnodes);
-	fprintf(outfile_stream, "EDGE_WEIGHT_TYPE: EUC_2D\n");
-	fprintf(outfile_stream, "NODE_COORD_TYPE: TWOD_COORDS\n");
-	fprintf(outfile_stream, "NODE_COORD_SECTION:\n");
-
-	/* Add the coordinates of the points in this instance. */
-	FILE *nodefile = fopen("plots", "r");
-	char line[255];
-	while(fgets(line, 255, nodefile) != NULL)
-	{
-		fprintf(outfile_stream, "%s", line);
-	}
-	remove("plots");
-	fclose(nodefile);
-
-	fprintf(outfile_stream, "EOF:\n");
+	/* Compute the x-y coordinates of the instance represented by this L-System,
+	   and write them straight into a valid TSPlib file. */
+	lsys_sink sink;
+	lsys_tsplib_sink(&sink, outfile_stream, lsname);
+	lsys_ctx *ctx = create_lsys_ctx();
+	int numnodes = (ctx != NULL) ? LsystemSink(ctx, order, in_fname, lsname, &sink) : -1;
+	delete_lsys_ctx(ctx);
+	printf("\nInstance Size: %d\n", numnodes);fflush(stdout);
 
 	/* Close the file */
 	int close_error_plot = fclose(outfile_stream);
@@ -482,46 +466,93 @@ void run(lsystem **pop, int size)
  *
  *	One argument is expected. The program is run like this:
  *	\code
- *  <program name> <ifs file>
+ *  <program name> [-b] [-r n] [-R n] [-p x] [-t s] [-T s] [-m n] <ifs file>
  *	\endcode
+ *	The options set how many times \e Concorde is run on each instance (see
+ *	set_sampling()), how long each run may take (see set_run_budget()) and
+ *	whether the instances are given to it in its binary format (see
+ *	set_binary_instances()).
  */
 int main(int argc, char** argv)
 {
 
 	char *filename;
-	if (argc != 2)
+	int c, min_runs = 0, max_runs = 0, binary = 0;
+	double rel_ci = 0, time_limit = 0;
+	int cpu_limit = 0;
+	long memory_limit = 0;
+
+	while ((c = getopt(argc, argv, "br:R:p:t:T:m:")) != -1)
 	{
-		printf("Usage: %s <filename>\n", argv[0]);
+		switch (c)
+		{
+			case 'b':
+				binary = 1;
+				break;
+			case 'r':
+				min_runs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'R':
+				max_runs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'p':
+				rel_ci = strtod(optarg, NULL);
+				break;
+			case 't':
+				time_limit = strtod(optarg, NULL);
+				break;
+			case 'T':
+				cpu_limit = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'm':
+				memory_limit = strtol(optarg, NULL, 10);
+				break;
+		}
+	}
+
+	if (argc - optind != 1)
+	{
+		printf("Usage: %s [-b] [-r n] [-R n] [-p x] [-t s] [-T s] [-m n] <filename>\n", argv[0]);
+		printf(" -b \t Gives Concorde binary files instead of TSPlib files (needs concorde -b).\n");
+		printf(" -r n \t Runs Concorde at least n times on each instance (default 3).\n");
+		printf(" -R n \t Runs Concorde at most n times on each instance (default: the value of -r).\n");
+		printf(" -p x \t Runs Concorde (up to -R times) until the 95%% confidence interval of the\n");
+		printf("      \t average running time is within x times the average, e.g. 0.05 (default 0).\n");
+		printf(" -t s \t Kills Concorde if it runs for more than s seconds (default: no limit).\n");
+		printf(" -T s \t Kills Concorde if it uses more than s seconds of CPU time (default: no limit).\n");
+		printf(" -m n \t Limits Concorde to n megabytes of memory (default: no limit).\n");
+		return 1;
 	}
 	else
-		filename = argv[1];
+		filename = argv[optind];
+
+	if (max_runs == 0) max_runs = min_runs;
+	set_sampling(min_runs, max_runs, rel_ci);
+	set_run_budget(time_limit, cpu_limit, memory_limit);
+	set_binary_instances(binary);
 
-	FILE *fp = fopen(filename,"r");
-	if(fp)
+	if (access(filename, R_OK) == 0)
 	{
-		fclose(fp);
-		/* Create/Empty the file because ls.c only appends to the file. */
-		fp = fopen("temp.l", "w");
-		fclose(fp);
 		/* Load any L-Systems the user specified. */
 		int i, n;
 		lsystem **temp;
-		fp = fopen(filename, "r");
-		n = readfile(fp, &temp, &names);
-		if (fclose(fp)) printf("ERROR: File '%s' could not be closed\n", filename);
+		n = readfile(filename, &temp, &names);
 		names_size = n;
 
 		init_genrand(&pert_rng, time(NULL));
+		ls_cache_open(NULL);
 
 
 		/**
 		int numnodes;
+		lsys_ctx *ctx = create_lsys_ctx();
 		printf("\n");
 		for (i = 0; i < names_size; i++)
 		{
-			numnodes = Lsystem(14, filename, names[i], "plots");
+			numnodes = Lsystem(ctx, 14, filename, names[i], "plots");
 			printf("%s: %d\n", names[i], numnodes);
 		}
+		delete_lsys_ctx(ctx);
 		/**/
 
 
@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 
 #include "../ls/ls_pop.h"
+#include "../ls/ls_cache.h"
 
 /**
  *	\brief The actual data-type of the elements in the population.
@@ -109,8 +110,14 @@ static void seed_population(ls_population *pop, lsystem **temp, int n, int initi
  */
 int main(int argc, char** argv)
 {
-	int num_rules = 0, numparents = 0, rule_size = 10, display_data = 0, verbose = 0;
+	int num_rules = 0, numparents = 0, rule_size = 10, display_data = 0, verbose = 0, num_workers = 1, binary = 0;
 	long number_of_generations = 0;
+	char *cachefile = NULL;
+	int min_runs = 0, max_runs = 0;
+	double rel_ci = 0;
+	double time_limit = 0;
+	int cpu_limit = 0;
+	long memory_limit = 0;
 
 	/* Check if the user gave any of the option arguments. */
 	int c;
@@ -124,22 +131,63 @@ int main(int argc, char** argv)
        This description was obtained from
                      http://www.frech.ch/man/man3p/optopt.3p.html
        (Last Accessed July 15, 2007)                                                */
-	while ((c = getopt (argc, argv, ":dhv")) != -1)
+	while ((c = getopt (argc, argv, ":bdhvj:c:r:R:p:t:T:m:")) != -1)
 	{
 		switch (c)
 		{
+			case 'b':
+				binary = 1;
+				break;
 			case 'd':
 				display_data = 1;
 				break;
 			case 'v':
 				verbose = 1;
 				break;
+			case 'j':
+				num_workers = (int)strtol(optarg, NULL, 10);
+				if (num_workers < 1) num_workers = 1;
+				break;
+			case 'c':
+				cachefile = optarg;
+				break;
+			case 'r':
+				min_runs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'R':
+				max_runs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'p':
+				rel_ci = strtod(optarg, NULL);
+				break;
+			case 't':
+				time_limit = strtod(optarg, NULL);
+				break;
+			case 'T':
+				cpu_limit = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'm':
+				memory_limit = strtol(optarg, NULL, 10);
+				break;
 			case 'h':
 				fprintf(stderr, "Usage: %s [-OPTION] [<#rules per L-System> <initial rule length> <#parents> <#generations>]\n", argv[0]);
+				fprintf(stderr, " -b \t Gives Concorde binary files instead of TSPlib files (needs concorde -b).\n");
 				fprintf(stderr, " -d \t Displays the actual population after each operation.\n");
 				fprintf(stderr, " -v \t Verbose mode. Displays each step this program takes.\n");
+				fprintf(stderr, " -j n \t Computes the fitness of up to n L-Systems at the same time (default 1).\n");
+				fprintf(stderr, " -c f \t Stores the running times of every L-System in the file f (default %s).\n", LS_CACHE_FILE);
+				fprintf(stderr, " -r n \t Runs Concorde at least n times on each instance (default 3).\n");
+				fprintf(stderr, " -R n \t Runs Concorde at most n times on each instance (default: the value of -r).\n");
+				fprintf(stderr, " -p x \t Runs Concorde (up to -R times) until the 95%% confidence interval of the\n");
+				fprintf(stderr, "      \t average running time is within x times the average, e.g. 0.05 (default 0).\n");
+				fprintf(stderr, " -t s \t Kills Concorde if it runs for more than s seconds (default: no limit).\n");
+				fprintf(stderr, " -T s \t Kills Concorde if it uses more than s seconds of CPU time (default: no limit).\n");
+				fprintf(stderr, " -m n \t Limits Concorde to n megabytes of memory (default: no limit).\n");
 				fprintf(stderr, " -h \t Displays this help and exits.\n");
 				return 1;
+			case ':':
+				fprintf(stderr, "Option -%c requires an argument\n", optopt);
+				return 1;
 			case '?':
 				fprintf(stderr, "Ignoring unrecognized option: -%c\n", optopt);
 		}
@@ -150,9 +198,18 @@ int main(int argc, char** argv)
 	if ((argc - optind) < 4)
 	{
 		fprintf(stderr, "ERROR: Expected at least three arguments.\n");
-		fprintf(stderr, "Usage: %s [-d] [-v] [<#rules per L-System> <initial rule length> <#parents> <#generations>]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-b] [-d] [-v] [-j n] [-c f] [-r n] [-R n] [-p x] [-t s] [-T s] [-m n] [<#rules per L-System> <initial rule length> <#parents> <#generations>]\n", argv[0]);
+		fprintf(stderr, " -b \t Gives Concorde binary files instead of TSPlib files.\n");
 		fprintf(stderr, " -d \t To display the actual population after each operation.\n");
 		fprintf(stderr, " -v \t Verbose mode. Displays each step this program takes.\n");
+		fprintf(stderr, " -j n \t Computes the fitness of up to n L-Systems at the same time.\n");
+		fprintf(stderr, " -c f \t Stores the running times of every L-System in the file f.\n");
+		fprintf(stderr, " -r n \t Runs Concorde at least n times on each instance.\n");
+		fprintf(stderr, " -R n \t Runs Concorde at most n times on each instance.\n");
+		fprintf(stderr, " -p x \t Stops running Concorde once the average running time is this precise.\n");
+		fprintf(stderr, " -t s \t Kills Concorde if it runs for more than s seconds.\n");
+		fprintf(stderr, " -T s \t Kills Concorde if it uses more than s seconds of CPU time.\n");
+		fprintf(stderr, " -m n \t Limits Concorde to n megabytes of memory.\n");
 		return 1;
 	}
 	else
@@ -165,6 +222,15 @@ int main(int argc, char** argv)
 	}
 
 
+	/* L-Systems which have been evaluated before (by any run) don't need to be
+	   evaluated again. */
+	ls_cache_open(cachefile);
+	if (max_runs == 0) max_runs = min_runs;
+	set_sampling(min_runs, max_runs, rel_ci);
+	set_run_budget(time_limit, cpu_limit, memory_limit);
+	set_binary_instances(binary);
+
+
 	/* The variables needed for predicting the completion times. */
 	time_t start_time = time (NULL), curtime, predict_finish, predict_nextpercent;
 	double elapsedtime, time_interval;
@@ -190,6 +256,7 @@ int main(int argc, char** argv)
 	datatype *pop;
 	if (verbose) { printf("Creating population..."); fflush(stdout); }
 	createPopulation(&pop, numparents, num_rules, rule_size);
+	pop->num_workers = num_workers;
 	if (verbose) { printf("done.\n"); }
 
 	if (verbose) { printf("Assigning Random values..."); fflush(stdout); }
@@ -198,17 +265,16 @@ int main(int argc, char** argv)
 
 	/* Check if we should seed the population. */
 	if (verbose) { printf("Should we seed the population?..."); fflush(stdout); }
-	FILE *seedfp = fopen("seed.txt", "r");
-	if (seedfp != NULL)
+	if (access("seed.txt", R_OK) == 0)
 	{
 		if (verbose) { printf("yes.\n"); }
 		if (verbose) { printf("Adding L-Systems to the population..."); fflush(stdout); }
 		int n;
 		lsystem **temp;
-		n = readfile(seedfp, &temp, NULL);
+		/* (The index of seed.txt is kept in seed.txt.idx.) */
+		n = readfile("seed.txt", &temp, NULL);
 
 		if (n > 0) seed_population(pop, temp, n, rule_size);
-		if (fclose(seedfp)) printf("ERROR: File 'seed.txt' could not be closed\n");
 		if (verbose) { printf("done.\n"); }
 
 	}
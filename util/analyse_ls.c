@@ -10,17 +10,35 @@
  *	The user can also find the average running times and number of branch
  *	and bound nodes used by \e Concorde (for any order of the L-System).
  *
- *	\e Concorde is run 15 times on each instance when computing the average
- *	and standard deviation.
+ *	By default, \e Concorde is run 15 times on each instance when computing the
+ *	average and standard deviation. The options \c -r, \c -R and \c -p change
+ *	this (see sampling.h), e.g. to keep running \e Concorde only until the
+ *	average running time is known precisely enough.
+ *
+ *	The results are kept in the cache file #LS_CACHE_FILE (see ls_cache.h), so
+ *	\e Concorde isn't run again on instances which have already been solved
+ *	enough times (by this program, \c evoalg or \c agent). \e Concorde is run
+ *	the same way fitness() runs it (see run_concorde()), so the results in the
+ *	cache can be shared. The options \c -t, \c -T and \c -m give each run a
+ *	budget, as they do for \c evoalg.
  *
  *	\author Farhan Ahammed (faha3615@mail.usyd.edu.au)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <unistd.h>
 
+#include "../lsys.h"
+#include "../ls/ls_cache.h"
+#include "../ls/ls_index.h"
 #include "../util/upper_bound.h"
+#include "../util/sampling.h"
+#include "../util/launch.h"
+#include "../util/workspace.h"
+#include "../util/tsplib.h"
 #include "../mt19937ar/t_mt19937ar.h"
 
 
@@ -28,63 +46,6 @@
 #define NUM_TSP_ITER       15
 
 
-/**
- *	\brief Plots the lsystem structure (\c ls) with \c plotsize
- *	nodes in the instance, runs \e Concorde on the instance and returns the time
- *	taken to solve it.
- *
- *	\param filename    The TSPlib file to make \e Concorde try to solve.
- *	\param runtime     The running time is returned in this parameter.
- *	\param numbbnodes  The number of branch and bound nodes created is returned
- *	                   in this parameter.
- */
-void runtime_bbnodes(char *filename, double *runtime, int *numbbnodes) {
-	/* Create and open a pipe to the concorde program. */
-	FILE *concorde_pipe;
-	char *command;
-	asprintf(&command, "concorde %s", filename);
-	concorde_pipe = popen(command, "r");
-	if (concorde_pipe == NULL)
-	{
-		fprintf(stderr, "Could not open concorde pipe\n");
-		exit(1);
-	}
-
-	int nbytes = 810;
-	char *concorde_output = (char *)malloc(nbytes + 1), *pos;
-	int bytesread;
-
-	/* Run concorde and get the output */
-	double rtime = 0;
-	int bbnodes = 0;
-	bytesread = getdelim(&concorde_output, &nbytes, "\n\n", concorde_pipe);
-
-	/* I could have used my own timer, but the Concorde program already
-	   outputs this information. So I decided to use their definition of
-	   Concorde's running time.                                          */
-
-	/* If there is no '?' in the output, something went wrong. Since we're
-	   only interested in instances that make it work (and are difficult for it)
-	   we will return 0 and so it has a weak fitness value.                      */
-	pos = strchr(concorde_output, '?');
-	if (pos != NULL)
-		rtime = strtod(pos+1, NULL);
-
-	pos = strchr(concorde_output, '&');
-	if (pos != NULL)
-		bbnodes = (int)strtol(pos+1, NULL, 10);
-
-	if (pclose(concorde_pipe) == -1)
-	{
-		fprintf(stderr, "Could not close concorde pipe\n");
-	}
-	free(concorde_output);
-
-	if (runtime    != NULL) *runtime    = rtime;
-	if (numbbnodes != NULL) *numbbnodes = bbnodes;
-}
-
-
 /**
  *	\brief Obtains the user's input from \c stdin which should be an int.
  *
@@ -108,30 +69,56 @@ int getnum()
 
 
 /**
- *	\brief Computes the square root of the given double.
- *
- *	This code was obtained from: http://www.azillionmonkeys.com/qed/sqroot.html<br>
- *	Last Accessed January 24, 2008.
+ *	\brief How many times \e Concorde is run on each instance (see
+ *	sampling.h). This can be changed using the command line options.
+ */
+static sampling_plan plan = {NUM_TSP_ITER, NUM_TSP_ITER, 0};
+
+
+/**
+ *	\brief Runs \e Concorde on the given TSPlib file until the average running
+ *	time and number of branch and bound nodes it uses are known precisely
+ *	enough (see #plan).
  *
- *	\param y  The double to compute the square root of.
- *	\return The square root of y.
+ *	\param filename  The filename of the TSPlib for \e Concorde to solve.
+ *	\param stats     The results of any earlier runs. The new runs are added to
+ *	                 these results.
+ *	\param verbose   Set to true (1) to display the running time and the number
+ *	                 of branch and bound nodes used for each time \e Concorde is run.
  */
-double fastsqrt (double y) {
-	double x, z, tempf;
-	unsigned long *tfptr = ((unsigned long *)&tempf) + 1;
-
-	tempf = y;
-	*tfptr = (0xbfcdd90a - *tfptr)>>1; /* estimate of 1/sqrt(y) */
-	x =  tempf;
-	z =  y*0.5;                        /* hoist out the "/2"    */
-	x = (1.5*x) - (x*x)*(x*z);         /* iteration formula     */
-	x = (1.5*x) - (x*x)*(x*z);
-	x = (1.5*x) - (x*x)*(x*z);
-	x = (1.5*x) - (x*x)*(x*z);
-	x = (1.5*x) - (x*x)*(x*z);
-	return x*y;
-}
+static void sample_runtime_bbnodes(char *filename, sample_stats *stats, int verbose)
+{
+	concorde_run run;
 
+	while (!sample_done(stats, &plan))
+	{
+		run_concorde(filename, &run);
+		if (run.censored)
+		{
+			sample_censor(stats, run.runtime, run.bbnodes);
+			if (verbose)
+				printf("RT%2d: >= %0.3f (over budget)\n", stats->n, run.runtime);
+		}
+		else if (run.outofmemory)
+		{
+			sample_out_of_memory(stats, run.runtime, run.bbnodes);
+			if (verbose)
+				printf("RT%2d: Ran out of memory (status %d)\n", stats->n, run.status);
+		}
+		else if (!run.finished)
+		{
+			sample_fail(stats);
+			if (verbose)
+				printf("RT%2d: Failed (status %d)\n", stats->n + 1, run.status);
+		}
+		else
+		{
+			sample_add(stats, run.runtime, run.bbnodes);
+			if (verbose)
+				printf("RT%2d: %0.3f\tBB: %d\tCPU: %0.3fu %0.3fs\tRSS: %ldK\n", stats->n, run.runtime, run.bbnodes, run.user, run.sys, run.maxrss);
+		}
+	}
+}
 
 
 /**
@@ -151,45 +138,109 @@ double fastsqrt (double y) {
  */
 void avg_runtime_bbnodes(char *filename, double *avg_rt, double *sd_rt, double *avg_bb, double *sd_bb, int verbose)
 {
-	int i, j, bb;
-	double rt, n, Vrt, Vbb, delta_rt, delta_bb;
-	double _avg_rt, _sd_rt, _avg_bb, _sd_bb;
+	sample_stats stats;
+
+	sample_init(&stats);
+	sample_runtime_bbnodes(filename, &stats, verbose);
 
-	n = _avg_rt = _avg_bb = Vrt = Vbb = 0;
-	for (j = 0; j < NUM_TSP_ITER; j++)
+	if (avg_rt != NULL) *avg_rt = stats.mean;
+	if (avg_bb != NULL) *avg_bb = stats.mean_bb;
+	if (sd_rt  != NULL) *sd_rt  = sample_sd(&stats);
+	if (sd_bb  != NULL) *sd_bb  = sample_sd_bb(&stats);
+}
+
+
+
+/**
+ *	\brief Returns the canonical hash (see ls_hash()) of the specified L-System,
+ *	which is used to find the results of any previous runs in the cache.
+ *
+ *	\param lsysfile The file containing the L-System.
+ *	\param lsname   The name of the L-System.
+ *	\return The hash of the L-System, or \c 0 if it couldn't be read.
+ */
+static unsigned long long find_hash(const char *lsysfile, const char *lsname)
+{
+	unsigned long long hash = 0;
+	ls_index idx;
+	int i;
+
+	/* The hash is stored in the index, so the L-System doesn't need to be read. */
+	if (ls_index_open(&idx, lsysfile, ls_text_hash))
+		return 0;
+	i = ls_index_find(&idx, lsname);
+	if (i >= 0)
+		hash = ls_index_hash(&idx, i);
+	ls_index_close(&idx);
+
+	return hash;
+}
+
+
+/**
+ *	\brief The same as avg_runtime_bbnodes(), except the results of any previous
+ *	runs (by this or any other program) on the same instance are used.
+ *	\e Concorde is only run if those results aren't precise enough, and the new
+ *	runs are added to them. New results are added to the cache, unless a run
+ *	went over its budget (see sample_stats::censored).
+ *
+ *	\param hash     The canonical hash of the L-System (or \c 0 to not use the cache).
+ *	\param order    The order of the instance.
+ *	\param size     The size of the instance.
+ *	\param filename The filename of the TSPlib for \e Concorde to solve.
+ *	\param avg_rt   The average running time is returned in this parameter.
+ *	\param sd_rt    The standard deviation of the running times is returned in this parameter.
+ *	\param avg_bb   The average number of branch and bound nodes is returned in this parameter.
+ *	\param sd_bb    The standard deviation of the number of branch and bound nodes is
+ *	                returned in this parameter.
+ *	\param verbose  Set to true (1) to display the result of each run.
+ *	\return \c 1 if a run went over its time budget (see set_run_budget()), in
+ *	        which case the average running time is only a lower bound, \c 0
+ *	        otherwise.
+ */
+static int cached_runtime_bbnodes(unsigned long long hash, int order, int size, char *filename, double *avg_rt, double *sd_rt, double *avg_bb, double *sd_bb, int verbose)
+{
+	ls_cache_entry entry;
+	sample_stats stats;
+	int nruns = 0;
+
+	sample_init(&stats);
+	if ((hash != 0) && ls_cache_lookup(hash, order, &entry) && (entry.instancesize == size) && (entry.nruns > 0))
 	{
-		runtime_bbnodes(filename, &rt, &bb);
-		if (verbose) printf("RT%2d: %0.3f\tBB: %d\n", j+1, rt, bb);
-		n++;
-
-		/* This calculation is used to compute the SD for the average running times. */
-		delta_rt = rt - _avg_rt;
-		_avg_rt += delta_rt/n;
-		Vrt += delta_rt*(rt - _avg_rt); /* NOTE: This expression uses the new value of _avg_rt. */
-
-		/* This calculation is used to compute the SD for the number of branch and bound nodes. */
-		delta_bb = bb - _avg_bb;
-		_avg_bb += delta_bb/n;
-		Vbb += delta_bb*(bb - _avg_bb); /* NOTE: This expression uses the new value of _avg_bb. */
+		if (verbose) printf("Using the results of %d earlier runs\n", entry.nruns);
+		sample_restore(&stats, entry.nruns, entry.runningtime, entry.sd, entry.avgbbnodes, entry.sdbbnodes, entry.censored);
+		nruns = entry.nruns;
 	}
 
-	Vrt = Vrt/(n - 1);
-	Vbb = Vbb/(n - 1);
-	_sd_rt = fastsqrt(Vrt);
-	_sd_bb = fastsqrt(Vbb);
+	sample_runtime_bbnodes(filename, &stats, verbose);
+
+	*avg_rt = stats.mean;
+	*sd_rt  = sample_sd(&stats);
+	*avg_bb = stats.mean_bb;
+	*sd_bb  = sample_sd_bb(&stats);
 
-	if (avg_rt != NULL) *avg_rt = _avg_rt;
-	if (avg_bb != NULL) *avg_bb = _avg_bb;
-	if (sd_rt  != NULL) *sd_rt  = _sd_rt;
-	if (sd_bb  != NULL) *sd_bb  = _sd_bb;
+	if ((hash != 0) && (stats.n > nruns) && !stats.censored && !stats.outofmemory && !stats.failed)
+	{
+		entry.hash = hash;
+		entry.order = order;
+		entry.instancesize = size;
+		entry.nruns = stats.n;
+		entry.runningtime = *avg_rt;
+		entry.sd = *sd_rt;
+		entry.avgbbnodes = *avg_bb;
+		entry.sdbbnodes = *sd_bb;
+		entry.censored = stats.censored;
+		ls_cache_store(&entry);
+	}
+	return stats.censored;
 }
 
 
 
 /**
  *	\brief Creates NUM_TEST_INSTANCES TSPlib files representing the L-System
- *	stored in the given file. The files are created in the current directory.
- *	The names of each file are returned in the array \c filenames.
+ *	stored in the given file. The files are created in the given workspace.
+ *	The paths of each file are returned in the array \c filenames.
  *
  *	You \e must delete the individual strings and the array itself when finished
  *	with them.
@@ -201,57 +252,37 @@ void avg_runtime_bbnodes(char *filename, double *avg_rt, double *sd_rt, double *
  *	\param numInstances  The number of instances to create.
  *	\param lsysfile      The file containing the L-System to use, to generate the TSPlib files.
  *	\param lsname        The name of the L-System to use.
+ *	\param ws            The workspace to create the files in.
  */
-void createTSPFiles(char ***filenames, int **numnodes, int numInstances, const char *lsysfile, const char *lsname)
+static void createTSPFiles(char ***filenames, int **numnodes, int numInstances, const char *lsysfile, const char *lsname, const workspace *ws)
 {
 	char **fnames  = (char **)malloc(sizeof(char *) * numInstances);
 	int *num_nodes =   (int *)malloc(sizeof(int)    * numInstances);
+	lsys_point *points[numInstances];
+	char name[16];
 
+	/* Compute the x-y coordinates of the instances (of every order) represented by this L-System. */
 	int i;
-	for (i = 0; i < numInstances; i++)
+	lsys_ctx *ctx = create_lsys_ctx();
+	if ((ctx == NULL) || LsystemOrders(ctx, numInstances, (char *)lsysfile, (char *)lsname, points, num_nodes))
 	{
-		asprintf(&fnames[i], "plot_%d", i+1);
-
-		/* Compute the x-y coordinates of the instance represented by this L-System. */
-		num_nodes[i] = Lsystem(i + 1, lsysfile, lsname, "plots");
-
-		/* Now create a valid TSPlib file. */
-		FILE *outfile_stream = fopen(fnames[i], "w");
-
-		/* Check that the file has sucessfully been opened */
-		if (outfile_stream == NULL)
-		{
-			printf("ERROR: File '%s' could not be opened\n", fnames[i]);
-			return;
-		}
-
-		/* Build the header file */
-		fprintf(outfile_stream, "NAME: %s\n", lsname);
-		fprintf(outfile_stream, "TYPE: TSP\n");
-		fprintf(outfile_stream, "COMMENT: Created by Farhan Ahammed (farhan.ahammed@studentmail.newcastle.edu.au)\n");
-		fprintf(outfile_stream, "DIMENSION: %d\n", num_nodes[i]);
-		fprintf(outfile_stream, "EDGE_WEIGHT_TYPE: EUC_2D\n");
-		fprintf(outfile_stream, "NODE_COORD_TYPE: TWOD_COORDS\n");
-		fprintf(outfile_stream, "NODE_COORD_SECTION:\n");
-
-		/* Add the coordinates of the points in this instance. */
-		FILE *nodefile = fopen("plots", "r");
-		char line[255];
-		while(fgets(line, 255, nodefile) != NULL)
+		for (i = 0; i < numInstances; i++)
 		{
-			fprintf(outfile_stream, "%s", line);
+			num_nodes[i] = -1;
+			points[i] = NULL;
 		}
-		fclose(nodefile);
-		remove("plots");
+	}
+	delete_lsys_ctx(ctx);
 
-		fprintf(outfile_stream, "EOF:\n");
+	for (i = 0; i < numInstances; i++)
+	{
+		sprintf(name, "plot_%d", i+1);
+		fnames[i] = workspace_file(ws, name);
 
-		/* Close the file */
-		int close_error_plot = fclose(outfile_stream);
-		if (close_error_plot)
-		{
-			printf("ERROR: File '%s' could not be closed\n", fnames[i]);
-		}
+		/* Now create a valid TSPlib file. */
+		if (write_tsplib(fnames[i], lsname, points[i], num_nodes[i]))
+			printf("ERROR: File '%s' could not be written\n", fnames[i]);
+		free(points[i]);
 	}
 
 
@@ -272,39 +303,22 @@ void createTSPFiles(char ***filenames, int **numnodes, int numInstances, const c
  */
 int createOneTSPFile(char *filename, int order, const char *lsysfile, const char *lsname)
 {
-	/* Compute the x-y coordinates of the instance represented by this L-System. */
-	int numnodes = Lsystem(order, lsysfile, lsname, "plots");
-
-	/* Now create a valid TSPlib file. */
 	FILE *outfile_stream = fopen(filename, "w");
 
 	/* Check that the file has sucessfully been opened */
 	if (outfile_stream == NULL)
 	{
 		printf("ERROR: File '%s' could not be opened\n", filename);
-		return;
-	}
-
-	/* Build the header file */
-	fprintf(outfile_stream, "NAME: %s\n", lsname);
-	fprintf(outfile_stream, "TYPE: TSP\n");
-	fprintf(outfile_stream, "COMMENT: Created by Farhan Ahammed (farhan.ahammed@studentmail.newcastle.edu.au)\n");
-	fprintf(outfile_stream, "DIMENSION: %d\n", numnodes);
-	fprintf(outfile_stream, "EDGE_WEIGHT_TYPE: EUC_2D\n");
-	fprintf(outfile_stream, "NODE_COORD_TYPE: TWOD_COORDS\n");
-	fprintf(outfile_stream, "NODE_COORD_SECTION:\n");
-
-	/* Add the coordinates of the points in this instance. */
-	FILE *nodefile = fopen("plots", "r");
-	char line[255];
-	while(fgets(line, 255, nodefile) != NULL)
-	{
-		fprintf(outfile_stream, "%s", line);
+		return -1;
 	}
-	fclose(nodefile);
-	remove("plots");
 
-	fprintf(outfile_stream, "EOF:\n");
+	/* Compute the x-y coordinates of the instance represented by this L-System,
+	   and write them straight into a valid TSPlib file. */
+	lsys_sink sink;
+	lsys_tsplib_sink(&sink, outfile_stream, lsname);
+	lsys_ctx *ctx = create_lsys_ctx();
+	int numnodes = (ctx != NULL) ? LsystemSink(ctx, order, (char *)lsysfile, (char *)lsname, &sink) : -1;
+	delete_lsys_ctx(ctx);
 
 	/* Close the file */
 	int close_error_plot = fclose(outfile_stream);
@@ -332,11 +346,15 @@ void find_fitness(const char *filename, const char *lsname)
 	int *instancesize;
 	char **filenames;
 	double avg_rt, sd_rt, avg_bb, sd_bb;
+	unsigned long long hash = find_hash(filename, lsname);
+	workspace ws;
 
-	createTSPFiles(&filenames, &instancesize, NUM_TEST_INSTANCES, filename, lsname);
+	if (create_workspace(&ws))
+		return;
+	createTSPFiles(&filenames, &instancesize, NUM_TEST_INSTANCES, filename, lsname, &ws);
 
 	/* Create a plot of the running times. */
-	int i;
+	int i, censored;
 	data_point points[NUM_TEST_INSTANCES];
 	printf("Creating instances of different sizes and running Concorde on them\n");
 	printf("Order\tInstance Size\tAvg. Run Time\tAvg. BB Nodes\n----------------------------------------------------------------------\n");
@@ -346,19 +364,20 @@ void find_fitness(const char *filename, const char *lsname)
 		printf(" %d\t %d\t\t", i+1, instancesize[i]);
 		fflush(stdout);
 
-		avg_runtime_bbnodes(filenames[i], &avg_rt, &sd_rt, &avg_bb, &sd_bb, 0);
+		censored = cached_runtime_bbnodes(hash, i + 1, instancesize[i], filenames[i], &avg_rt, &sd_rt, &avg_bb, &sd_bb, 0);
 
-		printf(" %7.4f (%7.4f)\t%7.4f (%7.4f)\n", avg_rt, sd_rt, avg_bb, sd_bb);
+		printf(" %7.4f (%7.4f)\t%7.4f (%7.4f)%s\n", avg_rt, sd_rt, avg_bb, sd_bb, censored ? "\t(over budget)" : "");
 		fflush(stdout);
 
 		points[i].x = instancesize[i];
 		points[i].y = avg_rt;
+		points[i].censored = censored;
 
 		free(filenames[i]);
 	}
 	free(instancesize);
 	free(filenames);
-	system("rm -f Oplot* plot*");
+	delete_workspace(&ws);
 	printf("\n");
 
 	/* Compute the upper bound of the running times of the plots of different sizes. */
@@ -429,7 +448,8 @@ void find_runtime(const char *filename, const char *lsname)
 	numcities = createOneTSPFile(tspname, order, filename, lsname);
 	printf("Number of Cities: %d\n", numcities); fflush(stdout);
 
-	avg_runtime_bbnodes(tspname, &avg_rt, &sd_rt, &avg_bb, &sd_bb, 1);
+	if (cached_runtime_bbnodes(find_hash(filename, lsname), order, numcities, tspname, &avg_rt, &sd_rt, &avg_bb, &sd_bb, 1))
+		printf("Went over the time budget, so the average is only a lower bound\n");
 	system("mv *.sol solution");
 	system("rm *plot* *temp*");
 	printf("\n");
@@ -454,13 +474,52 @@ void find_runtime(const char *filename, const char *lsname)
 int main(int argc, char** argv)
 {
 	char text[4];
-	int choice;
+	int choice, c, max_runs = 0, cpu_limit = 0;
+	double time_limit = 0;
+	long memory_limit = 0;
+
+	while ((c = getopt(argc, argv, "r:R:p:t:T:m:")) != -1)
+	{
+		switch (c)
+		{
+			case 'r':
+				plan.min_runs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'R':
+				max_runs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'p':
+				plan.rel_ci = strtod(optarg, NULL);
+				break;
+			case 't':
+				time_limit = strtod(optarg, NULL);
+				break;
+			case 'T':
+				cpu_limit = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'm':
+				memory_limit = strtol(optarg, NULL, 10);
+				break;
+		}
+	}
+	if (plan.min_runs < 1) plan.min_runs = 1;
+	plan.max_runs = (max_runs < plan.min_runs) ? plan.min_runs : max_runs;
 
-	if (argc != 3)
+	if (argc - optind != 2)
 	{
-		printf("usage:\n%s <L-System file> <L-System name>", argv[0]);
+		printf("usage:\n%s [-r n] [-R n] [-p x] [-t s] [-T s] [-m n] <L-System file> <L-System name>\n", argv[0]);
+		printf(" -r n \t Runs Concorde at least n times on each instance (default %d).\n", NUM_TSP_ITER);
+		printf(" -R n \t Runs Concorde at most n times on each instance (default: the value of -r).\n");
+		printf(" -p x \t Runs Concorde (up to -R times) until the 95%% confidence interval of the\n");
+		printf("      \t average running time is within x times the average, e.g. 0.05 (default 0).\n");
+		printf(" -t s \t Kills Concorde if it runs for more than s seconds (default: no limit).\n");
+		printf(" -T s \t Kills Concorde if it uses more than s seconds of CPU time (default: no limit).\n");
+		printf(" -m n \t Limits Concorde to n megabytes of memory (default: no limit).\n");
 		return 0;
 	}
+	argv += optind - 1;
+	set_run_budget(time_limit, cpu_limit, memory_limit);
+	ls_cache_open(NULL);
 
 	printf("Do you want to:\n");
 	printf("[1] Find an upper bound and compute the fitness, or\n");
@@ -0,0 +1,372 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the header file launch.h
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "launch.h"
+
+
+/**
+ *	\brief The signals which are passed on to \e Concorde. It is in its own
+ *	process group, so it doesn't get the ones sent to ours (e.g. by Ctrl-C).
+ */
+static const int forwarded_signals[] = { SIGINT, SIGTERM, SIGHUP };
+#define NUM_FORWARDED (int)(sizeof(forwarded_signals)/sizeof(forwarded_signals[0]))
+
+/**
+ *	\brief The fraction of its memory budget a run must have used (its maximum
+ *	resident set size) before its failure is put down to running out of memory.
+ */
+#define OOM_RSS_FRACTION 0.75
+
+/**
+ *	\brief The process group of the \e Concorde being run (0 if none is), and
+ *	the actions the forwarded signals had before it was started.
+ */
+static volatile sig_atomic_t concorde_group = 0;
+static struct sigaction saved_actions[NUM_FORWARDED];
+
+
+/**
+ *	\brief Passes a signal on to \e Concorde's process group, then handles it
+ *	the way it would have been handled if \e Concorde wasn't running.
+ */
+static void forward_signal(int sig)
+{
+	int i;
+
+	if (concorde_group > 0)
+		kill(-concorde_group, sig);
+	for (i = 0; i < NUM_FORWARDED; i++)
+		if (forwarded_signals[i] == sig)
+			sigaction(sig, &saved_actions[i], NULL);
+	raise(sig);
+}
+
+
+/**
+ *	\brief Returns the number of seconds from \c start to \c end.
+ */
+static double seconds(const struct timeval *start, const struct timeval *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_usec - start->tv_usec)/1000000.0;
+}
+
+
+/**
+ *	\brief Turns the (child) process into \e Concorde. This never returns.
+ *
+ *	\param dir    The directory to run \e Concorde in (or \c NULL to stay in the
+ *	              current directory).
+ *	\param file   The TSPlib file (relative to \c dir).
+ *	\param seed   The random seed (negative if none is given).
+ *	\param binary True (1) if the file is in \e Concorde's binary format.
+ *	\param budget The limits of the run (or \c NULL).
+ *	\param out    The end of the pipe \e Concorde should write its result record
+ *	              to (its \c -j option). Its usual output is thrown away.
+ *	\param mask   The signal mask \e Concorde should start with.
+ */
+static void exec_concorde(const char *dir, const char *file, int seed, int binary, const run_budget *budget, int out, const sigset_t *mask)
+{
+	struct rlimit limit;
+	unsigned long long bytes;
+	char seedstr[16], fdstr[16];
+	char *args[8];
+	int null, n = 0;
+
+	/* Concorde gets its own process group, so that anything it starts is
+	   killed along with it. */
+	setpgid(0, 0);
+	sigprocmask(SIG_SETMASK, mask, NULL);
+
+	null = open("/dev/null", O_WRONLY);
+	if ((null == -1) || (dup2(null, STDOUT_FILENO) == -1))
+		_exit(127);
+	close(null);
+
+	if ((dir != NULL) && (chdir(dir) == -1))
+		_exit(127);
+
+	if (budget != NULL)
+	{
+		/* SIGXCPU is sent once the CPU limit is reached and SIGKILL a second
+		   later, in case SIGXCPU is caught. */
+		if (budget->cpu > 0)
+		{
+			limit.rlim_cur = budget->cpu;
+			limit.rlim_max = budget->cpu + 1;
+			setrlimit(RLIMIT_CPU, &limit);
+		}
+		if (budget->memory > 0)
+		{
+			/* (rlim_t is only 32 bits in a 32-bit build, so the limit is
+			   computed in 64 bits, and a larger one is no limit.) */
+			bytes = (unsigned long long)budget->memory*1024*1024;
+			limit.rlim_cur = limit.rlim_max = (bytes < (unsigned long long)RLIM_INFINITY) ? (rlim_t)bytes : RLIM_INFINITY;
+			setrlimit(RLIMIT_AS, &limit);
+		}
+	}
+
+	snprintf(fdstr, sizeof(fdstr), "%d", out);
+	args[n++] = "concorde";
+	args[n++] = "-j";
+	args[n++] = fdstr;
+	if (seed >= 0)
+	{
+		snprintf(seedstr, sizeof(seedstr), "%d", seed);
+		args[n++] = "-s";
+		args[n++] = seedstr;
+	}
+	if (binary)
+		args[n++] = "-b";
+	args[n++] = (char *)file;
+	args[n] = NULL;
+	execvp("concorde", args);
+
+	fprintf(stderr, "Could not run concorde\n");
+	_exit(127);
+}
+
+
+/**
+ *	\brief Returns the number given for \c key in the result record written by
+ *	\e Concorde (0 if the record doesn't contain the key).
+ */
+static double record_value(const char *record, const char *key)
+{
+	char pattern[32];
+	const char *pos;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	pos = strstr(record, pattern);
+	if (pos == NULL)
+		return 0;
+	return strtod(pos + strlen(pattern), NULL);
+}
+
+
+int launch_concorde(const char *filename, int seed, int binary, const run_budget *budget, concorde_run *run)
+{
+	struct timeval start, now;
+	struct rusage usage;
+	struct pollfd pfd;
+	struct sigaction action;
+	sigset_t forwarded, oldmask;
+	char *dir = NULL, *output, *bigger;
+	const char *file = filename, *slash;
+	int fds[2], timeout, ready, killed = 0, lost, forwarding[NUM_FORWARDED], i;
+	double cpu;
+	size_t len = 0, size = 1024;
+	ssize_t n;
+	pid_t pid, reaped;
+
+	memset(run, 0, sizeof(concorde_run));
+
+	/* Concorde creates its files in the current directory, so it is run in the
+	   directory that contains the TSPlib file. */
+	slash = strrchr(filename, '/');
+	if (slash != NULL)
+	{
+		dir = strndup(filename, (slash == filename) ? 1 : slash - filename);
+		file = slash + 1;
+	}
+
+	if (pipe(fds) == -1)
+	{
+		free(dir);
+		return -1;
+	}
+
+	/* The signals Concorde should get are held back until we are ready to pass
+	   them on, so none is lost between starting it and doing that. */
+	sigemptyset(&forwarded);
+	for (i = 0; i < NUM_FORWARDED; i++)
+		sigaddset(&forwarded, forwarded_signals[i]);
+	sigprocmask(SIG_BLOCK, &forwarded, &oldmask);
+
+	gettimeofday(&start, NULL);
+	pid = fork();
+	if (pid == -1)
+	{
+		sigprocmask(SIG_SETMASK, &oldmask, NULL);
+		close(fds[0]);
+		close(fds[1]);
+		free(dir);
+		return -1;
+	}
+	if (pid == 0)
+	{
+		close(fds[0]);
+		exec_concorde(dir, file, seed, binary, budget, fds[1], &oldmask);
+	}
+	setpgid(pid, pid); /* (In case the child hasn't done it yet.) */
+	close(fds[1]);
+	free(dir);
+
+	/* Pass the signals on (unless we ignore them), so Concorde doesn't keep
+	   running once we are gone. */
+	concorde_group = pid;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = forward_signal;
+	sigemptyset(&action.sa_mask);
+	for (i = 0; i < NUM_FORWARDED; i++)
+	{
+		sigaction(forwarded_signals[i], NULL, &saved_actions[i]);
+		forwarding[i] = (saved_actions[i].sa_handler != SIG_IGN);
+		if (forwarding[i])
+			sigaction(forwarded_signals[i], &action, NULL);
+	}
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+	/* Read the result record, killing Concorde if it runs out of time. */
+	output = (char *)malloc(size);
+	lost = (output == NULL);
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	while (!lost)
+	{
+		timeout = -1;
+		if ((budget != NULL) && (budget->wall > 0) && !killed)
+		{
+			gettimeofday(&now, NULL);
+			timeout = (int)((budget->wall - seconds(&start, &now))*1000);
+			if (timeout <= 0)
+			{
+				kill(-pid, SIGKILL);
+				killed = 1;
+				timeout = -1;
+			}
+		}
+
+		ready = poll(&pfd, 1, timeout);
+		if ((ready == -1) && (errno != EINTR))
+			lost = 1;
+		if (ready <= 0)
+			continue;
+
+		if (len + 1 == size)
+		{
+			bigger = (char *)realloc(output, 2*size);
+			if (bigger == NULL)
+			{
+				lost = 1;
+				continue;
+			}
+			output = bigger;
+			size *= 2;
+		}
+		n = read(fds[0], output + len, size - len - 1);
+		if (n > 0)
+			len += n;
+		else if ((n == 0) || (errno != EINTR))
+			break;
+	}
+	close(fds[0]);
+
+	/* If the record can't be read, there is no point letting Concorde finish. */
+	if (lost)
+		kill(-pid, SIGKILL);
+	else
+		output[len] = '\0';
+
+	while ((reaped = wait4(pid, &run->status, 0, &usage)) == -1)
+	{
+		if (errno != EINTR)
+			break;
+	}
+	gettimeofday(&now, NULL);
+
+	sigprocmask(SIG_BLOCK, &forwarded, NULL);
+	for (i = 0; i < NUM_FORWARDED; i++)
+		if (forwarding[i])
+			sigaction(forwarded_signals[i], &saved_actions[i], NULL);
+	concorde_group = 0;
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+
+	if ((reaped == -1) || lost)
+	{
+		free(output);
+		return -1;
+	}
+
+	/* exec_concorde() exits with 127 if Concorde couldn't be started. */
+	if (WIFEXITED(run->status) && (WEXITSTATUS(run->status) == 127))
+	{
+		free(output);
+		return -1;
+	}
+
+	run->wall = seconds(&start, &now);
+	run->user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1000000.0;
+	run->sys = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1000000.0;
+	run->maxrss = usage.ru_maxrss;
+
+	/* Concorde writes a record of its results (a line with a JSON object)
+	   when it finishes, and "ok" is 0 if it failed. */
+	if (strstr(output, "\"ok\":1") != NULL)
+	{
+		run->finished = 1;
+		run->runtime = record_value(output, "time");
+		run->bbnodes = (int)record_value(output, "bbnodes");
+		run->upperbound = record_value(output, "upperbound");
+		run->lowerbound = record_value(output, "lowerbound");
+		run->rows = (int)record_value(output, "rows");
+		run->cols = (int)record_value(output, "cols");
+		run->root_time = record_value(output, "root");
+		run->cutting_time = record_value(output, "cutting");
+		run->linkern_time = record_value(output, "linkern");
+		run->price_time = record_value(output, "price");
+		run->branching_time = record_value(output, "branching");
+	}
+	free(output);
+
+	/* If Concorde was killed because it went over its time budget, all we know
+	   is that it takes at least as long as it ran for. The CPU limit sends
+	   SIGXCPU, then SIGKILL if that didn't stop it, but a SIGKILL can also come
+	   from elsewhere (e.g. the kernel when memory runs out), so it only counts
+	   if the CPU time was used up. The time it ran for is measured the way its
+	   budget was: Concorde reports CPU time, so that is used unless the wall
+	   clock limit stopped it. */
+	cpu = run->user + run->sys;
+	if (!run->finished)
+	{
+		if (killed)
+		{
+			run->censored = 1;
+			run->runtime = run->wall;
+		}
+		else if ((budget != NULL) && (budget->cpu > 0) && WIFSIGNALED(run->status)
+		         && ((WTERMSIG(run->status) == SIGXCPU)
+		             || ((WTERMSIG(run->status) == SIGKILL) && (cpu >= budget->cpu))))
+		{
+			run->censored = 1;
+			run->runtime = cpu;
+		}
+	}
+
+	/* Otherwise, it only counts as running out of memory if there is some
+	   evidence of it: it had a memory budget, used most of it, and then was
+	   killed, crashed or exited with an error (which is what Concorde does when
+	   malloc() fails). */
+	if (!run->finished && !run->censored
+	    && (budget != NULL) && (budget->memory > 0)
+	    && (run->maxrss >= budget->memory*1024*OOM_RSS_FRACTION)
+	    && ((WIFSIGNALED(run->status) && ((WTERMSIG(run->status) == SIGKILL) || (WTERMSIG(run->status) == SIGSEGV)))
+	        || (WIFEXITED(run->status) && (WEXITSTATUS(run->status) != 0))))
+		run->outofmemory = 1;
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ *	\file
+ *	\brief Runs \e Concorde on a TSPlib file and collects everything known about
+ *	the run.
+ *
+ *	\e Concorde is started directly with \c fork() and \c exec() (no shell is
+ *	involved), the record of its results it writes when it finishes (see its
+ *	\c -j option) is read through a pipe and it is reaped with \c wait4(). So
+ *	as well as the running time \e Concorde reports itself, the
+ *	CPU time and the amount of memory the process used (which aren't affected
+ *	much by how busy the machine is) and its exit status are known.
+ *
+ *	Each run can be given a time and memory budget. A run which goes over its
+ *	time budget is killed, and all that is known is that it takes \e at
+ *	\e least as long as it ran for (the run is \e censored). A run which runs
+ *	out of memory, or which fails for some other reason, is recorded
+ *	separately.
+ *
+ *	\e Concorde runs in its own process group. While it runs, \c SIGINT,
+ *	\c SIGTERM and \c SIGHUP are passed on to it before they are handled as
+ *	usual, so it is stopped along with the program that started it.
+ */
+
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+
+/**
+ *	\brief How long (and with how much memory) a run of \e Concorde may take. A
+ *	limit of 0 means there is no limit.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The wall clock time limit (in seconds).
+	 */
+	double wall;
+
+	/**
+	 *	\brief The CPU time limit (in seconds).
+	 */
+	int cpu;
+
+	/**
+	 *	\brief The memory (address space) limit (in megabytes).
+	 */
+	long memory;
+} run_budget;
+
+
+/**
+ *	\brief The results of one run of \e Concorde.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The running time reported by \e Concorde (0 if it didn't report
+	 *	one), or how long it ran for if the run is censored (the CPU time if
+	 *	the CPU limit stopped it, the wall clock time if the wall clock limit
+	 *	did).
+	 */
+	double runtime;
+
+	/**
+	 *	\brief The number of branch and bound nodes reported by \e Concorde.
+	 */
+	int bbnodes;
+
+	/**
+	 *	\brief The length of the best tour found and the lower bound given by
+	 *	the root LP.
+	 */
+	double upperbound, lowerbound;
+
+	/**
+	 *	\brief The number of rows and columns of the final root LP.
+	 */
+	int rows, cols;
+
+	/**
+	 *	\brief The time (in seconds) \e Concorde spent at the root of the branch
+	 *	and bound tree, the parts of it spent in the cutting loop, finding tours
+	 *	and exact pricing, and the time spent branching.
+	 */
+	double root_time, cutting_time, linkern_time, price_time, branching_time;
+
+	/**
+	 *	\brief The user and system CPU time (in seconds) used by the process.
+	 */
+	double user, sys;
+
+	/**
+	 *	\brief The wall clock time (in seconds) from starting the process to
+	 *	reaping it.
+	 */
+	double wall;
+
+	/**
+	 *	\brief The maximum resident set size of the process (in kilobytes).
+	 */
+	long maxrss;
+
+	/**
+	 *	\brief The status of the process, as returned by \c wait4().
+	 */
+	int status;
+
+	/**
+	 *	\brief True (1) if \e Concorde wrote a record of its results, i.e. it
+	 *	solved the instance.
+	 */
+	int finished;
+
+	/**
+	 *	\brief True (1) if \e Concorde was killed because it went over its time
+	 *	budget: the wall clock limit, or the CPU limit (\c SIGXCPU, or
+	 *	\c SIGKILL once all of the CPU time was used).
+	 */
+	int censored;
+
+	/**
+	 *	\brief True (1) if \e Concorde most likely failed because it ran out of
+	 *	memory: it had a memory budget, used most of it (see \c maxrss), and then
+	 *	was killed, crashed or exited with an error. Unlike a censored run,
+	 *	nothing is known about how long it takes, and another budget could
+	 *	change the result, so it shouldn't be cached. A run which didn't finish
+	 *	and is neither censored nor out of memory simply failed.
+	 */
+	int outofmemory;
+} concorde_run;
+
+
+/**
+ *	\brief Runs \e Concorde on a TSPlib file and waits for it to finish.
+ *
+ *	\e Concorde creates its files in the current directory, so it is run in the
+ *	directory that contains the TSPlib file. It must be in one of the
+ *	directories in \c PATH.
+ *
+ *	\param filename The TSPlib file to make \e Concorde try to solve.
+ *	\param seed     The random seed \e Concorde should use (its \c -s option),
+ *	                or a negative number to let \e Concorde choose one.
+ *	\param binary   True (1) if the file is in \e Concorde's binary format
+ *	                (see util/tsplib.h) instead of a TSPlib file, in which case
+ *	                \e Concorde is given its \c -b option.
+ *	\param budget   The limits of the run, or \c NULL if there are no limits.
+ *	\param run      The results of the run are returned in this parameter.
+ *	\return \c 0 if \e Concorde was run, \c -1 if the process couldn't be
+ *	        created, \e Concorde couldn't be started or its result record
+ *	        couldn't be read.
+ */
+int launch_concorde(const char *filename, int seed, int binary, const run_budget *budget, concorde_run *run);
+
+#endif
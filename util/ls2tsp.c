@@ -1,12 +1,93 @@
 /**
  *	\file
- *	\brief Creates a TSPlib plot of the specified L-System.
+ *	\brief Creates a TSPlib plot of the specified L-System, or (in batch mode)
+ *	of every L-System in a file for a range of orders.
  *
  *	\author Farhan Ahammed (faha3615@mail.usyd.edu.au)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "../lsys.h"
+#include "workers.h"
+
+
+/**
+ *	\brief The name of the file (in the output directory) which lists the files
+ *	created in batch mode.
+ */
+#define MANIFEST_FILE "manifest.txt"
+
+
+/**
+ *	\brief What a worker sends back to the parent once it has created a file in
+ *	batch mode.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The number of points created, or \c -1 if the file couldn't be
+	 *	created.
+	 */
+	int numpoints;
+
+	/**
+	 *	\brief How long (in seconds) it took to create the file.
+	 */
+	double seconds;
+} batch_result;
+
+
+/**
+ *	\brief Everything the jobs of a batch share.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The file of L-Systems (opened once, before any worker is
+	 *	started, so every worker shares its index).
+	 */
+	ls_index idx;
+
+	/**
+	 *	\brief The range of orders to create.
+	 */
+	int minorder, maxorder;
+
+	/**
+	 *	\brief The directory the files are created in.
+	 */
+	const char *dir;
+
+	/**
+	 *	\brief True (1) to create binary files instead of TSPlib files.
+	 */
+	int binary;
+
+	/**
+	 *	\brief The result of each job (<c>idx.count*(maxorder-minorder+1)</c> of
+	 *	them, see batch_job()).
+	 */
+	batch_result *results;
+
+	/**
+	 *	\brief True (1) for each L-System which is skipped because an earlier
+	 *	L-System in the file has the same name.
+	 */
+	int *skip;
+
+	/**
+	 *	\brief The jobs to do, in the order they are started (see run_batch()).
+	 */
+	int *order;
+} batch;
 
 
 /**
@@ -22,10 +103,6 @@
  */
 void createOneTSPFile(char *filename, int order, const char *lsysfile, const char *lsname)
 {
-	/* Compute the x-y coordinates of the instance represented by this L-System. */
-	int numnodes = Lsystem(order, lsysfile, lsname, "plots");
-
-	/* Now create a valid TSPlib file. */
 	FILE *outfile_stream = fopen(filename, "w");
 
 	/* Check that the file has sucessfully been opened */
@@ -35,26 +112,14 @@ void createOneTSPFile(char *filename, int order, const char *lsysfile, const cha
 		return;
 	}
 
-	/* Build the header file */
-	fprintf(outfile_stream, "NAME: %s\n", lsname);
-	fprintf(outfile_stream, "TYPE: TSP\n");
-	fprintf(outfile_stream, "COMMENT: Created by Farhan Ahammed (farhan.ahammed@studentmail.newcastle.edu.au)\n");
-	fprintf(outfile_stream, "DIMENSION: %d\n", numnodes);
-	fprintf(outfile_stream, "EDGE_WEIGHT_TYPE: EUC_2D\n");
-	fprintf(outfile_stream, "NODE_COORD_TYPE: TWOD_COORDS\n");
-	fprintf(outfile_stream, "NODE_COORD_SECTION:\n");
-
-	/* Add the coordinates of the points in this instance. */
-	FILE *nodefile = fopen("plots", "r");
-	char line[255];
-	while(fgets(line, 255, nodefile) != NULL)
-	{
-		fprintf(outfile_stream, "%s", line);
-	}
-	fclose(nodefile);
-	remove("plots");
-
-	fprintf(outfile_stream, "EOF:\n");
+	/* Compute the x-y coordinates of the instance represented by this L-System,
+	   and write them straight into a valid TSPlib file. */
+	lsys_sink sink;
+	lsys_tsplib_sink(&sink, outfile_stream, lsname);
+	lsys_ctx *ctx = create_lsys_ctx();
+	if ((ctx == NULL) || (LsystemSink(ctx, order, (char *)lsysfile, (char *)lsname, &sink) == -1))
+		printf("ERROR: The L-System '%s' could not be created\n", lsname);
+	delete_lsys_ctx(ctx);
 
 	/* Close the file */
 	int close_error_plot = fclose(outfile_stream);
@@ -66,18 +131,401 @@ void createOneTSPFile(char *filename, int order, const char *lsysfile, const cha
 
 
 
+/**
+ *	\brief Creates a TSPlib (or binary) file of the specified L-System, writing
+ *	the points into the file while they are created (see LsystemStream()), and
+ *	prints how many points were created per second.
+ *
+ *	\param filename The name to give to the file.
+ *	\param order    The order of the fractal to create.
+ *	\param lsysfile The file containing the L-System to use.
+ *	\param lsname   The name of the L-System to use.
+ *	\param binary   True (1) to create a binary file instead of a TSPlib file.
+ */
+void streamTSPFile(char *filename, int order, const char *lsysfile, const char *lsname, int binary)
+{
+	double rate;
+	lsys_ctx *ctx = create_lsys_ctx();
+	int numnodes = (ctx != NULL) ? LsystemStream(ctx, order, (char *)lsysfile, (char *)lsname, filename, binary, &rate) : -1;
+	delete_lsys_ctx(ctx);
+
+	if (numnodes == -1)
+		printf("ERROR: The L-System '%s' could not be created\n", lsname);
+	else
+		printf("%d points created (%.0f points/second)\n", numnodes, rate);
+}
+
+
+
+/**
+ *	\brief Finds the L-System and the order of a job in batch mode. The jobs
+ *	are numbered by L-System and then by order (as they are listed in the
+ *	manifest).
+ */
+static void batch_job(const batch *b, int job, int *i, int *order)
+{
+	int numorders = b->maxorder - b->minorder + 1;
+
+	*i = job / numorders;
+	*order = b->minorder + job % numorders;
+}
+
+
+/**
+ *	\brief Writes the name of the file (in the output directory) of an order of
+ *	an L-System into \c buf. Any character of the L-System's name which isn't
+ *	a letter, digit or \c '-' is replaced by \c '_' (so the file is always in
+ *	the output directory).
+ *
+ *	\return \c 0 if the name fit in \c buf, \c -1 otherwise.
+ */
+static int batch_filename(char *buf, size_t size, const batch *b, int i, int order)
+{
+	const char *name = ls_index_name(&b->idx, i);
+	char *p;
+	int n;
+
+	n = snprintf(buf, size, "%s_%d.%s", name, order, b->binary ? "bin" : "tsp");
+	if ((n < 0) || ((size_t)n >= size))
+		return -1;
+	for (p = buf; p < buf + strlen(name); p++)
+		if (!isalnum((unsigned char)*p) && (*p != '-'))
+			*p = '_';
+	return 0;
+}
+
+
+/**
+ *	\brief Writes the path of the file of an order of an L-System (see
+ *	batch_filename()) into \c buf.
+ *
+ *	\return \c 0 if the path fit in \c buf, \c -1 otherwise.
+ */
+static int batch_path(char *buf, size_t size, const batch *b, int i, int order)
+{
+	char name[FILENAME_MAX];
+	int n;
+
+	if (batch_filename(name, sizeof(name), b, i, order) == -1)
+		return -1;
+	n = snprintf(buf, size, "%s/%s", b->dir, name);
+	return ((n < 0) || ((size_t)n >= size)) ? -1 : 0;
+}
+
+
+/**
+ *	\brief Creates the file of one job in batch mode.
+ *
+ *	\param b   The batch.
+ *	\param job The job to do.
+ *	\return The number of points created (\c -1 if the file couldn't be
+ *	        created) and how long it took.
+ */
+static batch_result run_batch_job(const batch *b, int job)
+{
+	batch_result res;
+	struct timeval start, end;
+	char path[FILENAME_MAX];
+	lsys_sink sink;
+	lsys_ctx *ctx;
+	FILE *outfile_stream;
+	int i, order;
+
+	batch_job(b, job, &i, &order);
+
+	gettimeofday(&start, NULL);
+	res.numpoints = -1;
+	if (batch_path(path, sizeof(path), b, i, order) == -1)
+		printf("ERROR: The file name of L-System '%s' (order %d) is too long\n", ls_index_name(&b->idx, i), order);
+	else if ((outfile_stream = fopen(path, "w")) == NULL)
+		printf("ERROR: File '%s' could not be opened\n", path);
+	else
+	{
+		if (b->binary)
+			lsys_binary_sink(&sink, outfile_stream);
+		else
+			lsys_tsplib_sink(&sink, outfile_stream, ls_index_name(&b->idx, i));
+		ctx = create_lsys_ctx();
+		if (ctx != NULL)
+			res.numpoints = LsystemIndexSink(ctx, order, &b->idx, i, &sink);
+		delete_lsys_ctx(ctx);
+
+		if (fclose(outfile_stream))
+			res.numpoints = -1;
+		if (res.numpoints == -1)
+		{
+			printf("ERROR: The L-System '%s' (order %d) could not be created\n", ls_index_name(&b->idx, i), order);
+			remove(path);
+		}
+	}
+	gettimeofday(&end, NULL);
+	res.seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+	return res;
+}
+
+
+/**
+ *	\brief Does the k-th job started in batch mode (see run_batch()).
+ */
+static void batch_work(void *data, int k, void *result)
+{
+	const batch *b = (const batch *)data;
+
+	*(batch_result *)result = run_batch_job(b, b->order[k]);
+}
+
+
+/**
+ *	\brief Stores the result of the k-th job started in batch mode.
+ */
+static void batch_done(void *data, int k, const void *result)
+{
+	batch *b = (batch *)data;
+	int job = b->order[k], i, order;
+
+	if (result != NULL)
+		b->results[job] = *(const batch_result *)result;
+	else
+	{
+		batch_job(b, job, &i, &order);
+		fprintf(stderr, "ERROR: The worker creating L-System '%s' (order %d) failed\n", ls_index_name(&b->idx, i), order);
+		b->results[job].numpoints = -1;
+		b->results[job].seconds = 0;
+	}
+}
+
+
+/**
+ *	\brief Does every job of the batch, using up to \c numworkers worker
+ *	processes at the same time (see run_workers()).
+ *
+ *	The largest orders are started first, so the batch isn't left waiting for
+ *	one large file at the end.
+ */
+static void run_batch(batch *b, int numworkers)
+{
+	int numorders = b->maxorder - b->minorder + 1;
+	int numjobs = b->idx.count * numorders;
+	int k, job, n = 0;
+
+	for (k = 0; k < numjobs; k++)
+	{
+		/* (The k-th job is L-System k % count, order maxorder - k / count.) */
+		job = (k % b->idx.count) * numorders + (numorders - 1 - k / b->idx.count);
+		if (!b->skip[job / numorders])
+			b->order[n++] = job;
+	}
+	run_workers(n, numworkers, sizeof(batch_result), batch_work, batch_done, b);
+}
+
+
+/**
+ *	\brief Writes the manifest of a batch: a line for each file created (or
+ *	which couldn't be created) giving the file, the L-System, the order, the
+ *	number of points (\c -1 if the file couldn't be created) and how long it
+ *	took to create.
+ *
+ *	\return \c 0 if the manifest was written, \c -1 otherwise.
+ */
+static int write_manifest(const batch *b, const char *lsysfile)
+{
+	char name[FILENAME_MAX], path[FILENAME_MAX];
+	int numorders = b->maxorder - b->minorder + 1;
+	int job, i, order, ret;
+	FILE *fp;
+
+	ret = snprintf(path, sizeof(path), "%s/%s", b->dir, MANIFEST_FILE);
+	if ((ret < 0) || ((size_t)ret >= sizeof(path)))
+	{
+		printf("ERROR: The directory name '%s' is too long\n", b->dir);
+		return -1;
+	}
+	fp = fopen(path, "w");
+	if (fp == NULL)
+	{
+		printf("ERROR: File '%s' could not be opened\n", path);
+		return -1;
+	}
+
+	fprintf(fp, "# L-Systems from '%s', orders %d to %d\n", lsysfile, b->minorder, b->maxorder);
+	fprintf(fp, "# file\tL-System\torder\tpoints\tseconds\n");
+	for (job = 0; job < b->idx.count * numorders; job++)
+	{
+		batch_job(b, job, &i, &order);
+		if (b->skip[i])
+			continue;
+		batch_filename(name, sizeof(name), b, i, order);
+		fprintf(fp, "%s\t%s\t%d\t%d\t%.6f\n", name, ls_index_name(&b->idx, i), order,
+		        b->results[job].numpoints, b->results[job].seconds);
+	}
+
+	if (fclose(fp))
+	{
+		printf("ERROR: File '%s' could not be closed\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+ *	\brief Creates a file for every order (from \c minorder to \c maxorder) of
+ *	every L-System in a file, and a manifest listing them (see
+ *	write_manifest()).
+ *
+ *	The file of L-Systems is opened once (with its index, see ls/ls_index.h),
+ *	and the files are created by up to \c numworkers worker processes at the
+ *	same time (each a copy of this one, so they share the index). Each worker
+ *	only reads the L-System it creates.
+ *
+ *	\param lsysfile   The file containing the L-Systems.
+ *	\param minorder   The smallest order to create.
+ *	\param maxorder   The largest order to create.
+ *	\param dir        The directory to create the files in (it is created if
+ *	                  it doesn't exist).
+ *	\param binary     True (1) to create binary files instead of TSPlib files.
+ *	\param numworkers The number of files to create at the same time.
+ *	\return \c 0 if the manifest was written, \c -1 otherwise.
+ */
+int createTSPFileBatch(const char *lsysfile, int minorder, int maxorder, const char *dir, int binary, int numworkers)
+{
+	batch b;
+	char name[FILENAME_MAX], other[FILENAME_MAX], path[FILENAME_MAX];
+	int i, j, ret, numjobs;
+
+	if ((minorder < 1) || (maxorder < minorder))
+	{
+		printf("ERROR: Invalid range of orders (%d to %d)\n", minorder, maxorder);
+		return -1;
+	}
+	if ((mkdir(dir, 0755) == -1) && (errno != EEXIST))
+	{
+		printf("ERROR: Directory '%s' could not be created\n", dir);
+		return -1;
+	}
+	if (ls_index_open(&b.idx, lsysfile, NULL) == -1)
+	{
+		printf("ERROR: File '%s' could not be read\n", lsysfile);
+		return -1;
+	}
+
+	b.minorder = minorder;
+	b.maxorder = maxorder;
+	b.dir = dir;
+	b.binary = binary;
+	numjobs = b.idx.count * (maxorder - minorder + 1);
+	b.results = (batch_result *)calloc(numjobs ? numjobs : 1, sizeof(batch_result));
+	b.skip = (int *)calloc(b.idx.count ? b.idx.count : 1, sizeof(int));
+	b.order = (int *)malloc(sizeof(int)*(numjobs ? numjobs : 1));
+	if ((b.results == NULL) || (b.skip == NULL) || (b.order == NULL))
+	{
+		printf("ERROR: Not enough memory\n");
+		free(b.results);
+		free(b.skip);
+		free(b.order);
+		ls_index_close(&b.idx);
+		return -1;
+	}
+
+	/* Only the first of the L-Systems with the same name can be asked for (see
+	   Lsystem()), and its files would be overwritten by the others. The same
+	   goes for different names which give the same file names (see
+	   batch_filename()). The largest order gives the longest paths. */
+	for (i = 0; i < b.idx.count; i++)
+	{
+		if (batch_path(path, sizeof(path), &b, i, maxorder) == -1)
+		{
+			printf("WARNING: Skipping the L-System named '%s' (its file names are too long)\n", ls_index_name(&b.idx, i));
+			b.skip[i] = 1;
+			continue;
+		}
+		batch_filename(name, sizeof(name), &b, i, minorder);
+		for (j = 0; (j < i) && !b.skip[i]; j++)
+		{
+			if (b.skip[j])
+				continue;
+			if (strcmp(ls_index_name(&b.idx, i), ls_index_name(&b.idx, j)) == 0)
+			{
+				printf("WARNING: Skipping the second L-System named '%s'\n", ls_index_name(&b.idx, i));
+				b.skip[i] = 1;
+			}
+			else if ((batch_filename(other, sizeof(other), &b, j, minorder) == 0) && (strcmp(name, other) == 0))
+			{
+				printf("WARNING: Skipping the L-System named '%s' (its files would overwrite those of '%s')\n", ls_index_name(&b.idx, i), ls_index_name(&b.idx, j));
+				b.skip[i] = 1;
+			}
+		}
+	}
+
+	run_batch(&b, numworkers);
+	ret = write_manifest(&b, lsysfile);
+
+	free(b.results);
+	free(b.skip);
+	free(b.order);
+	ls_index_close(&b.idx);
+	return ret;
+}
+
+
+
 /**
  *	\brief Starts the program.
  *
- *	One argument is expected. The program is run like this:
+ *	The program is run like this:
  *	\code
- *  <program name> <ifs file>
+ *  <program name> [-s | -b] <L-System file> <L-System name> <order> <output file name>
+ *  <program name> -a [-b] [-j n] <L-System file> <min order> <max order> <output directory>
  *	\endcode
+ *	With \c -s the points are written into the TSPlib file while they are
+ *	created (for very large orders), and with \c -b they are written to a
+ *	binary file in the same way.
+ *
+ *	With \c -a (batch mode) every order from <c>&lt;min order&gt;</c> to
+ *	<c>&lt;max order&gt;</c> of every L-System in the file is created (see
+ *	createTSPFileBatch()), by up to \c n processes at the same time (by
+ *	default, one for each processor). With \c -b the files are binary files.
  */
 int main(int argc, char** argv)
 {
-	if (argc < 4)
-		printf("usage:\n%s <L-System file> <L-System name> <order> <output file name>\n", argv[0]);
+	int c, all = 0, stream = 0, binary = 0, numworkers = 0;
+
+	while ((c = getopt(argc, argv, "absj:")) != -1)
+	{
+		switch (c)
+		{
+			case 'a':
+				all = 1;
+				break;
+			case 'b':
+				stream = 1;
+				binary = 1;
+				break;
+			case 's':
+				stream = 1;
+				break;
+			case 'j':
+				numworkers = (int)strtol(optarg, NULL, 10);
+				break;
+		}
+	}
+
+	if (argc - optind < 4)
+	{
+		printf("usage:\n%s [-s | -b] <L-System file> <L-System name> <order> <output file name>\n", argv[0]);
+		printf("%s -a [-b] [-j n] <L-System file> <min order> <max order> <output directory>\n", argv[0]);
+		return 1;
+	}
+
+	argv += optind - 1;
+	if (all)
+	{
+		if (numworkers < 1)
+			numworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		return createTSPFileBatch(argv[1], atoi(argv[2]), atoi(argv[3]), argv[4], binary, numworkers) ? 1 : 0;
+	}
+	else if (stream)
+		streamTSPFile(argv[4], atoi(argv[3]), argv[1], argv[2], binary);
 	else
 		createOneTSPFile(argv[4], atoi(argv[3]), argv[1], argv[2]);
 	return 0;
@@ -0,0 +1,121 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the header file sampling.h
+ */
+
+#include <math.h>
+
+#include "sampling.h"
+
+
+/**
+ *	\brief The 97.5% quantiles of Student's t-distribution with 1 to 30 degrees
+ *	of freedom. The normal distribution's (1.96) is used for more than 30.
+ */
+static const double t_quantile[30] =
+{
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+
+void sample_init(sample_stats *s)
+{
+	s->n = 0;
+	s->mean = s->M2 = 0;
+	s->mean_bb = s->M2_bb = 0;
+	s->censored = 0;
+	s->outofmemory = 0;
+	s->failed = 0;
+}
+
+
+void sample_restore(sample_stats *s, int n, double mean, double sd, double mean_bb, double sd_bb, int censored)
+{
+	s->n = n;
+	s->mean = mean;
+	s->mean_bb = mean_bb;
+	s->M2 = (n > 1) ? sd*sd*(n - 1) : 0;
+	s->M2_bb = (n > 1) ? sd_bb*sd_bb*(n - 1) : 0;
+	s->censored = censored;
+	s->outofmemory = 0;
+	s->failed = 0;
+}
+
+
+void sample_add(sample_stats *s, double rt, double bb)
+{
+	double delta;
+
+	s->n++;
+
+	delta = rt - s->mean;
+	s->mean += delta/s->n;
+	s->M2 += delta*(rt - s->mean); /* NOTE: This expression uses the new value of mean. */
+
+	delta = bb - s->mean_bb;
+	s->mean_bb += delta/s->n;
+	s->M2_bb += delta*(bb - s->mean_bb);
+}
+
+
+void sample_censor(sample_stats *s, double rt, double bb)
+{
+	sample_add(s, rt, bb);
+	s->censored = 1;
+}
+
+
+void sample_out_of_memory(sample_stats *s, double rt, double bb)
+{
+	sample_add(s, rt, bb);
+	s->outofmemory = 1;
+}
+
+
+void sample_fail(sample_stats *s)
+{
+	s->failed = 1;
+}
+
+
+double sample_sd(const sample_stats *s)
+{
+	if (s->n < 2)
+		return 0;
+	return sqrt(s->M2/(s->n - 1));
+}
+
+
+double sample_sd_bb(const sample_stats *s)
+{
+	if (s->n < 2)
+		return 0;
+	return sqrt(s->M2_bb/(s->n - 1));
+}
+
+
+double sample_ci(const sample_stats *s)
+{
+	double t;
+
+	if (s->n < 2)
+		return HUGE_VAL;
+
+	t = (s->n - 1 <= 30) ? t_quantile[s->n - 2] : 1.96;
+	return t*sample_sd(s)/sqrt(s->n);
+}
+
+
+int sample_done(const sample_stats *s, const sampling_plan *plan)
+{
+	if (s->censored || s->outofmemory || s->failed || (s->n >= plan->max_runs))
+		return 1;
+	if (s->n < plan->min_runs)
+		return 0;
+	if (plan->rel_ci <= 0)
+		return 1;
+
+	return (sample_ci(s) <= plan->rel_ci*s->mean);
+}
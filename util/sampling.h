@@ -0,0 +1,170 @@
+/**
+ *	\file
+ *	\brief Keeps track of the running times (and number of branch and bound
+ *	nodes) of repeated runs of \e Concorde on an instance, and decides when
+ *	enough runs have been made.
+ *
+ *	The mean and variance are updated after each run using Welford's method.
+ *	Instead of always running \e Concorde a fixed number of times, the runs can
+ *	stop as soon as the mean running time is known precisely enough, i.e. once
+ *	the half-width of its 95% confidence interval is small compared to the mean.
+ */
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+
+/**
+ *	\brief How many times \e Concorde should be run on an instance.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The minimum number of runs.
+	 */
+	int min_runs;
+
+	/**
+	 *	\brief The maximum number of runs.
+	 */
+	int max_runs;
+
+	/**
+	 *	\brief Stop once the half-width of the 95% confidence interval of the
+	 *	mean running time is at most this fraction of the mean. If this is 0,
+	 *	exactly \c min_runs runs are made.
+	 */
+	double rel_ci;
+} sampling_plan;
+
+
+/**
+ *	\brief The results of the runs made so far.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The number of runs.
+	 */
+	int n;
+
+	/**
+	 *	\brief The mean running time and the sum of the squared differences from
+	 *	the mean.
+	 */
+	double mean, M2;
+
+	/**
+	 *	\brief The mean number of branch and bound nodes and the sum of the squared
+	 *	differences from the mean.
+	 */
+	double mean_bb, M2_bb;
+
+	/**
+	 *	\brief True (1) if a run was stopped because it went over its budget.
+	 *	The mean running time is then only a lower bound, and no more runs are
+	 *	made (they would go over the budget too). The results shouldn't be
+	 *	cached, since a later run may have a larger budget.
+	 */
+	int censored;
+
+	/**
+	 *	\brief True (1) if a run ran out of memory. No more runs are made, and the
+	 *	results shouldn't be cached, since they depend on the memory budget.
+	 */
+	int outofmemory;
+
+	/**
+	 *	\brief True (1) if a run failed for some other reason (e.g. \e Concorde
+	 *	crashed). The run isn't added to the results, since nothing is known
+	 *	about its running time, no more runs are made and the results shouldn't
+	 *	be cached.
+	 */
+	int failed;
+} sample_stats;
+
+
+/**
+ *	\brief Initialises the results so that no runs have been made.
+ *
+ *	\param s The results to initialise.
+ */
+void sample_init(sample_stats *s);
+
+/**
+ *	\brief Initialises the results from the summary of earlier runs (e.g. ones
+ *	found in the cache), so that more runs can be added to them.
+ *
+ *	\param s        The results to initialise.
+ *	\param n        The number of earlier runs.
+ *	\param mean     The mean running time.
+ *	\param sd       The standard deviation of the running times.
+ *	\param mean_bb  The mean number of branch and bound nodes.
+ *	\param sd_bb    The standard deviation of the number of branch and bound nodes.
+ *	\param censored True (1) if one of the earlier runs went over its budget.
+ */
+void sample_restore(sample_stats *s, int n, double mean, double sd, double mean_bb, double sd_bb, int censored);
+
+/**
+ *	\brief Adds the result of one run.
+ *
+ *	\param s  The results.
+ *	\param rt The running time.
+ *	\param bb The number of branch and bound nodes.
+ */
+void sample_add(sample_stats *s, double rt, double bb);
+
+/**
+ *	\brief Adds the result of a run which went over its budget and was stopped.
+ *	The running time of the run is at least \c rt.
+ *
+ *	\param s  The results.
+ *	\param rt The time the run was stopped after.
+ *	\param bb The number of branch and bound nodes (if known).
+ */
+void sample_censor(sample_stats *s, double rt, double bb);
+
+/**
+ *	\brief Adds the result of a run which ran out of memory.
+ *
+ *	\param s  The results.
+ *	\param rt The running time (if known).
+ *	\param bb The number of branch and bound nodes (if known).
+ */
+void sample_out_of_memory(sample_stats *s, double rt, double bb);
+
+/**
+ *	\brief Records that a run failed (see sample_stats::failed).
+ *
+ *	\param s The results.
+ */
+void sample_fail(sample_stats *s);
+
+/**
+ *	\brief Returns the standard deviation of the running times (0 if there has
+ *	been less than two runs).
+ */
+double sample_sd(const sample_stats *s);
+
+/**
+ *	\brief Returns the standard deviation of the number of branch and bound
+ *	nodes (0 if there has been less than two runs).
+ */
+double sample_sd_bb(const sample_stats *s);
+
+/**
+ *	\brief Returns the half-width of the 95% confidence interval of the mean
+ *	running time (using Student's t-distribution).
+ */
+double sample_ci(const sample_stats *s);
+
+/**
+ *	\brief Returns true (1) if no more runs are needed (or if a run went over
+ *	its budget, ran out of memory or failed).
+ *
+ *	\param s    The results so far.
+ *	\param plan How many runs should be made.
+ */
+int sample_done(const sample_stats *s, const sampling_plan *plan);
+
+#endif
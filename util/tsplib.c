@@ -0,0 +1,200 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the header file tsplib.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "tsplib.h"
+
+
+/**
+ *	\brief The two digits of each number from 0 to 99, so numbers can be
+ *	written two digits at a time.
+ */
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+
+int tsplib_header(char *buf, size_t size, const char *name, int numpoints)
+{
+	return snprintf(buf, size,
+	                "NAME: %s\n"
+	                "TYPE: TSP\n"
+	                "COMMENT: Created by Farhan Ahammed (farhan.ahammed@studentmail.newcastle.edu.au)\n"
+	                "DIMENSION: %d\n"
+	                "EDGE_WEIGHT_TYPE: EUC_2D\n"
+	                "NODE_COORD_TYPE: TWOD_COORDS\n"
+	                "NODE_COORD_SECTION:\n", name, numpoints);
+}
+
+
+char *tsplib_put_int(char *p, int n)
+{
+	char digits[10];
+	char *d = digits + sizeof(digits);
+	unsigned int u = (n < 0) ? -(unsigned int)n : (unsigned int)n;
+	size_t len;
+
+	if (n < 0)
+		*p++ = '-';
+
+	/* The digits are found from the right, two at a time. */
+	while (u >= 100)
+	{
+		d -= 2;
+		memcpy(d, &digit_pairs[(u % 100)*2], 2);
+		u /= 100;
+	}
+	if (u >= 10)
+	{
+		d -= 2;
+		memcpy(d, &digit_pairs[u*2], 2);
+	}
+	else
+		*--d = '0' + u;
+
+	len = digits + sizeof(digits) - d;
+	memcpy(p, d, len);
+	return p + len;
+}
+
+
+char *tsplib_put_points(char *p, const lsys_point *points, int numpoints)
+{
+	int i;
+
+	for (i = 0; i < numpoints; i++)
+	{
+		p = tsplib_put_int(p, i);
+		*p++ = ' ';
+		p = tsplib_put_int(p, points[i].x);
+		*p++ = ' ';
+		p = tsplib_put_int(p, points[i].y);
+		*p++ = '\n';
+	}
+	return p;
+}
+
+
+unsigned char *tsplib_put_binary_int(unsigned char *p, int n)
+{
+	p[0] = (unsigned char)((unsigned int)n >> 24);
+	p[1] = (unsigned char)((unsigned int)n >> 16);
+	p[2] = (unsigned char)((unsigned int)n >> 8);
+	p[3] = (unsigned char)n;
+	return p + 4;
+}
+
+
+/**
+ *	\brief Writes \c len bytes to a file (the loop is only needed if the write
+ *	is interrupted). Returns \c 0, or \c -1 if they couldn't be written.
+ */
+static int write_all(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	for (; len > 0; buf += n, len -= n)
+	{
+		n = write(fd, buf, len);
+		if (n == -1)
+		{
+			if (errno != EINTR)
+				return -1;
+			n = 0;
+		}
+	}
+	return 0;
+}
+
+
+int write_tsplib_fd(int fd, const char *name, const lsys_point *points, int numpoints)
+{
+	char *buf, *p;
+	int headerlen, ret;
+	size_t size;
+
+	if (numpoints < 0)
+		numpoints = 0;
+
+	/* Format the whole file into one buffer. */
+	headerlen = tsplib_header(NULL, 0, name, numpoints);
+	size = headerlen + 1 + (size_t)numpoints*TSPLIB_MAX_LINE + 5;
+	buf = (char *)malloc(size);
+	if (buf == NULL)
+		return -1;
+	tsplib_header(buf, size, name, numpoints);
+	p = tsplib_put_points(buf + headerlen, points, numpoints);
+	memcpy(p, "EOF:\n", 5);
+
+	ret = write_all(fd, buf, p + 5 - buf);
+	free(buf);
+	return ret;
+}
+
+
+int write_tsplib(const char *filename, const char *name, const lsys_point *points, int numpoints)
+{
+	int fd, ret;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+		return -1;
+	ret = write_tsplib_fd(fd, name, points, numpoints);
+	if (close(fd) == -1)
+		ret = -1;
+	return ret;
+}
+
+
+int write_binary_fd(int fd, const lsys_point *points, int numpoints)
+{
+	unsigned char *buf, *p;
+	int i, ret;
+
+	if (numpoints < 0)
+		numpoints = 0;
+
+	buf = (unsigned char *)malloc(4 + (size_t)numpoints*8);
+	if (buf == NULL)
+		return -1;
+	p = tsplib_put_binary_int(buf, numpoints);
+	for (i = 0; i < numpoints; i++)
+	{
+		p = tsplib_put_binary_int(p, points[i].x);
+		p = tsplib_put_binary_int(p, points[i].y);
+	}
+
+	ret = write_all(fd, (char *)buf, p - buf);
+	free(buf);
+	return ret;
+}
+
+
+int write_binary(const char *filename, const lsys_point *points, int numpoints)
+{
+	int fd, ret;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+		return -1;
+	ret = write_binary_fd(fd, points, numpoints);
+	if (close(fd) == -1)
+		ret = -1;
+	return ret;
+}
@@ -0,0 +1,119 @@
+/**
+ *	\file
+ *	\brief Writes the points created by an L-System to a TSPlib file, or to a
+ *	file in \e Concorde's binary format.
+ *
+ *	The whole file (the header, a line for each point and the \c EOF line) is
+ *	formatted into one buffer, and the buffer is written with a single
+ *	\c write(), so writing an instance costs about as much as one system call.
+ *	The files have the \c EUC_2D edge weight type, and each point is written
+ *	on a line of the form <c>&lt;node ID&gt; &lt;x-coord&gt; &lt;y-coord&gt;</c>
+ *	(the node IDs start at 0).
+ *
+ *	A binary file holds the number of points followed by the x and y
+ *	coordinates of each point, each written as a 4 byte big-endian integer.
+ *	This is the \e binary-ints format \e Concorde reads (with the modified
+ *	concorde.c, run <c>concorde -b</c>), which saves it parsing the text of a
+ *	TSPlib file.
+ */
+
+#ifndef TSPLIB_H
+#define TSPLIB_H
+
+#include <stddef.h>
+
+#include "../lsys.h"
+
+
+/**
+ *	\brief The most bytes the line of one point can need.
+ */
+#define TSPLIB_MAX_LINE 36
+
+
+/**
+ *	\brief Writes the header of a TSPlib file (everything before the first
+ *	point) into a buffer.
+ *
+ *	\param buf       The buffer to write the header to.
+ *	\param size      The size of the buffer.
+ *	\param name      The name of the instance.
+ *	\param numpoints The number of points in the instance.
+ *	\return The length of the header (as returned by \c snprintf()).
+ */
+int tsplib_header(char *buf, size_t size, const char *name, int numpoints);
+
+/**
+ *	\brief Writes an integer (in decimal) into a buffer. No \c '\\0' is added.
+ *
+ *	\param p The place to write the number.
+ *	\param n The number to write.
+ *	\return The end of the number.
+ */
+char *tsplib_put_int(char *p, int n);
+
+/**
+ *	\brief Writes the lines of the given points into a buffer, which must have
+ *	room for <c>numpoints*TSPLIB_MAX_LINE</c> bytes.
+ *
+ *	\param p         The place to write the lines.
+ *	\param points    The points.
+ *	\param numpoints The number of points.
+ *	\return The end of the last line.
+ */
+char *tsplib_put_points(char *p, const lsys_point *points, int numpoints);
+
+/**
+ *	\brief Writes an integer (as 4 big-endian bytes) into a buffer.
+ *
+ *	\param p The place to write the number.
+ *	\param n The number to write.
+ *	\return The end of the number.
+ */
+unsigned char *tsplib_put_binary_int(unsigned char *p, int n);
+
+/**
+ *	\brief Writes a TSPlib file of the given points to a file which is already
+ *	open.
+ *
+ *	\param fd        The file descriptor to write to.
+ *	\param name      The name of the instance.
+ *	\param points    The points (which may be \c NULL if there are none).
+ *	\param numpoints The number of points.
+ *	\return \c 0 if the file was written, \c -1 otherwise.
+ */
+int write_tsplib_fd(int fd, const char *name, const lsys_point *points, int numpoints);
+
+/**
+ *	\brief Creates a TSPlib file of the given points.
+ *
+ *	\param filename  The file to create.
+ *	\param name      The name of the instance.
+ *	\param points    The points (which may be \c NULL if there are none).
+ *	\param numpoints The number of points.
+ *	\return \c 0 if the file was written, \c -1 otherwise.
+ */
+int write_tsplib(const char *filename, const char *name, const lsys_point *points, int numpoints);
+
+/**
+ *	\brief Writes a binary file of the given points to a file which is already
+ *	open.
+ *
+ *	\param fd        The file descriptor to write to.
+ *	\param points    The points (which may be \c NULL if there are none).
+ *	\param numpoints The number of points.
+ *	\return \c 0 if the file was written, \c -1 otherwise.
+ */
+int write_binary_fd(int fd, const lsys_point *points, int numpoints);
+
+/**
+ *	\brief Creates a binary file of the given points.
+ *
+ *	\param filename  The file to create.
+ *	\param points    The points (which may be \c NULL if there are none).
+ *	\param numpoints The number of points.
+ *	\return \c 0 if the file was written, \c -1 otherwise.
+ */
+int write_binary(const char *filename, const lsys_point *points, int numpoints);
+
+#endif
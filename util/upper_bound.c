@@ -280,6 +280,8 @@ double sum_error(double ub[5], const data_point *points, const int num_data_poin
 	int i;
 	for (i = 0; i < num_data_points; i++)
 	{
+		if (points[i].censored)
+			continue;
 		error = error + pow((points[i].x - ub[1])/ub[3], ub[0])*ub[4] + ub[2] - points[i].y;
 	}
 	return error;
@@ -22,6 +22,13 @@ typedef struct
      *    \brief The y-value of this data point.
      */
     double y;
+    /**
+     *    \brief True (1) if the y-value is only known to be \e at \e least
+     *    \c y (e.g. because the run was stopped before it finished). The upper
+     *    bound still lies above these points, but they aren't counted by
+     *    sum_error().
+     */
+    int censored;
 } data_point;
 
 
@@ -92,6 +99,8 @@ void find_lower_bound(double func[5], const data_point *points, const int num_da
  *	in the function find_upper_bound().
  *
  *	The sum of the errors is computed as SUM{i=1,...,num_data_points}{ub(points[i].x) - points[i].y}.
+ *	Censored points are left out, since their actual y-value (and so their
+ *	error) isn't known.
  *
  *	\param ub              An array of size 5 representing the upper bound function.
  *	\param points          The set of (x,y) data points to compute the sum of errors.
@@ -0,0 +1,216 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the header file workers.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "workers.h"
+
+
+/**
+ *	\brief A worker process which is currently doing a job.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The process ID of the worker (0 if this slot is not in use).
+	 */
+	pid_t pid;
+
+	/**
+	 *	\brief The job the worker is doing.
+	 */
+	int job;
+
+	/**
+	 *	\brief The read end of the pipe the worker writes its result to.
+	 */
+	int fd;
+} worker;
+
+
+/**
+ *	\brief Starts a worker process which does a job.
+ *
+ *	\param w          The slot to store the details of the worker in.
+ *	\param job        The job to do.
+ *	\param resultsize The size of the result.
+ *	\param result     Room for the result (in the worker).
+ *	\param work       Does the job.
+ *	\param data       Passed to \c work.
+ *	\return \c 0 if the worker was started, \c -1 otherwise.
+ */
+static int start_worker(worker *w, int job, size_t resultsize, void *result, worker_job work, void *data)
+{
+	int fds[2];
+
+	if (pipe(fds) == -1)
+	{
+		fprintf(stderr, "ERROR: Couldn't create a pipe for the worker process\n");
+		return -1;
+	}
+
+	/* Anything still in the buffers would otherwise be written by both processes. */
+	fflush(stdout);
+	fflush(stderr);
+
+	w->pid = fork();
+	if (w->pid == -1)
+	{
+		fprintf(stderr, "ERROR: Couldn't create the worker process\n");
+		close(fds[0]);
+		close(fds[1]);
+		w->pid = 0;
+		return -1;
+	}
+
+	if (w->pid == 0)
+	{
+		/* We're the worker. */
+		int status = 1;
+
+		close(fds[0]);
+		work(data, job, result);
+		if (write(fds[1], result, resultsize) == (ssize_t)resultsize)
+			status = 0;
+		close(fds[1]);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(status);
+	}
+
+	/* We're the parent. */
+	close(fds[1]);
+	w->fd = fds[0];
+	w->job = job;
+	return 0;
+}
+
+
+/**
+ *	\brief Waits until one of the running workers has finished.
+ *
+ *	A worker has finished when its pipe can be read (it has written its result,
+ *	or exited without writing it). If the pipes can't be polled, the first
+ *	running worker is chosen, and finish_worker() waits for that one.
+ *
+ *	\param workers    The workers (at least one of which is running).
+ *	\param fds        Room for \c numworkers pollfd structures.
+ *	\param numworkers The number of slots in \c workers.
+ *	\return The position (in \c workers) of the worker to finish.
+ */
+static int wait_for_worker(const worker *workers, struct pollfd *fds, int numworkers)
+{
+	int j, n, first = -1;
+
+	for (j = 0; j < numworkers; j++)
+	{
+		/* (poll() ignores negative file descriptors.) */
+		fds[j].fd = workers[j].pid ? workers[j].fd : -1;
+		fds[j].events = POLLIN;
+		fds[j].revents = 0;
+		if (workers[j].pid && (first == -1))
+			first = j;
+	}
+
+	while (((n = poll(fds, numworkers, -1)) == -1) && (errno == EINTR));
+	if (n > 0)
+		for (j = 0; j < numworkers; j++)
+			if (fds[j].revents)
+				return j;
+	return first;
+}
+
+
+/**
+ *	\brief Reads the result of a finished worker and gives it to \c done, waits
+ *	for the worker's process to exit and frees the worker's slot.
+ */
+static void finish_worker(worker *w, size_t resultsize, void *result, worker_done done, void *data)
+{
+	ssize_t n;
+	int status;
+
+	while (((n = read(w->fd, result, resultsize)) == -1) && (errno == EINTR));
+	close(w->fd);
+	/* Only our own worker is waited for, so the other children of this process
+	   are left alone. */
+	while ((waitpid(w->pid, &status, 0) == -1) && (errno == EINTR));
+	w->pid = 0;
+
+	done(data, w->job, (n == (ssize_t)resultsize) ? result : NULL);
+}
+
+
+void run_workers(int numjobs, int numworkers, size_t resultsize, worker_job work, worker_done done, void *data)
+{
+	int job, j, running = 0;
+	worker *workers = NULL;
+	struct pollfd *fds = NULL;
+	void *result;
+
+	result = malloc(resultsize ? resultsize : 1);
+	if (result == NULL)
+	{
+		fprintf(stderr, "ERROR: Not enough memory\n");
+		for (job = 0; job < numjobs; job++)
+			done(data, job, NULL);
+		return;
+	}
+
+	if (numworkers >= 2)
+	{
+		workers = (worker *)malloc(sizeof(worker)*numworkers);
+		fds = (struct pollfd *)malloc(sizeof(struct pollfd)*numworkers);
+	}
+	if ((workers == NULL) || (fds == NULL))
+	{
+		free(workers);
+		workers = NULL;
+		numworkers = 1;
+	}
+	for (j = 0; (j < numworkers) && (workers != NULL); j++)
+		workers[j].pid = 0;
+
+	job = 0;
+	while ((job < numjobs) || (running > 0))
+	{
+		/* Keep every worker busy. */
+		while ((job < numjobs) && ((running < numworkers) || (workers == NULL)))
+		{
+			if (workers != NULL)
+			{
+				for (j = 0; workers[j].pid != 0; j++);
+				if (start_worker(&workers[j], job, resultsize, result, work, data) == 0)
+				{
+					running++;
+					job++;
+					continue;
+				}
+			}
+			/* Do it ourselves. */
+			work(data, job, result);
+			done(data, job, result);
+			job++;
+		}
+
+		if (running == 0)
+			continue;
+
+		/* Wait for one of the workers to finish. */
+		j = wait_for_worker(workers, fds, numworkers);
+		finish_worker(&workers[j], resultsize, result, done, data);
+		running--;
+	}
+
+	free(workers);
+	free(fds);
+	free(result);
+}
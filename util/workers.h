@@ -0,0 +1,58 @@
+/**
+ *	\file
+ *	\brief A pool of worker processes which do a number of jobs at the same
+ *	time.
+ *
+ *	Each job is done in its own (forked) worker process, which sends its result
+ *	back to this process through a pipe. This helps when most of the time of a
+ *	job is spent waiting for something else (e.g. \e Concorde, or the disk).
+ *	Only the workers started by the pool are waited for, so other child
+ *	processes of the caller are left alone.
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stddef.h>
+
+
+/**
+ *	\brief Does a job, storing its result in \c result (\c resultsize bytes,
+ *	see run_workers()). This is called in a worker process, or in this process
+ *	if no worker could be started.
+ *
+ *	\param data   The data given to run_workers().
+ *	\param job    The job to do (from 0 to <c>numjobs - 1</c>).
+ *	\param result Where to store the result.
+ */
+typedef void (*worker_job)(void *data, int job, void *result);
+
+/**
+ *	\brief Is given the result of a finished job (in this process).
+ *
+ *	\param data   The data given to run_workers().
+ *	\param job    The job which has finished.
+ *	\param result The result of the job, or \c NULL if its worker failed.
+ */
+typedef void (*worker_done)(void *data, int job, const void *result);
+
+
+/**
+ *	\brief Does jobs \c 0 to <c>numjobs - 1</c> (in that order), using up to
+ *	\c numworkers worker processes at the same time, and gives the result of
+ *	each one to \c done as it finishes.
+ *
+ *	If \c numworkers is less than two, or a worker can't be started, the jobs
+ *	are done in this process. Every worker process is waited for before this
+ *	function returns.
+ *
+ *	\param numjobs    The number of jobs.
+ *	\param numworkers The maximum number of jobs to do at the same time.
+ *	\param resultsize The size (in bytes) of the result of a job.
+ *	\param work       Does a job.
+ *	\param done       Is given the result of each job.
+ *	\param data       Passed to \c work and \c done.
+ */
+void run_workers(int numjobs, int numworkers, size_t resultsize, worker_job work, worker_done done, void *data);
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ *	\file
+ *	\brief Implements the methods defined in the header file workspace.h
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "workspace.h"
+
+
+int create_workspace(workspace *ws)
+{
+	const char *base = getenv("TMPDIR");
+
+	if ((base == NULL) || (*base == '\0'))
+	{
+		if (access("/dev/shm", W_OK) == 0)
+			base = "/dev/shm";
+		else
+			base = "/tmp";
+	}
+
+	if (asprintf(&ws->dir, "%s/slowconcorde_XXXXXX", base) == -1)
+	{
+		ws->dir = NULL;
+		return -1;
+	}
+	if (mkdtemp(ws->dir) == NULL)
+	{
+		fprintf(stderr, "ERROR: Couldn't create a scratch directory in '%s'\n", base);
+		free(ws->dir);
+		ws->dir = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+
+char *workspace_file(const workspace *ws, const char *name)
+{
+	char *path;
+	if (asprintf(&path, "%s/%s", ws->dir, name) == -1)
+		return NULL;
+	return path;
+}
+
+
+void delete_workspace(workspace *ws)
+{
+	DIR *dp;
+	struct dirent *entry;
+	char *path;
+
+	if (ws->dir == NULL)
+		return;
+
+	/* Concorde leaves a few files behind (e.g. the .pul, .sav and .mas files),
+	   so empty the directory before removing it. */
+	dp = opendir(ws->dir);
+	if (dp != NULL)
+	{
+		while ((entry = readdir(dp)) != NULL)
+		{
+			if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+				continue;
+			path = workspace_file(ws, entry->d_name);
+			if (path != NULL)
+			{
+				unlink(path);
+				free(path);
+			}
+		}
+		closedir(dp);
+	}
+	if (rmdir(ws->dir) == -1)
+		fprintf(stderr, "ERROR: Couldn't remove the scratch directory '%s'\n", ws->dir);
+
+	free(ws->dir);
+	ws->dir = NULL;
+}
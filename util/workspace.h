@@ -0,0 +1,58 @@
+/**
+ *	\file
+ *	\brief A private scratch directory in which the files needed to evaluate an
+ *	L-System (the TSPlib files and anything \e Concorde creates) are stored.
+ *
+ *	Every evaluation uses its own directory, so any number of evaluations (in
+ *	one process or in many) can run at the same time without overwriting each
+ *	other's files.
+ */
+
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+
+/**
+ *	\brief A scratch directory.
+ */
+typedef struct
+{
+	/**
+	 *	\brief The path of the directory.
+	 */
+	char *dir;
+} workspace;
+
+
+/**
+ *	\brief Creates a new (uniquely named) scratch directory.
+ *
+ *	The directory is created in <c>$TMPDIR</c> if it is set, otherwise in
+ *	<c>/dev/shm</c> (which is normally a tmpfs, i.e. kept in memory) if it
+ *	exists, otherwise in <c>/tmp</c>.
+ *
+ *	\param ws The workspace structure to initialise.
+ *	\return \c 0 if the directory was created, \c -1 otherwise.
+ *	\sa delete_workspace(workspace *ws)
+ */
+int create_workspace(workspace *ws);
+
+/**
+ *	\brief Returns the path of the file called \c name in the workspace.
+ *
+ *	Note: You \e must \c free() the returned string.
+ *
+ *	\param ws   A workspace.
+ *	\param name The name of the file.
+ *	\return The path of the file.
+ */
+char *workspace_file(const workspace *ws, const char *name);
+
+/**
+ *	\brief Deletes the scratch directory and every file in it.
+ *
+ *	\param ws The workspace to delete.
+ */
+void delete_workspace(workspace *ws);
+
+#endif